@@ -0,0 +1,104 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*estimates the cost of a parsed program without running it, by the latencies
+ * and ports of a micro-architecture the scheduler uses (see scheduler.c): the
+ * micro-ops of every instruction are counted per group of ports, the
+ * reciprocal throughput is the number of cycles an iteration of the program
+ * takes on the busiest group (or to issue it), and the critical path is the
+ * sum of the longest chains of latencies through its straight-line blocks,
+ * which are serialized by the instructions between them (ex: jumps).*/
+#include "analyzer.h"
+#include "scheduler.h"
+#include <stdlib.h>
+
+// the public group of ports of each group of the scheduler
+static const enum asm_port UNIT_PORT[NUM_UNITS] = {
+    [UNIT_ALU] = AL_PORT_ALU, [UNIT_MUL] = AL_PORT_MUL,
+    [UNIT_VEC] = AL_PORT_VEC, [UNIT_FMA] = AL_PORT_FMA,
+    [UNIT_DIV] = AL_PORT_DIV};
+
+/**
+ * adds the micro-ops and critical path of the @param n nodes @param nodes of a
+ * block to @param analysis and the micro-ops of each group of ports to
+ * @param uops
+ */
+static void add_block(const struct sched_node *nodes, size_t n,
+                      struct asm_analysis *analysis, size_t *uops) {
+
+  unsigned int latency = 0;
+  for (size_t i = 0; i < n; i++) {
+    const struct sched_node *node = &nodes[i];
+    analysis->uops += node->uops;
+    if (node->unit != UNIT_NONE)
+      uops[UNIT_PORT[node->unit]] += node->uops - node->load - node->store;
+    uops[AL_PORT_LOAD] += node->load;
+    uops[AL_PORT_STORE] += node->store;
+    if (node->height > latency)
+      latency = node->height;
+  }
+  analysis->latency += latency;
+}
+
+int analyze_program(const struct asm_program *program, unsigned int uarch,
+                    struct asm_analysis *analysis) {
+
+  const struct uarch_model *model = get_uarch_model(uarch);
+  FAIL_IF(model == NULL);
+  struct sched_node *nodes =
+      calloc(MAX_SCHEDULE_INSTRS, sizeof(struct sched_node));
+  FAIL_IF(nodes == NULL);
+  *analysis = (struct asm_analysis){0};
+  size_t uops[AL_NUM_PORTS] = {0};
+  size_t start = 0;
+  for (size_t i = 0; i <= program->len; i++) {
+    struct effects e;
+    // a block ends before an instruction with unknown effects or at its limit
+    bool end = i == program->len || !get_effects(&program->instrs[i], &e);
+    if (!end && i - start < MAX_SCHEDULE_INSTRS)
+      continue;
+    build_nodes(model, &program->instrs[start], nodes, i - start);
+    add_block(nodes, i - start, analysis, uops);
+    analysis->instrs += i - start;
+    start = end ? i + 1 : i;
+    if (!end || i == program->len)
+      continue;
+    int key = program->instrs[i].key;
+    // labels and directives take no cycles, while any other instruction
+    // (ex: a jump or push) is counted as a single ALU micro-op that waits for
+    // the block before it
+    if (key == LABEL || key == ALIGN || key == SKIP)
+      continue;
+    analysis->instrs++;
+    analysis->uops++;
+    analysis->latency++;
+    uops[AL_PORT_ALU]++;
+  }
+  free(nodes);
+  // ports of each group, with loads and stores on their own
+  unsigned int ports[AL_NUM_PORTS] = {0};
+  for (int unit = UNIT_ALU; unit < NUM_UNITS; unit++)
+    ports[UNIT_PORT[unit]] = model->units[unit];
+  ports[AL_PORT_LOAD] = model->load_ports;
+  ports[AL_PORT_STORE] = model->store_ports;
+  analysis->rthroughput = (double)analysis->uops / model->width;
+  for (int port = 0; port < AL_NUM_PORTS; port++) {
+    analysis->pressure[port] = (double)uops[port] / ports[port];
+    if (analysis->pressure[port] > analysis->rthroughput)
+      analysis->rthroughput = analysis->pressure[port];
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines the static analysis estimating the cost of parsed programs*/
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * stores the estimated cost of the parsed @param program on the
+ * micro-architecture @param uarch in @param analysis (see
+ * asm_analyze_program())
+ */
+int analyze_program(const struct asm_program *program, unsigned int uarch,
+                    struct asm_analysis *analysis);
+
+#endif
@@ -0,0 +1,244 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements a thread safe arena of executable memory shared by many small
+ * functions: slabs are carved into cache line aligned blocks of a size class,
+ * and the blocks of freed functions are reused*/
+#include "arena.h"
+#include "buffer.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// block lengths of the size classes, larger functions get a slab of their own
+static const size_t SIZE_CLASSES[] = {64,  128,  192,  256,  384,  512,
+                                      768, 1024, 1536, 2048, 3072, 4096};
+#define NUM_SIZE_CLASSES (sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]))
+// freed code is overwritten with int3, so stale calls trap
+#define INT3 0xcc
+
+// a function committed into a block of a slab
+struct asm_func {
+  struct slab *slab;
+  // length of its machine code, or 0 if the block is free
+  size_t len;
+};
+
+// memory mapped for the blocks of a size class (or a single large function)
+struct slab {
+  // writable view of the memory and its executable view (NULL if the same)
+  uint8_t *code;
+  uint8_t *exec;
+  int memfd;
+  size_t len;
+  size_t size_class;
+  size_t block_len;
+  size_t num_blocks;
+  // the function of every block, and a stack of the indices of free blocks
+  struct asm_func *funcs;
+  size_t *free_blocks;
+  size_t num_free;
+  struct slab *next;
+};
+
+struct asm_arena {
+  pthread_mutex_t lock;
+  bool dual;
+  // lists of the slabs of every size class, followed by those of large
+  // functions
+  struct slab *slabs[NUM_SIZE_CLASSES + 1];
+  struct asm_arena_stats stats;
+};
+
+/**
+ * returns the index of the smallest size class that fits @param len bytes, or
+ * NUM_SIZE_CLASSES if none does
+ */
+static size_t get_size_class(size_t len) {
+
+  size_t size_class = 0;
+  while (size_class < NUM_SIZE_CLASSES && SIZE_CLASSES[size_class] < len)
+    size_class++;
+  return size_class;
+}
+
+/**
+ * unmaps @param slab and frees it, updating the statistics of @param arena
+ */
+static void destroy_slab(struct asm_arena *arena, struct slab *slab) {
+
+  unmap_code(slab->code, slab->exec, slab->memfd, slab->len);
+  arena->stats.slabs--;
+  arena->stats.bytes_mapped -= slab->len;
+  free(slab->funcs);
+  free(slab->free_blocks);
+  free(slab);
+}
+
+/**
+ * maps a slab of @param len bytes for blocks of @param block_len bytes of the
+ * size class @param size_class and pushes it onto its list in @param arena.
+ * Returns NULL on failure.
+ */
+static struct slab *create_slab(struct asm_arena *arena, size_t size_class,
+                                size_t block_len, size_t len) {
+
+  struct slab *slab = calloc(1, sizeof(struct slab));
+  if (slab == NULL)
+    return NULL;
+  slab->num_blocks = len / block_len;
+  slab->funcs = calloc(slab->num_blocks, sizeof(struct asm_func));
+  slab->free_blocks = malloc(slab->num_blocks * sizeof(size_t));
+  if (slab->funcs == NULL || slab->free_blocks == NULL ||
+      map_code(len, arena->dual, &slab->code, &slab->exec, &slab->memfd)) {
+    free(slab->funcs);
+    free(slab->free_blocks);
+    free(slab);
+    return NULL;
+  }
+  slab->len = len;
+  slab->size_class = size_class;
+  slab->block_len = block_len;
+  // blocks are handed out from the start of the slab
+  for (size_t i = 0; i < slab->num_blocks; i++) {
+    slab->funcs[i].slab = slab;
+    slab->free_blocks[i] = slab->num_blocks - 1 - i;
+  }
+  slab->num_free = slab->num_blocks;
+  slab->next = arena->slabs[size_class];
+  arena->slabs[size_class] = slab;
+  arena->stats.slabs++;
+  arena->stats.bytes_mapped += len;
+  return slab;
+}
+
+struct asm_arena *create_arena(bool dual) {
+
+  struct asm_arena *arena = calloc(1, sizeof(struct asm_arena));
+  if (arena == NULL)
+    return NULL;
+  if (pthread_mutex_init(&arena->lock, NULL)) {
+    free(arena);
+    return NULL;
+  }
+  arena->dual = dual;
+  return arena;
+}
+
+struct asm_func *arena_commit(struct asm_arena *arena, assemblyline_t al) {
+
+  if (al->offset <= 0) {
+    fprintf(stderr, "assembyline: no machine code to commit\n");
+    return NULL;
+  }
+  size_t len = (size_t)al->offset;
+  size_t size_class = get_size_class(len);
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t block_len = size_class < NUM_SIZE_CLASSES
+                         ? SIZE_CLASSES[size_class]
+                         : ROUND_TO_PAGE(len, page_size);
+  pthread_mutex_lock(&arena->lock);
+  struct slab *slab = NULL;
+  if (size_class < NUM_SIZE_CLASSES) {
+    slab = arena->slabs[size_class];
+    while (slab != NULL && slab->num_free == 0)
+      slab = slab->next;
+  }
+  if (slab == NULL)
+    slab = create_slab(arena, size_class, block_len,
+                       size_class < NUM_SIZE_CLASSES ? ARENA_SLAB_LEN
+                                                     : block_len);
+  struct asm_func *func = NULL;
+  if (slab != NULL) {
+    func = &slab->funcs[slab->free_blocks[--slab->num_free]];
+    func->len = len;
+    arena->stats.funcs++;
+    arena->stats.bytes_used += len;
+    arena->stats.bytes_allocated += block_len;
+  }
+  pthread_mutex_unlock(&arena->lock);
+  // the block is not freed while it is written, so that needs no lock
+  if (func != NULL)
+    memcpy(slab->code + (func - slab->funcs) * block_len, al->buffer, len);
+  return func;
+}
+
+void *func_code(const struct asm_func *func) {
+
+  const struct slab *slab = func->slab;
+  uint8_t *code = slab->exec != NULL ? slab->exec : slab->code;
+  return code + (func - slab->funcs) * slab->block_len;
+}
+
+int arena_free(struct asm_arena *arena, struct asm_func *func) {
+
+  struct slab *slab = func->slab;
+  size_t block = func - slab->funcs;
+  pthread_mutex_lock(&arena->lock);
+  if (func->len == 0) {
+    pthread_mutex_unlock(&arena->lock);
+    FAIL_IF_MSG(true, "function is already freed\n")
+  }
+  memset(slab->code + block * slab->block_len, INT3, func->len);
+  arena->stats.funcs--;
+  arena->stats.bytes_used -= func->len;
+  arena->stats.bytes_allocated -= slab->block_len;
+  func->len = 0;
+  slab->free_blocks[slab->num_free++] = block;
+  // empty slabs are unmapped, but the last of a size class is kept for the
+  // next function
+  struct slab **list = &arena->slabs[slab->size_class];
+  bool last = *list == slab && slab->next == NULL &&
+              slab->size_class < NUM_SIZE_CLASSES;
+  if (slab->num_free == slab->num_blocks && !last) {
+    while (*list != slab)
+      list = &(*list)->next;
+    *list = slab->next;
+    destroy_slab(arena, slab);
+  }
+  pthread_mutex_unlock(&arena->lock);
+  return EXIT_SUCCESS;
+}
+
+struct asm_arena_stats arena_stats(struct asm_arena *arena) {
+
+  pthread_mutex_lock(&arena->lock);
+  struct asm_arena_stats stats = arena->stats;
+  pthread_mutex_unlock(&arena->lock);
+  if (stats.bytes_mapped > 0)
+    stats.occupancy = (double)stats.bytes_allocated / stats.bytes_mapped;
+  if (stats.bytes_allocated > 0)
+    stats.fragmentation =
+        (double)(stats.bytes_allocated - stats.bytes_used) /
+        stats.bytes_allocated;
+  return stats;
+}
+
+int destroy_arena(struct asm_arena *arena) {
+
+  for (size_t i = 0; i <= NUM_SIZE_CLASSES; i++) {
+    while (arena->slabs[i] != NULL) {
+      struct slab *slab = arena->slabs[i];
+      arena->slabs[i] = slab->next;
+      destroy_slab(arena, slab);
+    }
+  }
+  pthread_mutex_destroy(&arena->lock);
+  free(arena);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for sharing executable memory between many small
+ * functions*/
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+// bytes mapped at once for the blocks of a size class
+#define ARENA_SLAB_LEN 0x10000
+// blocks are aligned to cache lines
+#define ARENA_BLOCK_ALIGN 64
+
+/**
+ * allocates an arena whose memory is mapped twice (writable and executable)
+ * if @param dual is set (see asm_set_dual_mapping()). Returns NULL on failure.
+ */
+struct asm_arena *create_arena(bool dual);
+
+/**
+ * copies the machine code of instance @param al into a free block of the size
+ * class that fits it in @param arena. Returns its handle or NULL on failure.
+ */
+struct asm_func *arena_commit(struct asm_arena *arena, assemblyline_t al);
+
+/**
+ * returns the executable address of the machine code of @param func
+ */
+void *func_code(const struct asm_func *func);
+
+/**
+ * returns the block of @param func to the free list of its size class in
+ * @param arena, and unmaps its slab once it holds no more functions (unless it
+ * is the last slab of its size class)
+ */
+int arena_free(struct asm_arena *arena, struct asm_func *func);
+
+/**
+ * returns a snapshot of the statistics of @param arena
+ */
+struct asm_arena_stats arena_stats(struct asm_arena *arena);
+
+/**
+ * unmaps every slab of @param arena and frees @param arena
+ */
+int destroy_arena(struct asm_arena *arena);
+
+#endif
@@ -25,11 +25,18 @@
 #include "registers.h"
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 
 static const unsigned int SHIFT_5 = 5;
 static const unsigned int SHIFT_3 = 3;
 static const unsigned int WORD_IDENTIFIER = 0x66;
 static const unsigned int ADDRESS_SIZE_OVERWRITE = 0x67;
+static const unsigned int SEGMENT_CS = 0x2e;
+// group 1 (add, or, adc, sbb, and, sub, xor, cmp) with an immediate: op offset
+// 1 selects imm32 (0x81) and 3 a sign extended imm8 (0x83)
+static const unsigned int IMM_GROUP1 = 0x80;
+static const int OP_OFFSET_IMM32 = 1;
+static const int OP_OFFSET_IMM8 = 3;
 static const unsigned int DWORD_BYTES = 4;
 static const unsigned int QWORD_BYTES = 8;
 
@@ -55,6 +62,54 @@ static unsigned int assemble_const(unsigned long constant,
   return ptr_pos;
 }
 
+/**
+ * writes the sign extension of the byte @param value as a 32 bit constant to
+ * pointer location @param ptr
+ */
+static unsigned int assemble_sign_extended(uint8_t value,
+                                           unsigned char ptr[]) {
+
+  uint32_t extended = (uint32_t)(int32_t)(int8_t)value;
+  for (unsigned int i = 0; i < DWORD_BYTES; i++)
+    ptr[i] = (extended >> (i * BIT_8)) & MAX_UNSIGNED_8BIT;
+  return DWORD_BYTES;
+}
+
+/**
+ * checks if the long_disp choice of @param instruc widens its disp8 (including
+ * the zero byte of [rbp] and [r13]) to a disp32
+ */
+static bool widens_disp(const struct instr *instruc) {
+
+  if (!instruc->long_disp ||
+      !(instruc->zero_byte ||
+        (instruc->mem_disp && instruc->mod_disp == MOD8)))
+    return false;
+  // the mod field of the modR/M byte selects the displacement size
+  const struct instr_table *row = &INSTR_TABLE[instruc->key];
+  for (unsigned int i = 0; i < row->instr_size; i++)
+    if ((row->opcode[i] & ~MAX_UNSIGNED_8BIT) &&
+        (row->opcode[i] & GET_EN) == REG)
+      return true;
+  return false;
+}
+
+/**
+ * checks if the long_imm choice of @param instruc widens its sign extended
+ * imm8 to an imm32. 16 bit operations are left alone, as their imm16 would
+ * stall the decoders on the length changing 66h prefix.
+ */
+static bool widens_imm(const struct instr *instruc) {
+
+  const struct instr_table *row = &INSTR_TABLE[instruc->key];
+  return instruc->long_imm && instruc->imm &&
+         instruc->op_offset == OP_OFFSET_IMM8 &&
+         row->op_offset_i < row->instr_size &&
+         row->opcode[row->op_offset_i] == IMM_GROUP1 &&
+         (instruc->opd[0].reg & BIT_MASK) != BIT_16 && !instruc->hex.is_66H &&
+         !instruc->keyword.is_word;
+}
+
 /**
  * this function determines how the caller interprets an immediate between
  * 0x80000000 and 0xffffffff(64 bits when NASM mode is disabled) by including
@@ -63,7 +118,7 @@ static unsigned int assemble_const(unsigned long constant,
  * ex: NASM mode disabled "mov rax, 0x80000000" -> 48,b8,00,00,00,80,00,00,00,00
  * ex: NASM mode enabled "mov rax, 0x80000000" -> b8,00,00,00,80
  */
-static bool check_zero(struct instr *instruc, unsigned long saved_imm,
+static bool check_zero(const struct instr *instruc, unsigned long saved_imm,
                        instr_type type) {
   // check for signed 32bit overflow
   if (IN_RANGE(saved_imm, NEG32BIT_CHECK, MAX_UNSIGNED_32BIT) &&
@@ -82,7 +137,8 @@ static bool check_zero(struct instr *instruc, unsigned long saved_imm,
  * assembles the immediate operand of a @param instruc and writes the
  * opcode to pointer location @param ptr
  */
-static unsigned int assemble_imm(struct instr *instruc, unsigned char ptr[]) {
+static unsigned int assemble_imm(const struct instr *instruc,
+                                 unsigned char ptr[]) {
 
   unsigned int ptr_pos = 0;
   unsigned long imm_operand = instruc->cons;
@@ -150,12 +206,15 @@ static unsigned int assemble_mem_const(unsigned long constant,
  * assembles the memory displacement of a @param instruc and writes the
  * opcode to pointer location @param ptr
  */
-static unsigned int assemble_mem_disp(struct instr *instruc,
+static unsigned int assemble_mem_disp(const struct instr *instruc,
                                       unsigned char ptr[]) {
 
   unsigned int ptr_pos = 0;
+  bool long_disp = widens_disp(instruc);
   // check if zero byte is present
   if (instruc->zero_byte) {
+    if (long_disp)
+      return assemble_sign_extended(0, ptr);
     ptr[ptr_pos++] = 0x0;
     return ptr_pos;
   }
@@ -163,7 +222,9 @@ static unsigned int assemble_mem_disp(struct instr *instruc,
   if (instruc->mem_disp) {
     if (instruc->is_sib_const && !instruc->mem_value)
       ptr[ptr_pos++] = SIB_CONST;
-    if (instruc->mod_disp == MOD8) {
+    if (instruc->mod_disp == MOD8 && long_disp) {
+      ptr_pos += assemble_sign_extended(instruc->mem_offset, ptr + ptr_pos);
+    } else if (instruc->mod_disp == MOD8) {
       ptr[ptr_pos++] = instruc->mem_offset;
     } else if (instruc->mod_disp == MOD16 || instruc->no_base)
       ptr_pos += assemble_mem_const(instruc->mem_offset, ptr + ptr_pos);
@@ -171,7 +232,7 @@ static unsigned int assemble_mem_disp(struct instr *instruc,
   return ptr_pos;
 }
 
-static int assemble_VEX(struct instr *instruc, unsigned char ptr[],
+static int assemble_VEX(const struct instr *instruc, unsigned char ptr[],
                         unsigned int vex) {
 
   int i = 0;
@@ -180,9 +241,10 @@ static int assemble_VEX(struct instr *instruc, unsigned char ptr[],
   // set W bit depending on register size
   if ((vex & W0_W1) == W0_W1 && !instruc->hex.is_w0)
     vex &= ~W1;
-  // WIG is true therefore we could switch between C4H and C5H
+  // WIG is true therefore we could switch between C4H and C5H (unless the
+  // long_vex choice keeps the longer C4H)
   else if ((vex & WIG) && !(vex & W1))
-    if (!(instruc->hex.rex & rex_b))
+    if (!(instruc->hex.rex & rex_b) && !instruc->long_vex)
       vex_first_byte = C5H;
   // Byte 0 if VEX prefix
   vex >>= 1;
@@ -211,11 +273,15 @@ static int assemble_VEX(struct instr *instruc, unsigned char ptr[],
  * assembles the prefix and opcode of a @param instruc and writes the
  * opcode to pointer location @param ptr
  */
-static unsigned int assemble_instr(struct instr *instruc, unsigned char ptr[]) {
+static unsigned int assemble_instr(const struct instr *instruc,
+                                   unsigned char ptr[]) {
 
   unsigned int ptr_pos = 0;
   unsigned int opcode_pos = 0;
   unsigned int new_vex = 0;
+  // redundant segment prefixes, which are ignored in 64 bit mode
+  for (unsigned int i = 0; i < instruc->pad_prefixes; i++)
+    ptr[ptr_pos++] = SEGMENT_CS;
   // 16 bit register prefix
   if ((instruc->opd[0].reg & BIT_MASK) == BIT_16 || instruc->hex.is_66H ||
       instruc->keyword.is_word)
@@ -231,7 +297,7 @@ static unsigned int assemble_instr(struct instr *instruc, unsigned char ptr[]) {
     if (!(INSTR_TABLE[instruc->key].opcode[opcode_pos] &
           (~MAX_UNSIGNED_8BIT))) {
       if (opcode_pos == INSTR_TABLE[instruc->key].op_offset_i)
-        opc += instruc->op_offset;
+        opc += widens_imm(instruc) ? OP_OFFSET_IMM32 : instruc->op_offset;
       ptr[ptr_pos++] = opc;
     } else {
       switch (INSTR_TABLE[instruc->key].opcode[opcode_pos] & GET_EN) {
@@ -241,7 +307,10 @@ static unsigned int assemble_instr(struct instr *instruc, unsigned char ptr[]) {
         break;
 
       case REG:
-        ptr[ptr_pos++] = instruc->hex.reg;
+        // the mod field of a widened displacement selects disp32
+        ptr[ptr_pos++] = widens_disp(instruc)
+                             ? (instruc->hex.reg & ~MOD24) | MOD16
+                             : instruc->hex.reg;
         break;
 
       case VEX:
@@ -249,11 +318,6 @@ static unsigned int assemble_instr(struct instr *instruc, unsigned char ptr[]) {
         ptr_pos += assemble_VEX(instruc, ptr + ptr_pos, new_vex);
         break;
 
-      case ib:
-        instruc->reduced_imm = true;
-        instruc->cons &= MAX_UNSIGNED_8BIT;
-        break;
-
       case rd:
         if (opcode_pos == INSTR_TABLE[instruc->key].op_offset_i)
           opc += instruc->op_offset;
@@ -271,29 +335,66 @@ static unsigned int assemble_instr(struct instr *instruc, unsigned char ptr[]) {
   return ptr_pos;
 }
 
+bool encodes_ib(int key) {
+
+  for (unsigned int i = 0; i < INSTR_TABLE[key].instr_size; i++) {
+    unsigned int opcode = INSTR_TABLE[key].opcode[i];
+    if ((opcode & ~MAX_UNSIGNED_8BIT) && (opcode & GET_EN) == ib)
+      return true;
+  }
+  return false;
+}
+
+void reduce_imm(struct instr *instruc) {
+  // the immediate of an instruction encoded with ib is a single byte
+  if (encodes_ib(instruc->key)) {
+    instruc->reduced_imm = true;
+    instruc->cons &= MAX_UNSIGNED_8BIT;
+  }
+}
+
 /**
- * writes a nop instruction of length @param nop_pad_len
+ * writes the fewest nop instructions of total length @param nop_pad_len
  * to pointer location @param buf
  */
 unsigned int nop_padding(uint8_t *buf, unsigned int nop_pad_len) {
 
   uint8_t *ptr = buf;
-  // find nop instruction of a specified length
-  const uint8_t *nop_to_use = FIXED_NOP_LENGTH[nop_pad_len - 1];
-  unsigned int j = 0;
-  // assemble nop instruction
-  for (unsigned i = 0; i < nop_pad_len; i++) {
-    *(ptr + j) = nop_to_use[i];
-    j++;
+  unsigned int remaining = nop_pad_len;
+  while (remaining > 0) {
+    // find nop instruction of a specified length
+    unsigned int nop_len = remaining < MAX_NOP_LEN ? remaining : MAX_NOP_LEN;
+    memcpy(ptr, FIXED_NOP_LENGTH[nop_len - 1], nop_len);
+    ptr += nop_len;
+    remaining -= nop_len;
   }
   return nop_pad_len;
 }
 
+unsigned int align_padding(uint8_t *buf, unsigned int pad_len) {
+
+  if (pad_len <= MAX_ALIGN_NOPS * MAX_NOP_LEN)
+    return nop_padding(buf, pad_len);
+  // jump over a fill of int3 that is never executed
+  unsigned int jmp_len = 2;
+  buf[0] = JMP_REL8;
+  buf[1] = pad_len - jmp_len;
+  if (pad_len - jmp_len > MAX_SIGNED_8BIT) {
+    jmp_len = 1 + sizeof(uint32_t);
+    buf[0] = JMP_REL32;
+    uint32_t disp = pad_len - jmp_len;
+    for (unsigned int i = 0; i < sizeof(uint32_t); i++)
+      buf[1 + i] = (disp >> (i * BIT_8)) & MAX_UNSIGNED_8BIT;
+  }
+  memset(buf + jmp_len, INT3, pad_len - jmp_len);
+  return pad_len;
+}
+
 /**
  * assembles a @param instruc and write the opcode
  * to pointer location @param ptr
  */
-unsigned int assemble_asm(struct instr *instruc, uint8_t *dest) {
+unsigned int assemble_asm(const struct instr *instruc, uint8_t *dest) {
 
   // dest index
   unsigned int ptr_pos = 0;
@@ -316,6 +417,8 @@ unsigned int assemble_asm(struct instr *instruc, uint8_t *dest) {
   }
   // assemble immediate
   imm_len = assemble_imm(instruc, dest + ptr_pos);
+  if (widens_imm(instruc) && imm_len == 1)
+    imm_len = assemble_sign_extended(dest[ptr_pos], dest + ptr_pos);
   ptr_pos += imm_len;
 
   return ptr_pos;
@@ -23,15 +23,35 @@
 #include <inttypes.h>
 
 /**
- * writes nop instruction with length @param nop_pad_len at pointer location
- * @param buff
+ * writes nop instructions with total length @param nop_pad_len at pointer
+ * location @param buff
  */
 unsigned int nop_padding(uint8_t *buf, unsigned int nop_pad_len);
 
+/**
+ * fills the @param pad_len bytes at @param buf skipped by an align directive
+ * with the fewest nop instructions or, if that would take more than
+ * MAX_ALIGN_NOPS, with a jump over int3 instructions
+ */
+unsigned int align_padding(uint8_t *buf, unsigned int pad_len);
+
+/**
+ * checks whether the opcode of INSTR_TABLE[@param key] encodes its immediate
+ * with ib (a single byte)
+ */
+bool encodes_ib(int key);
+
+/**
+ * reduces the immediate of @param instruc to a single byte when its opcode is
+ * encoded with ib. Called once after parsing so that assemble_asm() never
+ * modifies the instruction it assembles.
+ */
+void reduce_imm(struct instr *instruc);
+
 /**
  * assembles the prefix, opcode, memory displacement, and immediate of a
  * @param instruc at pointer location @param ptr
  */
-unsigned int assemble_asm(struct instr *instruc, uint8_t *dest);
+unsigned int assemble_asm(const struct instr *instruc, uint8_t *dest);
 
 #endif
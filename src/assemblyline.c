@@ -16,8 +16,17 @@
 
 /*implements an interface between the calling function and the assembler*/
 #include "assemblyline.h"
+#include "analyzer.h"
+#include "arena.h"
+#include "buffer.h"
+#include "builder.h"
 #include "common.h"
+#include "lengthen.h"
+#include "measure.h"
 #include "parser.h"
+#include "pool.h"
+#include "reorder.h"
+#include "template.h"
 #if HAVE_CONFIG_H
 #include <config.h> // from autotools
 #endif
@@ -27,76 +36,115 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
-
-/**
- * called when an instance of @param al is created and maps the index of
- * INSTR_TABLE[] where the first occurrence of each letter of the alphabet to
- * instr_index_table for more efficient instruction lookup
- */
-static void asm_build_index_tables() {
-  // INSTR_TABLE index starts at the SKIP entry
-  int i = 2;
-  char previous_char = 'a' - 1;
-  while (INSTR_TABLE[++i].name != NA) {
-    if (INSTR_TABLE[i].instr_name[0] != '\0') {
-      if (previous_char != INSTR_TABLE[i].instr_name[0])
-        instr_table_index[INSTR_TABLE[i].instr_name[0] - 'a'] = i;
-      previous_char = INSTR_TABLE[i].instr_name[0];
-    }
-  }
-  // create an index table from OPD_FORMAT_TABLE
-  i = 0;
-  previous_char = '\0';
-  while (OPD_FORMAT_TABLE[++i].val != opd_error) {
-    if (previous_char != OPD_FORMAT_TABLE[i].str[0]) {
-      opd_format_table_index[OPD_FORMAT_TABLE[i].str[0] - 'a'] = i;
-      previous_char = OPD_FORMAT_TABLE[i].str[0];
-    }
-  }
-}
+#include <unistd.h>
 
 assemblyline_t asm_create_instance(uint8_t *buffer, int len) {
 
   assemblyline_t al = malloc(sizeof(struct assemblyline));
-  al->offset = 0;
-  al->assembly_opt = DEFAULT;
+  if (al == NULL)
+    return NULL;
+  al->reserved = 0;
+  al->huge_pages = false;
+  al->exec = NULL;
+  al->memfd = -1;
   // allocate buffer internally if not directly given
   if (buffer == NULL) {
     al->external = false;
     al->buffer_len = MEM_BUFFER + BUFFER_TOLERANCE;
-    int *ret = mmap(NULL, sizeof(uint8_t) * al->buffer_len,
-                    PROT_READ | PROT_WRITE | PROT_EXEC,
-                    MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (ret == MAP_FAILED) { // NOLINT
+    al->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (map_code(al->buffer_len, false, &al->buffer, &al->exec,
+                 &al->memfd) == EXIT_FAILURE) {
       fprintf(stderr, "failed to allocate internal memory buffer\n");
-      perror("Error: ");
       free(al);
       return NULL;
     }
-    al->buffer = (uint8_t *)ret;
   } else {
     al->external = true;
     al->buffer_len = len;
     al->buffer = buffer;
+    al->page_size = 0;
   }
+  al->lengths_only = false;
+  al->chunk_instrs = NULL;
+  al->reorder_window = NULL;
+  asm_reset(al);
+  return al;
+}
+
+void asm_reset(assemblyline_t al) {
+
+  al->offset = 0;
+  al->assembly_opt = DEFAULT;
   al->assembly_mode = ASSEMBLE;
   al->chunk_size = NONE;
   al->chunk_size++;
   al->debug = false;
   al->finalized = false;
-  asm_build_index_tables();
-  return al;
+  al->fuse_start = NA;
+  al->threads = 1;
+  al->length_log = NULL;
+  al->lengthen = false;
+  forget_chunk_instrs(al);
+  al->reorder = false;
+  drop_scheduled(al);
+  al->peephole = 0;
+  al->peephole_count = 0;
+  al->peephole_saved = 0;
+  al->uarch = AL_UARCH_NONE;
 }
 
 int asm_destroy_instance(assemblyline_t instance) {
   // free internal buffer
   if (!instance->external)
-    if (munmap((void *)instance->buffer, instance->buffer_len) == -1)
-      perror("Error: ");
+    unmap_buffer(instance);
+  free(instance->chunk_instrs);
+  free(instance->reorder_window);
   free(instance);
   return EXIT_SUCCESS;
 }
 
+asm_pool_t asm_create_pool(size_t max_retained) {
+  return create_pool(max_retained);
+}
+
+assemblyline_t asm_pool_acquire(asm_pool_t pool) { return pool_acquire(pool); }
+
+int asm_pool_release(asm_pool_t pool, assemblyline_t al) {
+  return pool_release(pool, al);
+}
+
+struct asm_pool_stats asm_pool_get_stats(asm_pool_t pool) {
+  return pool_stats(pool);
+}
+
+int asm_destroy_pool(asm_pool_t pool) {
+  if (pool == NULL)
+    return EXIT_SUCCESS;
+  return destroy_pool(pool);
+}
+
+asm_arena_t asm_create_arena(bool dual) { return create_arena(dual); }
+
+asm_func_t asm_arena_commit(asm_arena_t arena, assemblyline_t al) {
+  return arena_commit(arena, al);
+}
+
+void *asm_func_get_code(asm_func_t func) { return func_code(func); }
+
+int asm_arena_free(asm_arena_t arena, asm_func_t func) {
+  return arena_free(arena, func);
+}
+
+struct asm_arena_stats asm_arena_get_stats(asm_arena_t arena) {
+  return arena_stats(arena);
+}
+
+int asm_destroy_arena(asm_arena_t arena) {
+  if (arena == NULL)
+    return EXIT_SUCCESS;
+  return destroy_arena(arena);
+}
+
 // checks the minimum buffer length requirement 20 bytes at least
 static int check_buffer_len(int buffer_len) {
 
@@ -111,17 +159,53 @@ int assemble_str(assemblyline_t al, const char *assembly_str) {
 }
 
 int asm_assemble_str(assemblyline_t al, const char *assembly_str) {
+  // the terminating null character ends the last statement in place
+  return asm_assemble_buf(al, assembly_str, strlen(assembly_str) + 1);
+}
+
+int asm_assemble_buf(assemblyline_t al, const char *buf, size_t len) {
+
+  al->finalized = false;
+  // check minimum buffer length requirement
+  check_buffer_len(al->buffer_len);
+  // assemble buffer containing x64 assembly code
+  al->offset = assemble_all(al, buf, len, NULL);
+  FAIL_IF(al->offset == ASM_ERROR);
+  al->finalized = true;
+  return EXIT_SUCCESS;
+}
+
+int asm_assemble_lines(assemblyline_t al, const char *const *lines,
+                       const size_t *lens, size_t n, size_t *failed_line) {
 
   al->finalized = false;
   // check minimum buffer length requirement
   check_buffer_len(al->buffer_len);
-  // assemble string containing x64 assembly code
-  al->offset = assemble_all(al, assembly_str, NULL);
+  // assemble all lines into the buffer reserved for them
+  al->offset = assemble_lines(al, lines, lens, n, failed_line);
   FAIL_IF(al->offset == ASM_ERROR);
   al->finalized = true;
   return EXIT_SUCCESS;
 }
 
+int asm_measure_str(assemblyline_t al, const char *str, size_t *bytes,
+                    uint8_t **lens, size_t *num_lens) {
+
+  FAIL_IF_MSG(lens != NULL && num_lens == NULL,
+              "num_lens ptr cannot be NULL\n");
+  struct length_log log = {0};
+  // the terminating null character ends the last statement in place
+  if (measure(al, str, strlen(str) + 1, bytes, lens != NULL ? &log : NULL)) {
+    free(log.lens);
+    return EXIT_FAILURE;
+  }
+  if (lens != NULL) {
+    *lens = log.lens;
+    *num_lens = log.len;
+  }
+  return EXIT_SUCCESS;
+}
+
 int assemble_string_counting_chunks(assemblyline_t al, char *str,
                                     int chunk_size, int *dest) {
   return asm_assemble_string_counting_chunks(al, str, chunk_size, dest);
@@ -129,13 +213,108 @@ int assemble_string_counting_chunks(assemblyline_t al, char *str,
 
 int asm_assemble_string_counting_chunks(assemblyline_t al, char *str,
                                         int chunk_size, int *dest) {
+  return asm_assemble_buf_counting_chunks(al, str, strlen(str) + 1, chunk_size,
+                                          dest);
+}
+
+int asm_assemble_buf_counting_chunks(assemblyline_t al, const char *buf,
+                                     size_t len, int chunk_size, int *dest) {
   al->assembly_mode = CHUNK_COUNT;
   if (chunk_size < 2)
     al->assembly_mode = ASSEMBLE;
   al->chunk_size = chunk_size;
   check_buffer_len(al->buffer_len);
-  // assemble string containing x64 assembly code
-  al->offset = assemble_all(al, str, dest);
+  // assemble buffer containing x64 assembly code
+  al->offset = assemble_all(al, buf, len, dest);
+  FAIL_IF(al->offset == ASM_ERROR);
+  al->finalized = true;
+  return EXIT_SUCCESS;
+}
+
+asm_program_t asm_parse_str(assemblyline_t al, const char *assembly_str) {
+  return asm_parse_buf(al, assembly_str, strlen(assembly_str) + 1);
+}
+
+asm_program_t asm_parse_buf(assemblyline_t al, const char *buf, size_t len) {
+
+  asm_program_t program = calloc(1, sizeof(struct asm_program));
+  if (program == NULL)
+    return NULL;
+  if (parse_all(al, buf, len, program)) {
+    asm_destroy_program(program);
+    return NULL;
+  }
+  return program;
+}
+
+int asm_assemble_program(assemblyline_t al, asm_program_t program) {
+
+  al->finalized = false;
+  // check minimum buffer length requirement
+  check_buffer_len(al->buffer_len);
+  // assemble the parsed instructions
+  al->offset = assemble_program(al, program, NULL);
+  FAIL_IF(al->offset == ASM_ERROR);
+  al->finalized = true;
+  return EXIT_SUCCESS;
+}
+
+void asm_destroy_program(asm_program_t program) {
+  if (program == NULL)
+    return;
+  free_program(program);
+  free(program);
+}
+
+asm_template_t asm_create_template(assemblyline_t al,
+                                   const char *assembly_str) {
+
+  asm_template_t tmpl = calloc(1, sizeof(struct asm_template));
+  if (tmpl == NULL)
+    return NULL;
+  if (build_template(al, assembly_str, strlen(assembly_str) + 1, tmpl)) {
+    asm_destroy_template(tmpl);
+    return NULL;
+  }
+  return tmpl;
+}
+
+int asm_template_placeholder(asm_template_t tmpl, const char *name) {
+
+  for (size_t i = 0; i < tmpl->num_names; i++)
+    if (!strcmp(tmpl->names[i], name))
+      return (int)i;
+  return NA;
+}
+
+int asm_assemble_template(assemblyline_t al, asm_template_t tmpl,
+                          const uint64_t values[]) {
+
+  al->finalized = false;
+  // check minimum buffer length requirement
+  check_buffer_len(al->buffer_len);
+  // copy and patch the template code
+  al->offset = assemble_template(al, tmpl, values);
+  FAIL_IF(al->offset == ASM_ERROR);
+  al->finalized = true;
+  return EXIT_SUCCESS;
+}
+
+void asm_destroy_template(asm_template_t tmpl) {
+  if (tmpl == NULL)
+    return;
+  free_template(tmpl);
+  free(tmpl);
+}
+
+int asm_emit_operands(assemblyline_t al, enum asm_mnemonic mnemonic,
+                      const struct asm_operand opds[]) {
+
+  al->finalized = false;
+  // check minimum buffer length requirement
+  check_buffer_len(al->buffer_len);
+  // assemble the instruction without going through its string representation
+  al->offset = emit_operands(al, mnemonic, opds);
   FAIL_IF(al->offset == ASM_ERROR);
   al->finalized = true;
   return EXIT_SUCCESS;
@@ -165,7 +344,8 @@ int asm_assemble_file_counting_chunks(assemblyline_t al, char *asm_file,
   char *str = asm_mmap_file(asm_file, &str_len);
   // NOLINTNEXTLINE
   FAIL_SYS(str == MAP_FAILED, "mmap failed to read file\n", EXIT_FAILURE);
-  int exit = asm_assemble_string_counting_chunks(al, str, chunk_size, dest);
+  int exit =
+      asm_assemble_buf_counting_chunks(al, str, str_len, chunk_size, dest);
   // free mmap memory used for reading file
   FAIL_SYS(munmap((void *)str, str_len) == -1, "munmap failed\n", EXIT_FAILURE);
   return exit;
@@ -181,7 +361,7 @@ int asm_assemble_file(assemblyline_t al, char *asm_file) {
   const char *str = asm_mmap_file(asm_file, &str_len);
   // NOLINTNEXTLINE
   FAIL_SYS(str == MAP_FAILED, "mmap failed to read file\n", EXIT_FAILURE);
-  int exit = asm_assemble_str(al, str);
+  int exit = asm_assemble_buf(al, str, str_len);
   // free mmap memory used for reading file
   FAIL_SYS(munmap((void *)str, str_len) == -1, "munmap failed\n", EXIT_FAILURE);
   return exit;
@@ -197,18 +377,93 @@ void asm_set_chunk_size(assemblyline_t al, size_t chunk_size) {
   }
 }
 
+void asm_set_branch_padding(assemblyline_t al, bool pad) {
+  if (pad)
+    al->assembly_mode = BRANCH_PADDING;
+  else if (al->assembly_mode == BRANCH_PADDING)
+    al->assembly_mode = ASSEMBLE;
+}
+
+void asm_set_chunk_lengthening(assemblyline_t al, bool lengthen) {
+  al->lengthen = lengthen;
+  forget_chunk_instrs(al);
+}
+
+void asm_set_chunk_reordering(assemblyline_t al, bool reorder) {
+  al->reorder = reorder;
+}
+
+void asm_set_peephole(assemblyline_t al, unsigned int rules) {
+  al->peephole = rules & AL_PEEPHOLE_ALL;
+  al->peephole_count = 0;
+  al->peephole_saved = 0;
+}
+
+size_t asm_get_peephole_count(assemblyline_t al) { return al->peephole_count; }
+
+size_t asm_get_peephole_saved(assemblyline_t al) { return al->peephole_saved; }
+
+void asm_set_scheduling(assemblyline_t al, enum asm_uarch uarch) {
+  al->uarch = uarch <= AL_UARCH_ZEN3 ? uarch : AL_UARCH_NONE;
+}
+
+int asm_analyze_program(asm_program_t program, enum asm_uarch uarch,
+                        struct asm_analysis *analysis) {
+  return analyze_program(program, uarch, analysis);
+}
+
 void asm_set_debug(assemblyline_t al, bool debug) { al->debug = debug; }
 
+void asm_set_threads(assemblyline_t al, unsigned int threads) {
+  al->threads = threads > 0 ? threads : 1;
+}
+
+int asm_set_reserve(assemblyline_t al, size_t reserve) {
+
+  FAIL_IF_MSG(al->external, "cannot reserve address space for an external "
+                            "buffer\n")
+  FAIL_IF_VAR(reserve < (size_t)al->buffer_len,
+              "reserved address space is smaller than the buffer: %d bytes\n",
+              al->buffer_len)
+  // the code is moved to the start of the range, whose pages are committed as
+  // it grows
+  return move_buffer(al, al->buffer_len, reserve, al->huge_pages,
+                     al->exec != NULL);
+}
+
+int asm_set_huge_pages(assemblyline_t al, bool huge) {
+
+  FAIL_IF_MSG(al->external, "cannot map an external buffer in huge pages\n")
+  return move_buffer(al, al->buffer_len, al->reserved, huge,
+                     al->exec != NULL);
+}
+
+int asm_set_dual_mapping(assemblyline_t al, bool dual) {
+
+  FAIL_IF_MSG(al->external, "cannot map an external buffer twice\n")
+  return move_buffer(al, al->buffer_len, al->reserved, al->huge_pages, dual);
+}
+
+size_t asm_get_page_size(assemblyline_t al) { return al->page_size; }
+
 int asm_get_offset(assemblyline_t al) { return al->offset; }
 
-void asm_set_offset(assemblyline_t al, int offset) { al->offset = offset; }
+void asm_set_offset(assemblyline_t al, int offset) {
+  al->offset = offset;
+  // the code before the new offset is not known to end in a fusible pair, nor
+  // to be the instructions that would be lengthened
+  al->fuse_start = NA;
+  forget_chunk_instrs(al);
+}
 
 uint8_t __attribute__((deprecated("use asm_get_code instead"))) *
     asm_get_buffer(assemblyline_t al) {
   return al->buffer;
 }
 
-void *asm_get_code(assemblyline_t al) { return (void *)al->buffer; }
+void *asm_get_code(assemblyline_t al) {
+  return al->exec != NULL ? (void *)al->exec : (void *)al->buffer;
+}
 
 int asm_create_bin_file(assemblyline_t al, const char *file_name) {
 
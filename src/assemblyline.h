@@ -30,6 +30,47 @@ enum asm_opt { STRICT, NASM, SMART };
 
 typedef struct assemblyline *assemblyline_t;
 
+// a parsed assembly program that can be assembled any number of times
+typedef struct asm_program *asm_program_t;
+
+// machine code with placeholders that can be instantiated with any values
+typedef struct asm_template *asm_template_t;
+
+// instances with internal buffers that stay mapped between uses
+typedef struct asm_pool *asm_pool_t;
+
+// usage statistics of an asm_pool_t
+struct asm_pool_stats {
+  // acquisitions served by a retained instance
+  size_t hits;
+  // acquisitions that had to create a new instance
+  size_t misses;
+  // instances currently retained and the size of their buffers in bytes
+  size_t retained;
+  size_t bytes_retained;
+};
+
+// executable memory shared by many small functions
+typedef struct asm_arena *asm_arena_t;
+
+// a function committed into an asm_arena_t
+typedef struct asm_func *asm_func_t;
+
+// occupancy statistics of an asm_arena_t
+struct asm_arena_stats {
+  // functions committed and not freed, and the bytes of their machine code
+  size_t funcs;
+  size_t bytes_used;
+  // bytes of the blocks they occupy, and of the slabs mapped for blocks
+  size_t bytes_allocated;
+  size_t bytes_mapped;
+  size_t slabs;
+  // fraction of the bytes mapped that blocks occupy, and fraction of the bytes
+  // of blocks lost to rounding functions up to their size class
+  double occupancy;
+  double fragmentation;
+};
+
 /**
  * allocates an instance of assemblyline_t and attaches a pointer to a memory
  * buffer @param buffer where machine code will be written to. Buffer length
@@ -46,6 +87,94 @@ assemblyline_t asm_create_instance(uint8_t *buffer, int len);
  */
 int asm_destroy_instance(assemblyline_t instance);
 
+/**
+ * resets instance @param al to the state of a newly created instance (offset
+ * 0, default assembly options, no chunk size or branch padding, debug off, one
+ * thread) without unmapping or shrinking its memory buffer.
+ */
+void asm_reset(assemblyline_t al);
+
+/**
+ * allocates a pool that retains up to @param max_retained released instances
+ * with internal memory buffers for reuse, saving the mmap() and munmap() of
+ * creating and destroying them. The pool may be used by several threads at
+ * once. Returns NULL on failure. The pool must be freed with
+ * asm_destroy_pool().
+ */
+asm_pool_t asm_create_pool(size_t max_retained);
+
+/**
+ * returns an instance with an internal memory buffer from @param pool that is
+ * reset (see asm_reset()), or a newly created one if none is retained. Returns
+ * NULL on failure.
+ */
+assemblyline_t asm_pool_acquire(asm_pool_t pool);
+
+/**
+ * returns instance @param al to @param pool, which retains it unless it is
+ * full or @param al has an external memory buffer (then @param al is
+ * destroyed). The machine code of @param al must not be used afterwards.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_pool_release(asm_pool_t pool, assemblyline_t al);
+
+/**
+ * returns the usage statistics of @param pool
+ */
+struct asm_pool_stats asm_pool_get_stats(asm_pool_t pool);
+
+/**
+ * destroys all instances retained by @param pool and frees @param pool.
+ * Acquired instances that were not released remain valid. Returns
+ * EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_destroy_pool(asm_pool_t pool);
+
+/**
+ * allocates an arena of executable memory that many small functions share
+ * instead of each taking at least a page. Its memory is mapped twice
+ * (writable and executable, see asm_set_dual_mapping()) if @param dual is set
+ * or writable and executable memory is disallowed. The arena may be used by
+ * several threads at once. Returns NULL on failure. The arena must be freed
+ * with asm_destroy_arena().
+ */
+asm_arena_t asm_create_arena(bool dual);
+
+/**
+ * copies the machine code of instance @param al (from its start to its offset)
+ * into @param arena, after which @param al may be reset or destroyed. Code is
+ * put into a free 64 byte aligned block of the smallest size class that fits
+ * it (from 64 to 4096 bytes), and code larger than that into pages of its
+ * own. The code must be position independent: branches within it are, but
+ * code relying on its address (ie. rip relative accesses outside of it) is
+ * not. Returns a handle of the function or NULL on failure.
+ */
+asm_func_t asm_arena_commit(asm_arena_t arena, assemblyline_t al);
+
+/**
+ * returns the executable address of the machine code of @param func as type
+ * void* for easy typecasting to any function pointer format
+ */
+void *asm_func_get_code(asm_func_t func);
+
+/**
+ * frees the block of @param func in @param arena for reuse and overwrites its
+ * code with int3. @param func and its code must not be used afterwards.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_arena_free(asm_arena_t arena, asm_func_t func);
+
+/**
+ * returns the occupancy statistics of @param arena
+ */
+struct asm_arena_stats asm_arena_get_stats(asm_arena_t arena);
+
+/**
+ * unmaps all memory of @param arena, including the code of functions that were
+ * not freed, and frees @param arena. Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_destroy_arena(asm_arena_t arena);
+
 /**
  * assembles the given string @param assembly_str containing valid x64 assembly
  * code with instance @param al It writes the corresponding machine code to the
@@ -64,6 +193,42 @@ assemble_str(assemblyline_t al, const char *assembly_str);
  */
 int asm_assemble_str(assemblyline_t al, const char *assembly_str);
 
+/**
+ * assembles the first @param len characters of @param buf containing valid x64
+ * assembly code with instance @param al It writes the corresponding machine
+ * code to the memory location specified by buffer attached to @param al.
+ * @param buf does not need to be null-terminated and is never copied as a whole
+ * (assembly stops early at a null character). Returns EXIT_SUCCESS or
+ * EXIT_FAILURE.
+ */
+int asm_assemble_buf(assemblyline_t al, const char *buf, size_t len);
+
+/**
+ * assembles the @param n lines @param lines of @param lens characters each
+ * (which do not need to be null-terminated) with instance @param al like
+ * successive asm_assemble_buf() calls, but reserves buffer space for all of
+ * them once. @param lens may be NULL if all lines are null-terminated. Returns
+ * EXIT_SUCCESS or EXIT_FAILURE, in which case the index of the line that
+ * failed is stored in @param failed_line (if not NULL).
+ */
+int asm_assemble_lines(assemblyline_t al, const char *const *lines,
+                       const size_t *lens, size_t n, size_t *failed_line);
+
+/**
+ * measures the machine code of the string @param str containing valid x64
+ * assembly code: stores in @param bytes the number of bytes it would take if
+ * assembled at the offset of instance @param al with the options of @param al
+ * (so chunk, branch and alignment padding are counted). Only the lengths and
+ * positions of the code are computed: neither the buffer nor the offset of
+ * @param al change, which allows external buffers to be sized exactly. Unless
+ * @param lens is NULL, it is set to an array of the length of every
+ * instruction in the order written (without padding) that is freed with
+ * free(), and @param num_lens to its number of lengths. Returns EXIT_SUCCESS
+ * or EXIT_FAILURE.
+ */
+int asm_measure_str(assemblyline_t al, const char *str, size_t *bytes,
+                    uint8_t **lens, size_t *num_lens);
+
 /**
  * assembles the given file path @param asm_file containing valid x64 assembly
  * code with instance @param al It writes the corresponding machine code to the
@@ -109,6 +274,17 @@ assemble_string_counting_chunks(assemblyline_t al, char *string, int chunk_size,
 int asm_assemble_string_counting_chunks(assemblyline_t al, char *string,
                                         int chunk_size, int *dest);
 
+/**
+ * assembles the first @param len characters of @param buf (which does not need
+ * to be null-terminated) with instance @param al.
+ * It counts the number of instructions that break the chunk boundary of size
+ * @param chunk_size and saves it to @param dest It does not nop-pad
+ * necessarily, depends on the @param al instance (you can nop-pad and count
+ * different chunk breaks). Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_assemble_buf_counting_chunks(assemblyline_t al, const char *buf,
+                                     size_t len, int chunk_size, int *dest);
+
 /**
  * assembles the given @param asm_file with instance @param al.
  * It counts the number of instructions that break the chunk boundary of size
@@ -119,6 +295,409 @@ int asm_assemble_string_counting_chunks(assemblyline_t al, char *string,
 int asm_assemble_file_counting_chunks(assemblyline_t al, char *asm_file,
                                       int chunk_size, int *dest);
 
+/**
+ * parses the given string @param assembly_str containing valid x64 assembly
+ * code with the assembly options of instance @param al into an immutable
+ * program that asm_assemble_program() can assemble without parsing again.
+ * Returns NULL on failure. The program must be freed with
+ * asm_destroy_program().
+ */
+asm_program_t asm_parse_str(assemblyline_t al, const char *assembly_str);
+
+/**
+ * parses the first @param len characters of @param buf (which does not need to
+ * be null-terminated) like asm_parse_str(). Returns NULL on failure.
+ */
+asm_program_t asm_parse_buf(assemblyline_t al, const char *buf, size_t len);
+
+/**
+ * assembles the parsed @param program with instance @param al It writes the
+ * corresponding machine code to the memory location specified by buffer
+ * attached to @param al. The program is only read, so it may be assembled by
+ * several instances (and threads) at once. Returns EXIT_SUCCESS or
+ * EXIT_FAILURE.
+ */
+int asm_assemble_program(assemblyline_t al, asm_program_t program);
+
+/**
+ * frees all memory associated with @param program.
+ */
+void asm_destroy_program(asm_program_t program);
+
+/**
+ * assembles the given string @param assembly_str containing valid x64 assembly
+ * code with named placeholders in immediates and displacements
+ * (ex: "mov rax, {ptr}" or "mov rax, [rdi+{off}]") with the assembly options,
+ * chunk size and branch padding of instance @param al into a template.
+ * Placeholders are assembled with the widest encoding of their instruction, so
+ * instantiating a template never changes its length. Chunk and branch padding
+ * is laid out for the current offset of @param al, so the template may only be
+ * instantiated at offsets that are the same modulo the chunk size (or 32 for
+ * branch padding). Returns NULL on failure. The template must be freed with
+ * asm_destroy_template().
+ */
+asm_template_t asm_create_template(assemblyline_t al, const char *assembly_str);
+
+/**
+ * returns the index of the placeholder @param name of @param tmpl in the
+ * values passed to asm_assemble_template() or -1 if there is no such
+ * placeholder. Placeholders are indexed in order of first appearance.
+ */
+int asm_template_placeholder(asm_template_t tmpl, const char *name);
+
+/**
+ * copies the machine code of @param tmpl to the memory location specified by
+ * buffer attached to @param al and writes @param values (indexed by
+ * placeholder) in place of its placeholders. A value must fit the width of its
+ * immediate or displacement as an unsigned or sign-extended negative number.
+ * Fails if the padding of @param tmpl does not line up with the offset of
+ * @param al (see asm_create_template()). Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_assemble_template(assemblyline_t al, asm_template_t tmpl,
+                          const uint64_t values[]);
+
+/**
+ * frees all memory associated with @param tmpl.
+ */
+void asm_destroy_template(asm_template_t tmpl);
+
+/**
+ * instruction mnemonics accepted by asm_emit() (in the order of the internal
+ * instruction table)
+ */
+enum asm_mnemonic {
+  AL_ADC,
+  AL_ADCX,
+  AL_ADD,
+  AL_ADOX,
+  AL_AND,
+  AL_BEXTR,
+  AL_BZHI,
+  AL_CALL,
+  AL_CLC,
+  AL_CLFLUSH,
+  AL_CMOVA,
+  AL_CMOVAE,
+  AL_CMOVB,
+  AL_CMOVBE,
+  AL_CMOVC,
+  AL_CMOVE,
+  AL_CMOVG,
+  AL_CMOVGE,
+  AL_CMOVL,
+  AL_CMOVLE,
+  AL_CMOVNA,
+  AL_CMOVNAE,
+  AL_CMOVNB,
+  AL_CMOVNBE,
+  AL_CMOVNC,
+  AL_CMOVNE,
+  AL_CMOVNG,
+  AL_CMOVNGE,
+  AL_CMOVNL,
+  AL_CMOVNLE,
+  AL_CMOVNO,
+  AL_CMOVNP,
+  AL_CMOVNS,
+  AL_CMOVNZ,
+  AL_CMOVO,
+  AL_CMOVP,
+  AL_CMOVPE,
+  AL_CMOVPO,
+  AL_CMOVS,
+  AL_CMOVZ,
+  AL_CMP,
+  AL_CPUID,
+  AL_CVTDQ2PD,
+  AL_CVTPD2DQ,
+  AL_DEC,
+  AL_DIVPD,
+  AL_IMUL,
+  AL_INC,
+  AL_JA,
+  AL_JAE,
+  AL_JB,
+  AL_JBE,
+  AL_JE,
+  AL_JG,
+  AL_JGE,
+  AL_JL,
+  AL_JLE,
+  AL_JMP,
+  AL_JNE,
+  AL_JNO,
+  AL_JNP,
+  AL_JNS,
+  AL_JO,
+  AL_JP,
+  AL_JRCXZ,
+  AL_JS,
+  AL_LEA,
+  AL_LFENCE,
+  AL_MFENCE,
+  AL_MOV,
+  AL_MOVD,
+  AL_MOVNTDQA,
+  AL_MOVNTQ,
+  AL_MOVQ,
+  AL_MOVZX,
+  AL_MULPD,
+  AL_MUL,
+  AL_MULX,
+  AL_NEG,
+  AL_NOP,
+  AL_NOT,
+  AL_OR,
+  AL_PADDB,
+  AL_PADDD,
+  AL_PADDQ,
+  AL_PADDW,
+  AL_PAND,
+  AL_PANDN,
+  AL_PMULDQ,
+  AL_PMULHRSW,
+  AL_PMULHUW,
+  AL_PMULHW,
+  AL_PMULLD,
+  AL_PMULLW,
+  AL_PMULUDQ,
+  AL_POP,
+  AL_POR,
+  AL_PREFETCHNTA,
+  AL_PREFETCHT0,
+  AL_PREFETCHT1,
+  AL_PREFETCHT2,
+  AL_PSRLDQ,
+  AL_PSUBB,
+  AL_PSUBD,
+  AL_PSUBQ,
+  AL_PSUBW,
+  AL_PUNPCKLQDQ,
+  AL_PUSH,
+  AL_PXOR,
+  AL_RCR,
+  AL_RDPMC,
+  AL_RDPRU,
+  AL_RDTSC,
+  AL_RDTSCP,
+  AL_RET,
+  AL_ROR,
+  AL_RORX,
+  AL_SAL,
+  AL_SAR,
+  AL_SARX,
+  AL_SBB,
+  AL_SETA,
+  AL_SETAE,
+  AL_SETB,
+  AL_SETBE,
+  AL_SETC,
+  AL_SETE,
+  AL_SETG,
+  AL_SETGE,
+  AL_SETL,
+  AL_SETLE,
+  AL_SETNA,
+  AL_SETNAE,
+  AL_SETNB,
+  AL_SETNBE,
+  AL_SETNC,
+  AL_SETNE,
+  AL_SETNG,
+  AL_SETNGE,
+  AL_SETNL,
+  AL_SETNLE,
+  AL_SETNO,
+  AL_SETNP,
+  AL_SETNS,
+  AL_SETNZ,
+  AL_SETO,
+  AL_SETP,
+  AL_SETPE,
+  AL_SETPO,
+  AL_SETS,
+  AL_SETZ,
+  AL_SFENCE,
+  AL_SHL,
+  AL_SHLD,
+  AL_SHLX,
+  AL_SHR,
+  AL_SHRD,
+  AL_SHRX,
+  AL_SUB,
+  AL_TEST,
+  AL_VADDPD,
+  AL_VDIVPD,
+  AL_VMOVDQU,
+  AL_VMOVUPD,
+  AL_VMULPD,
+  AL_VPADDB,
+  AL_VPADDD,
+  AL_VPADDQ,
+  AL_VPADDW,
+  AL_VPAND,
+  AL_VPANDN,
+  AL_VPERM2F128,
+  AL_VPERM2I128,
+  AL_VPERMD,
+  AL_VPMULDQ,
+  AL_VPMULHRSW,
+  AL_VPMULHUW,
+  AL_VPMULHW,
+  AL_VPMULLD,
+  AL_VPMULLW,
+  AL_VPMULUDQ,
+  AL_VPOR,
+  AL_VPSUBB,
+  AL_VPSUBD,
+  AL_VPSUBQ,
+  AL_VPSUBW,
+  AL_VPXOR,
+  AL_VSUBPD,
+  AL_XABORT,
+  AL_XBEGIN,
+  AL_XCHG,
+  AL_XEND,
+  AL_XOR
+};
+
+/**
+ * registers accepted by asm_emit() operands. The high bits of a value denote
+ * the register class and the low 4 bits the register number.
+ */
+enum asm_register {
+  AL_NOREG,
+  // 64-bit registers
+  AL_RAX = 0x10, AL_RCX, AL_RDX, AL_RBX, AL_RSP, AL_RBP, AL_RSI, AL_RDI, AL_R8,
+  AL_R9, AL_R10, AL_R11, AL_R12, AL_R13, AL_R14, AL_R15,
+  // 32-bit registers
+  AL_EAX = 0x20, AL_ECX, AL_EDX, AL_EBX, AL_ESP, AL_EBP, AL_ESI, AL_EDI,
+  AL_R8D, AL_R9D, AL_R10D, AL_R11D, AL_R12D, AL_R13D, AL_R14D, AL_R15D,
+  // 16-bit registers
+  AL_AX = 0x30, AL_CX, AL_DX, AL_BX, AL_SP, AL_BP, AL_SI, AL_DI, AL_R8W,
+  AL_R9W, AL_R10W, AL_R11W, AL_R12W, AL_R13W, AL_R14W, AL_R15W,
+  // 8-bit registers
+  AL_AL = 0x40, AL_CL, AL_DL, AL_BL, AL_SPL, AL_BPL, AL_SIL, AL_DIL, AL_R8B,
+  AL_R9B, AL_R10B, AL_R11B, AL_R12B, AL_R13B, AL_R14B, AL_R15B,
+  // 8-bit high byte registers
+  AL_AH = 0x54, AL_CH, AL_DH, AL_BH,
+  // 64-bit mmx registers
+  AL_MM0 = 0x60, AL_MM1, AL_MM2, AL_MM3, AL_MM4, AL_MM5, AL_MM6, AL_MM7,
+  // 128-bit xmm registers
+  AL_XMM0 = 0x70, AL_XMM1, AL_XMM2, AL_XMM3, AL_XMM4, AL_XMM5, AL_XMM6,
+  AL_XMM7, AL_XMM8, AL_XMM9, AL_XMM10, AL_XMM11, AL_XMM12, AL_XMM13, AL_XMM14,
+  AL_XMM15,
+  // 256-bit ymm registers
+  AL_YMM0 = 0x80, AL_YMM1, AL_YMM2, AL_YMM3, AL_YMM4, AL_YMM5, AL_YMM6,
+  AL_YMM7, AL_YMM8, AL_YMM9, AL_YMM10, AL_YMM11, AL_YMM12, AL_YMM13, AL_YMM14,
+  AL_YMM15
+};
+
+// rewrites of the peephole pass (see asm_set_peephole())
+enum asm_peephole_rule {
+  // mov r, 0 -> xor r32, r32 for 32 and 64-bit registers
+  AL_PEEPHOLE_ZERO = 1 << 0,
+  // imul r, r, 2/4/8 -> shl r, 1/2/3 and imul r, s, 2 -> lea r, [s+s]
+  AL_PEEPHOLE_MUL = 1 << 1,
+  // cmp r, 0 -> test r, r
+  AL_PEEPHOLE_TEST = 1 << 2,
+  // mov a, b followed by mov b, a -> mov a, b for 64-bit registers
+  AL_PEEPHOLE_MOV = 1 << 3,
+  // add r, 1 -> inc r and sub r, 1 -> dec r
+  AL_PEEPHOLE_INC = 1 << 4,
+  // mov of a constant to a register -> the shortest instruction setting the
+  // same value: xor for 0, or for -1, mov r32 for values a 32-bit destination
+  // zero-extends and mov r64, imm32 for those it sign-extends, leaving movabs
+  // for any other value
+  AL_PEEPHOLE_CONST = 1 << 5,
+  AL_PEEPHOLE_ALL = (1 << 6) - 1
+};
+
+// micro-architectures whose latencies and execution ports the parsed input may
+// be scheduled for (see asm_set_scheduling())
+enum asm_uarch { AL_UARCH_NONE, AL_UARCH_SKYLAKE, AL_UARCH_ZEN3 };
+
+// groups of execution ports of the port pressure of struct asm_analysis
+enum asm_port {
+  AL_PORT_ALU,
+  // integer multiplications
+  AL_PORT_MUL,
+  // vector integer and logic instructions
+  AL_PORT_VEC,
+  // vector multiplications and floating point instructions
+  AL_PORT_FMA,
+  AL_PORT_DIV,
+  AL_PORT_LOAD,
+  AL_PORT_STORE,
+  AL_NUM_PORTS
+};
+
+// estimated cost of a parsed program (see asm_analyze_program())
+struct asm_analysis {
+  size_t instrs;
+  size_t uops;
+  // cycles per iteration when the program runs in a loop, bound by the busiest
+  // group of ports or the issue width
+  double rthroughput;
+  // cycles of the longest chain of latencies through the program
+  unsigned int latency;
+  // cycles per iteration each group of ports is busy for
+  double pressure[AL_NUM_PORTS];
+};
+
+// operand kinds of asm_emit()
+enum asm_operand_kind { AL_OPD_NONE, AL_OPD_REG, AL_OPD_IMM, AL_OPD_MEM };
+
+/**
+ * a typed operand of asm_emit(), built with AL_REG(), AL_IMM() or AL_MEM()
+ * ex: AL_MEM(AL_RDI, AL_RCX, 8, 0x10) is [rdi+8*rcx+0x10]
+ */
+struct asm_operand {
+  enum asm_operand_kind kind;
+  // register operand or base register of a memory reference
+  enum asm_register reg;
+  // index register and its scale (1, 2, 4 or 8) of a memory reference
+  enum asm_register index;
+  uint8_t scale;
+  // operand size keyword in bytes of a memory reference or 0 if implicit
+  uint8_t size;
+  // immediate or (32-bit signed or unsigned) memory displacement
+  int64_t value;
+};
+
+#define AL_REG(r) ((struct asm_operand){.kind = AL_OPD_REG, .reg = (r)})
+#define AL_IMM(v) ((struct asm_operand){.kind = AL_OPD_IMM, .value = (v)})
+#define AL_MEM_SIZE(sz, base, idx, sc, disp)                                   \
+  ((struct asm_operand){.kind = AL_OPD_MEM,                                    \
+                        .reg = (base),                                         \
+                        .index = (idx),                                        \
+                        .scale = (sc),                                         \
+                        .size = (sz),                                          \
+                        .value = (disp)})
+#define AL_MEM(base, idx, sc, disp) AL_MEM_SIZE(0, base, idx, sc, disp)
+// memory references with a byte, word, dword or qword keyword
+#define AL_MEM8(base, idx, sc, disp) AL_MEM_SIZE(1, base, idx, sc, disp)
+#define AL_MEM16(base, idx, sc, disp) AL_MEM_SIZE(2, base, idx, sc, disp)
+#define AL_MEM32(base, idx, sc, disp) AL_MEM_SIZE(4, base, idx, sc, disp)
+#define AL_MEM64(base, idx, sc, disp) AL_MEM_SIZE(8, base, idx, sc, disp)
+
+/**
+ * assembles the instruction @param mnemonic with the operands @param opds,
+ * terminated by an operand of kind AL_OPD_NONE, with instance @param al
+ * without formatting or parsing a string. It writes the corresponding machine
+ * code to the memory location specified by buffer attached to @param al at
+ * its offset. The instruction is encoded like its string representation with
+ * a decimal immediate. Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_emit_operands(assemblyline_t al, enum asm_mnemonic mnemonic,
+                      const struct asm_operand opds[]);
+
+// ex: asm_emit(al, AL_ADD, AL_REG(AL_RAX), AL_MEM(AL_RDI, AL_RCX, 8, 0x10))
+#define asm_emit(al, ...)                                                      \
+  ASM_EMIT_OPERANDS(al, __VA_ARGS__, ((struct asm_operand){AL_OPD_NONE}))
+#define ASM_EMIT_OPERANDS(al, mnemonic, ...)                                   \
+  asm_emit_operands(al, mnemonic, (const struct asm_operand[]){__VA_ARGS__})
+
 /**
  * sets a given chunk size boundary @param chunk_size in bytes with instance
  * @param al. When called before assemble_str() or assemble_file() assemblyline
@@ -129,6 +708,97 @@ int asm_assemble_file_counting_chunks(assemblyline_t al, char *asm_file,
  */
 void asm_set_chunk_size(assemblyline_t al, size_t chunk_size);
 
+/**
+ * enables or disables (@param pad) branch padding with instance @param al.
+ * Instead of padding every instruction like asm_set_chunk_size(), only jumps,
+ * calls and returns that would cross or end on a 32 byte boundary are
+ * preceded by nop padding, which avoids the penalty of the Intel JCC erratum
+ * on Skylake-derived cores. An instruction that may macro-fuse with the
+ * conditional jump following it (ex: cmp, test) is padded together with the
+ * jump, so pairs are never split. Replaces any chunk size set before, and is
+ * replaced by setting one.
+ */
+void asm_set_branch_padding(assemblyline_t al, bool pad);
+
+/**
+ * enables or disables (@param lengthen) padding chunks by lengthening
+ * instructions with instance @param al. When an instruction does not fit the
+ * current chunk (see asm_set_chunk_size()), the instructions before it in the
+ * chunk are re-encoded with longer encodings that do the same (disp32, imm32
+ * and 3 byte VEX instead of their short forms, and up to 3 redundant segment
+ * prefixes each) instead of padding with nops that would be executed. Chunks
+ * whose instructions cannot absorb the padding are padded with nops. Jumps are
+ * never lengthened and neither is the code before a jump, label or align
+ * directive, so no address that is branched to moves. Templates are always
+ * padded with nops.
+ */
+void asm_set_chunk_lengthening(assemblyline_t al, bool lengthen);
+
+/**
+ * enables or disables (@param reorder) filling chunks by reordering
+ * instructions with instance @param al. When an instruction does not fit the
+ * current chunk (see asm_set_chunk_size()), a later instruction of the same
+ * basic block that fits the gap is written first if it does not depend on the
+ * instructions it is moved above, ie. neither writes a register, the flags or
+ * memory the other reads or writes. Only gaps no instruction fits are padded
+ * (see asm_set_chunk_lengthening()). Jumps, labels, align directives and
+ * instructions with effects beyond their operands (ex: push, rdtsc, fences or
+ * nops) are never moved and nothing is moved past them. Instructions are only
+ * reordered within a single call.
+ */
+void asm_set_chunk_reordering(assemblyline_t al, bool reorder);
+
+/**
+ * enables the peephole @param rules (any of enum asm_peephole_rule or'ed
+ * together, or 0 to disable the pass) with instance @param al and resets its
+ * counts of rewrites and bytes saved. Input is then parsed as a whole (see
+ * asm_set_debug()) and naive idioms are rewritten into shorter or cheaper
+ * instructions that do the same before they are assembled. Rewrites that
+ * change the flags are only made if the next instruction that touches them
+ * writes all of them or returns, so nothing before a flag reader (ex: within
+ * an adcx/adox chain), jump, label or the end of the input is rewritten that
+ * way. Instructions given to asm_emit() are not rewritten.
+ */
+void asm_set_peephole(assemblyline_t al, unsigned int rules);
+
+/**
+ * returns the number of rewrites made by the peephole pass of instance
+ * @param al since asm_set_peephole()
+ */
+size_t asm_get_peephole_count(assemblyline_t al);
+
+/**
+ * returns the number of bytes of machine code the rewrites of the peephole
+ * pass of instance @param al saved since asm_set_peephole()
+ */
+size_t asm_get_peephole_saved(assemblyline_t al);
+
+/**
+ * schedules the input of instance @param al for the micro-architecture
+ * @param uarch, or disables scheduling with AL_UARCH_NONE (default). Input is
+ * then parsed as a whole (see asm_set_debug()) and the instructions of each
+ * straight-line block are reordered to shorten its critical path, by the
+ * latencies and execution ports of @param uarch, if that issues it in fewer
+ * cycles. Instructions only move past those they do not depend on through a
+ * register, the flags or memory, and labels, jumps and instructions with
+ * implicit effects (ex: push, rdtsc, fences) end a block. The order is the
+ * same for the same input. Instructions given to asm_emit() are not scheduled.
+ */
+void asm_set_scheduling(assemblyline_t al, enum asm_uarch uarch);
+
+/**
+ * estimates the cost of the parsed @param program (see asm_parse_str()) on the
+ * micro-architecture @param uarch without running it and stores it in
+ * @param analysis: its number of instructions and micro-ops, the cycles an
+ * iteration takes when it runs in a loop (reciprocal throughput), the length
+ * of its critical path and the pressure on each group of ports. Estimates are
+ * coarse (ex: they ignore the front end and cache misses) but cheap enough to
+ * rank variants of generated code. Returns EXIT_SUCCESS or EXIT_FAILURE (ex:
+ * for AL_UARCH_NONE).
+ */
+int asm_analyze_program(asm_program_t program, enum asm_uarch uarch,
+                        struct asm_analysis *analysis);
+
 /**
  * set debug flag @param debug to true or false with instance @param al. When is
  * set @param debug to true machine code represented in hexidecimal will be
@@ -136,6 +806,66 @@ void asm_set_chunk_size(assemblyline_t al, size_t chunk_size);
  */
 void asm_set_debug(assemblyline_t al, bool debug);
 
+/**
+ * sets the number of threads @param threads used by instance @param al to
+ * assemble large strings, buffers and files (default 1). The input is split at
+ * line breaks into slices of at least 64 KiB that are assembled concurrently,
+ * producing the same machine code as a single thread. Small inputs and
+ * instances with debug, branch padding, chunk lengthening or reordering set are
+ * always assembled by the calling thread.
+ */
+void asm_set_threads(assemblyline_t al, unsigned int threads);
+
+/**
+ * reserves @param reserve bytes (rounded up to whole pages) of address space
+ * for the internal buffer of instance @param al and moves the code assembled so
+ * far to its start. Pages of the range are only committed as the code grows,
+ * so the buffer grows in place without copies and pointers returned by
+ * asm_get_code() stay valid; assembling past the end of the range fails. Fails
+ * with an external buffer or a @param reserve smaller than the buffer.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_set_reserve(assemblyline_t al, size_t reserve);
+
+/**
+ * backs the internal buffer of instance @param al with 2 MiB huge pages if
+ * @param huge is set (or with pages of the system page size otherwise) and
+ * moves the code assembled so far there. Explicit huge pages (MAP_HUGETLB) are
+ * used when available, otherwise transparent huge pages are advised for a
+ * region aligned to their size. Falls back to the system page size if neither
+ * is available, see asm_get_page_size(). A buffer in huge pages grows by
+ * mapping it anew at twice the size, unless a range is reserved for it (see
+ * asm_set_reserve()), in which case only transparent huge pages are advised.
+ * Dual mapped buffers (see asm_set_dual_mapping()) always use the system page
+ * size. Fails with an external buffer. Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_set_huge_pages(assemblyline_t al, bool huge);
+
+/**
+ * returns the size of the pages backing the internal buffer of instance
+ * @param al (see asm_set_huge_pages()), or 0 with an external buffer. Huge
+ * pages are reported if mapped explicitly, or if transparent huge pages are
+ * enabled (not "never" in /sys/kernel/mm/transparent_hugepage/enabled) and
+ * advised, in which case they are requested rather than guaranteed: the kernel
+ * uses base pages while it has no free huge page.
+ */
+size_t asm_get_page_size(assemblyline_t al);
+
+/**
+ * maps the internal buffer of instance @param al twice from a memory file if
+ * @param dual is set: machine code is written to a readable and writable view
+ * of it, and asm_get_code() returns a readable and executable view of it, so
+ * no memory is ever both writable and executable (W^X) and protections never
+ * change. Otherwise the buffer is mapped once readable, writable and
+ * executable (default). The code assembled so far is moved to the new mapping.
+ * A dual mapped buffer grows by growing its memory file, in place within a
+ * range reserved for it (see asm_set_reserve()), and always uses pages of the
+ * system page size. Instances fall back to a dual mapped buffer if memory that
+ * is writable and executable is disallowed. Fails with an external buffer or
+ * without memfd_create(). Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int asm_set_dual_mapping(assemblyline_t al, bool dual);
+
 /**
  * returns the offset associated with @param al
  */
@@ -157,7 +887,8 @@ uint8_t __attribute__((deprecated("use asm_get_code instead"))) *
 
 /**
  * returns the buffer associated with @param al as type void* for easy
- * typecasting to any function pointer format.
+ * typecasting to any function pointer format (its executable view if it is
+ * dual mapped, see asm_set_dual_mapping()).
  */
 void *asm_get_code(assemblyline_t al);
 
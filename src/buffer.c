@@ -0,0 +1,333 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements mapping the internal buffer of an instance in huge pages, within a
+ * reserved range of address space or twice from a memory file, and growing
+ * it*/
+#define _GNU_SOURCE 1 // NOLINT
+#include "buffer.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define PROT_RWX (PROT_READ | PROT_WRITE | PROT_EXEC)
+// selects when transparent huge pages are used: always, madvise or never
+#define THP_ENABLED "/sys/kernel/mm/transparent_hugepage/enabled"
+
+/**
+ * checks if transparent huge pages back regions advised MADV_HUGEPAGE, ie.
+ * they are not disabled (or unavailable)
+ */
+static bool thp_enabled(void) {
+
+  FILE *file = fopen(THP_ENABLED, "r");
+  if (file == NULL)
+    return false;
+  char modes[64] = {0};
+  bool read = fgets(modes, sizeof(modes), file) != NULL;
+  fclose(file);
+  return read && strstr(modes, "[never]") == NULL;
+}
+
+/**
+ * maps @param len bytes (rounded up to whole pages and updated) of readable,
+ * writable and executable memory, or of address space reserved without access
+ * if @param reserve is set. With @param huge the memory is backed by huge pages
+ * if possible: explicitly with MAP_HUGETLB (unless only reserved), otherwise
+ * by advising transparent huge pages for a region aligned to their size. The
+ * page size used is stored in @param page_size: huge pages are reported if
+ * mapped explicitly or if advising them succeeds while transparent huge pages
+ * are enabled, though the kernel backs the region with base pages until it
+ * finds free huge pages. Returns NULL on failure.
+ */
+static uint8_t *map_buffer(size_t *len, bool reserve, bool huge,
+                           size_t *page_size) {
+
+  int prot = reserve ? PROT_NONE : PROT_RWX;
+  int flags = MAP_ANONYMOUS | MAP_PRIVATE;
+#ifdef MAP_NORESERVE
+  if (reserve)
+    flags |= MAP_NORESERVE;
+#endif
+  *page_size = (size_t)sysconf(_SC_PAGESIZE);
+  *len = ROUND_TO_PAGE(*len, huge ? HUGE_PAGE_SIZE : *page_size);
+  uint8_t *buf = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (huge && !reserve) {
+    buf = mmap(NULL, *len, prot, flags | MAP_HUGETLB, -1, 0);
+    if (buf != MAP_FAILED) {
+      *page_size = HUGE_PAGE_SIZE;
+      return buf;
+    }
+  }
+#endif
+  if (!huge) {
+    buf = mmap(NULL, *len, prot, flags, -1, 0);
+    return buf != MAP_FAILED ? buf : NULL;
+  }
+  // map a huge page more than needed and trim the region down to one aligned
+  // to huge pages
+  uint8_t *region = mmap(NULL, *len + HUGE_PAGE_SIZE, prot, flags, -1, 0);
+  if (region == MAP_FAILED)
+    return NULL;
+  buf = (uint8_t *)ROUND_TO_PAGE((uintptr_t)region, HUGE_PAGE_SIZE);
+  if (buf > region)
+    munmap(region, buf - region);
+  munmap(buf + *len, region + HUGE_PAGE_SIZE - buf);
+#ifdef MADV_HUGEPAGE
+  if (madvise(buf, *len, MADV_HUGEPAGE) == 0 && thp_enabled())
+    *page_size = HUGE_PAGE_SIZE;
+#endif
+  return buf;
+}
+
+/**
+ * maps the bytes from @param start to @param len of the memory file
+ * @param fd readable and writable at @param rw and readable and executable at
+ * @param rx, replacing the address space reserved there. If @param rw is NULL
+ * (and @param start is 0) both are mapped anywhere and stored in @param rw and
+ * @param rx.
+ */
+static int map_views(int fd, size_t start, size_t len, uint8_t **rw,
+                     uint8_t **rx) {
+
+  bool fixed = *rw != NULL;
+  int flags = MAP_SHARED | (fixed ? MAP_FIXED : 0);
+  uint8_t *w = mmap(fixed ? *rw + start : NULL, len - start,
+                    PROT_READ | PROT_WRITE, flags, fd, (off_t)start);
+  FAIL_SYS(w == MAP_FAILED, "failed to map writable view\n", EXIT_FAILURE)
+  uint8_t *x = mmap(fixed ? *rx + start : NULL, len - start,
+                    PROT_READ | PROT_EXEC, flags, fd, (off_t)start);
+  if (x == MAP_FAILED) {
+    perror("Error: ");
+    if (!fixed)
+      munmap(w, len);
+    return EXIT_FAILURE;
+  }
+  if (!fixed) {
+    *rw = w;
+    *rx = x;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * maps a memory file of @param committed bytes twice, writable at the address
+ * stored in @param buf and executable at the one stored in @param exec, within
+ * two ranges of @param reserved bytes of address space (or only the committed
+ * bytes if 0). Stores the file descriptor in @param memfd.
+ */
+static int map_dual(size_t committed, size_t reserved, uint8_t **buf,
+                    uint8_t **exec, int *memfd) {
+
+#ifdef MFD_CLOEXEC
+  *buf = NULL;
+  *exec = NULL;
+  *memfd = memfd_create("assemblyline", MFD_CLOEXEC);
+  FAIL_SYS(*memfd == -1, "failed to create memory file\n", EXIT_FAILURE)
+  int flags = MAP_ANONYMOUS | MAP_PRIVATE;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  int ret = ftruncate(*memfd, (off_t)committed) == -1 ? EXIT_FAILURE
+                                                       : EXIT_SUCCESS;
+  if (ret == EXIT_SUCCESS && reserved > 0) {
+    *buf = mmap(NULL, reserved, PROT_NONE, flags, -1, 0);
+    *exec = mmap(NULL, reserved, PROT_NONE, flags, -1, 0);
+    if (*buf == MAP_FAILED || *exec == MAP_FAILED)
+      ret = EXIT_FAILURE;
+  }
+  if (ret == EXIT_SUCCESS)
+    ret = map_views(*memfd, 0, committed, buf, exec);
+  if (ret == EXIT_SUCCESS)
+    return EXIT_SUCCESS;
+  perror("Error: ");
+  size_t len = reserved > 0 ? reserved : committed;
+  if (*buf != NULL && *buf != MAP_FAILED)
+    munmap(*buf, len);
+  if (*exec != NULL && *exec != MAP_FAILED)
+    munmap(*exec, len);
+  close(*memfd);
+  return EXIT_FAILURE;
+#else
+  (void)committed;
+  (void)reserved;
+  (void)buf;
+  (void)exec;
+  (void)memfd;
+  FAIL_IF_MSG(true, "dual mapping needs memfd_create\n")
+#endif
+}
+
+int map_code(size_t len, bool dual, uint8_t **buf, uint8_t **exec,
+             int *memfd) {
+
+  *exec = NULL;
+  *memfd = -1;
+  *buf = dual ? MAP_FAILED
+              : mmap(NULL, len, PROT_RWX, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  // memory that is both writable and executable may be disallowed (W^X), in
+  // which case it is mapped twice instead
+  if (*buf != MAP_FAILED)
+    return EXIT_SUCCESS;
+  return map_dual(len, 0, buf, exec, memfd);
+}
+
+void unmap_code(uint8_t *buf, uint8_t *exec, int memfd, size_t len) {
+
+  if (munmap((void *)buf, len) == -1)
+    perror("Error: ");
+  if (exec != NULL && munmap((void *)exec, len) == -1)
+    perror("Error: ");
+  if (memfd != -1)
+    close(memfd);
+}
+
+int move_buffer(assemblyline_t al, size_t len, size_t reserve, bool huge,
+                bool dual) {
+
+  FAIL_IF_MSG(al->external, "cannot map an external buffer\n");
+  // buffer lengths are ints
+  FAIL_IF_MSG((reserve > 0 ? reserve : len) > INT_MAX - HUGE_PAGE_SIZE,
+              "buffer length exceeds INT_MAX\n");
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t map_len = reserve > 0 ? reserve : len;
+  uint8_t *buf = NULL;
+  uint8_t *exec = NULL;
+  int memfd = -1;
+  // a memory file is only mapped in pages of the system page size
+  if (dual)
+    map_len = ROUND_TO_PAGE(map_len, page_size);
+  else
+    buf = map_buffer(&map_len, reserve > 0, huge, &page_size);
+  FAIL_SYS(!dual && buf == NULL, "failed to map buffer\n", EXIT_FAILURE)
+  // only the pages of a reserved range that are committed are accessible
+  size_t committed = map_len;
+  if (reserve > 0) {
+    committed = ROUND_TO_PAGE(len, page_size);
+    if (committed > map_len)
+      committed = map_len;
+  }
+  if (dual)
+    FAIL_IF(map_dual(committed, reserve > 0 ? map_len : 0, &buf, &exec,
+                     &memfd));
+  if (!dual && reserve > 0 && mprotect(buf, committed, PROT_RWX) == -1) {
+    perror("Error: ");
+    munmap(buf, map_len);
+    return EXIT_FAILURE;
+  }
+  size_t copied = (size_t)al->buffer_len < committed ? (size_t)al->buffer_len
+                                                      : committed;
+  memcpy(buf, al->buffer, copied);
+  unmap_buffer(al);
+  al->buffer = buf;
+  al->buffer_len = (int)committed;
+  al->reserved = reserve > 0 ? map_len : 0;
+  al->page_size = page_size;
+  al->huge_pages = huge;
+  al->exec = exec;
+  al->memfd = memfd;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * commits the first @param len bytes of the range reserved for the internal
+ * buffer of instance @param al
+ */
+static int commit_reserved(assemblyline_t al, size_t len) {
+
+  if (al->exec == NULL) {
+    FAIL_SYS(mprotect(al->buffer + al->buffer_len, len - al->buffer_len,
+                      PROT_RWX) == -1,
+             "failed to commit reserved buffer\n", EXIT_FAILURE)
+  } else {
+    // the memory file grows and both views of it are extended in place
+    FAIL_SYS(ftruncate(al->memfd, (off_t)len) == -1,
+             "failed to grow memory file\n", EXIT_FAILURE)
+    FAIL_IF(map_views(al->memfd, al->buffer_len, len, &al->buffer, &al->exec));
+  }
+  al->buffer_len = (int)len;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * grows the memory file of the dual mapped internal buffer of instance
+ * @param al to @param len bytes and maps both views of it anew, which copies
+ * nothing
+ */
+static int remap_dual(assemblyline_t al, size_t len) {
+
+  len = ROUND_TO_PAGE(len, al->page_size);
+  FAIL_IF_MSG(len > INT_MAX, "buffer length exceeds INT_MAX\n");
+  FAIL_SYS(ftruncate(al->memfd, (off_t)len) == -1,
+           "failed to grow memory file\n", EXIT_FAILURE)
+  uint8_t *buf = NULL;
+  uint8_t *exec = NULL;
+  FAIL_IF(map_views(al->memfd, 0, len, &buf, &exec));
+  munmap(al->buffer, al->buffer_len);
+  munmap(al->exec, al->buffer_len);
+  al->buffer = buf;
+  al->exec = exec;
+  al->buffer_len = (int)len;
+  return EXIT_SUCCESS;
+}
+
+int grow_buffer(assemblyline_t al, size_t needed) {
+
+  size_t len = 2 * (size_t)al->buffer_len;
+  len = needed > len ? needed : len;
+  if (al->reserved > 0) {
+    // commit at least twice the pages committed so far, up to the end of the
+    // reserved range, so the code never moves
+    FAIL_IF_VAR(needed > al->reserved,
+                "exceeded reserved address space: %zu bytes\n", al->reserved)
+    len = ROUND_TO_PAGE(len, al->page_size);
+    return commit_reserved(al, len > al->reserved ? al->reserved : len);
+  }
+  if (al->exec != NULL)
+    return remap_dual(al, len);
+  // remapping would not keep a buffer aligned to huge pages (nor grow one
+  // mapped with MAP_HUGETLB), so it is mapped anew at twice the size
+  if (al->huge_pages)
+    return move_buffer(al, len, 0, true, false);
+#ifdef __linux__
+  // grow the internal memory buffer by as many MEM_BUFFER steps as needed
+  // with a single remap
+  int steps = (needed - al->buffer_len + MEM_BUFFER - 1) / MEM_BUFFER;
+  void *resize = mremap(al->buffer, al->buffer_len,
+                        al->buffer_len + steps * MEM_BUFFER, MREMAP_MAYMOVE);
+  // NOLINTNEXTLINE(performance-no-int-to-ptr)
+  FAIL_SYS(resize == MAP_FAILED, "failed to resize buffer\n", EXIT_FAILURE)
+  al->buffer_len += steps * MEM_BUFFER;
+  al->buffer = (uint8_t *)resize;
+  return EXIT_SUCCESS;
+#else
+  fprintf(stderr, "internal buffer too small. Not running on Linux, "
+                  "Thus there is no mremap. Use your own buffer, or "
+                  "implement another strategy. ");
+  return EXIT_FAILURE;
+#endif
+}
+
+void unmap_buffer(assemblyline_t al) {
+
+  size_t len = al->reserved > 0 ? al->reserved : (size_t)al->buffer_len;
+  unmap_code(al->buffer, al->exec, al->memfd, len);
+}
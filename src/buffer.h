@@ -0,0 +1,68 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for mapping the internal buffer of an instance in huge
+ * pages, within a reserved range of address space or twice from a memory file,
+ * and growing it*/
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * maps @param len bytes of memory for code at @param buf, which is readable,
+ * writable and executable unless @param dual is set or such memory is
+ * disallowed: then it is mapped twice from a memory file (stored in
+ * @param memfd), writable at @param buf and executable at @param exec.
+ * Otherwise @param exec is NULL and @param memfd is -1.
+ */
+int map_code(size_t len, bool dual, uint8_t **buf, uint8_t **exec,
+             int *memfd);
+
+/**
+ * unmaps the @param len bytes of code mapped by map_code() at @param buf,
+ * @param exec and @param memfd
+ */
+void unmap_code(uint8_t *buf, uint8_t *exec, int memfd, size_t len);
+
+/**
+ * maps the internal buffer of instance @param al anew with @param len bytes
+ * committed, within a range of @param reserve bytes of address space (or only
+ * those bytes if 0), in huge pages if @param huge is set and, if @param dual
+ * is set, twice from a memory file (once writable and once executable), and
+ * moves its code there (see asm_set_reserve(), asm_set_huge_pages() and
+ * asm_set_dual_mapping()). Falls back to the system page size if huge pages
+ * cannot be had, which dual mapped buffers always use.
+ */
+int move_buffer(assemblyline_t al, size_t len, size_t reserve, bool huge,
+                bool dual);
+
+/**
+ * grows the internal buffer of instance @param al to at least @param needed
+ * bytes: within its reserved range, by growing its memory file, by mapping
+ * it anew in huge pages, or else by remapping it
+ */
+int grow_buffer(assemblyline_t al, size_t needed);
+
+/**
+ * unmaps the internal buffer of instance @param al (or the whole range reserved
+ * for it)
+ */
+void unmap_buffer(assemblyline_t al);
+
+#endif
@@ -0,0 +1,305 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements the typed instruction builder: operands given as C values are
+ * mapped straight to the fields of struct instr, skipping the tokenizer and
+ * the instruction and register name lookups*/
+#include "builder.h"
+#include "instr_parser.h"
+#include "lookup_hash.h"
+#include "parser.h"
+#include "reg_parser.h"
+#include "reorder.h"
+#include "tokenizer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// asm_register values hold the register class above the register number
+#define REG_NUM_MASK 0xf
+#define REG_CLASS_MASK (~REG_NUM_MASK)
+// register numbers from r8 onwards are extended registers
+#define EXT_REG_NUM 8
+#define NUM_OF_MMX_REGS 8
+
+// a mnemonic is converted to its instruction by its offset from adc, so both
+// enums must list the same instructions in the same order (lookup_tables.h
+// asserts the offset of every mnemonic)
+_Static_assert(AL_XOR + 1 == NUM_OF_INSTR_NAMES - adc,
+               "enum asm_mnemonic and asm_instr differ in length");
+
+/**
+ * converts @param reg to its asm_reg representation (or reg_error) and stores
+ * the operand type it denotes ('r', 'v' or 'y') in @param type
+ */
+static asm_reg to_asm_reg(enum asm_register reg, char *type) {
+
+  unsigned int num = reg & REG_NUM_MASK;
+  bool ext = num >= EXT_REG_NUM;
+  *type = 'r';
+  switch (reg & REG_CLASS_MASK) {
+  case AL_RAX:
+    return (ext ? ext64 : reg64) | num;
+  case AL_EAX:
+    return (ext ? ext32 : reg32) | num;
+  case AL_AX:
+    return (ext ? ext16 : reg16) | num;
+  case AL_AL:
+    return (ext ? ext8 : reg8) | num;
+  case AL_AH & REG_CLASS_MASK:
+    // ah, ch, dh and bh share their numbers with spl, bpl, sil and dil
+    return IN_RANGE(reg, AL_AH, AL_BH) ? noext8 | num : reg_error;
+  case AL_MM0:
+    return num < NUM_OF_MMX_REGS ? mmx64 | (mm0 + num) : reg_error;
+  case AL_XMM0:
+    *type = 'v';
+    return mmx64 | (mm0 + num);
+  case AL_YMM0:
+    *type = 'y';
+    return mmx64 | (mm0 + num);
+  default:
+    return reg_error;
+  }
+}
+
+enum asm_register to_register(asm_reg reg) {
+
+  if (reg & (reg_none | reg_error))
+    return AL_NOREG;
+  unsigned int num = reg & REG_NUM_MASK;
+  switch (reg & MODE_MASK) {
+  case reg64:
+  case ext64:
+    return AL_RAX | num;
+  case reg32:
+  case ext32:
+    return AL_EAX | num;
+  case reg16:
+  case ext16:
+    return AL_AX | num;
+  case reg8:
+  case ext8:
+    return AL_AL | num;
+  case noext8:
+    return (AL_AH & REG_CLASS_MASK) | num;
+  default:
+    return AL_NOREG;
+  }
+}
+
+/**
+ * sets the keyword of @param instr_data for an operand of @param size bytes
+ */
+static int set_size(struct instr *instr_data, uint8_t size) {
+
+  switch (size) {
+  case 0:
+  case sizeof(uint64_t):
+    break;
+  case sizeof(uint8_t):
+    instr_data->keyword.is_byte = true;
+    break;
+  case sizeof(uint16_t):
+    instr_data->keyword.is_word = true;
+    break;
+  case sizeof(uint32_t):
+    instr_data->keyword.is_dword = true;
+    break;
+  default:
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * sets the memory reference @param opd as operand @param opd_pos of
+ * @param instr_data the way mem_tok() reads "[base+scale*index+disp]"
+ */
+static int mem_operand(struct instr *instr_data,
+                       const struct asm_operand *opd, int opd_pos) {
+
+  FAIL_IF_MSG(instr_data->mem_disp, "only one memory operand is allowed\n");
+  FAIL_IF_MSG(!IN_RANGE(opd->value, INT32_MIN, (int64_t)UINT32_MAX),
+              "memory displacement exceeds 32 bits\n");
+  char type = '\0';
+  instr_data->mem_disp = true;
+  instr_data->mem_index = opd_pos;
+  instr_data->sib_disp = SIB;
+  instr_data->opd[opd_pos].type = 'm';
+  if (opd->reg != AL_NOREG)
+    instr_data->opd[opd_pos].reg = to_asm_reg(opd->reg, &type);
+  if (opd->index != AL_NOREG) {
+    instr_data->opd[opd_pos].index = to_asm_reg(opd->index, &type);
+    FAIL_IF_MSG(set_scale(instr_data, opd->scale), "invalid scale\n");
+  } else {
+    FAIL_IF_MSG(opd->scale > 1, "scale without an index register\n");
+  }
+  bool neg = false;
+  if (opd->reg == AL_NOREG && opd->index == AL_NOREG) {
+    // absolute address
+    instr_data->mem_value = true;
+    instr_data->mem_const = (uint32_t)opd->value;
+  } else if (opd->value < 0) {
+    // if displacement is negative represent in 2's complement
+    neg = true;
+    instr_data->mem_offset = process_neg_disp((uint32_t)-opd->value);
+  } else {
+    instr_data->mem_offset = (uint32_t)opd->value;
+  }
+  get_mod_disp(instr_data, neg);
+  FAIL_IF_MSG(set_size(instr_data, opd->size), "invalid operand size\n");
+  return EXIT_SUCCESS;
+}
+
+/**
+ * maps the operand types of @param instr_data (ex: 'r', 'm' and 'i') to their
+ * operand_format
+ */
+static operand_format to_opd_format(const struct instr *instr_data) {
+
+  uint64_t types = 0;
+  for (int i = 0; i < NUM_OF_OPD; i++)
+    types |= (uint64_t)(uint8_t)instr_data->opd[i].type << (i * BIT_8);
+  switch (types) {
+  case 0:
+  case 'i':
+    return n;
+  case 'm':
+    return m;
+  case 'r':
+    return r;
+  case PACK2('m', 'i'):
+    return mi;
+  case PACK2('m', 'r'):
+    return mr;
+  case PACK2('m', 'v'):
+    return mv;
+  case PACK2('m', 'y'):
+    return my;
+  case PACK2('r', 'i'):
+    return ri;
+  case PACK2('r', 'm'):
+    return rm;
+  case PACK2('r', 'r'):
+    return rr;
+  case PACK2('r', 'v'):
+    return rv;
+  case PACK2('v', 'i'):
+    return vi;
+  case PACK2('v', 'm'):
+    return vm;
+  case PACK2('v', 'r'):
+    return vr;
+  case PACK2('v', 'v'):
+    return vv;
+  case PACK2('y', 'm'):
+    return ym;
+  case PACK2('y', 'y'):
+    return yy;
+  case PACK3('m', 'r', 'i'):
+    return mri;
+  case PACK3('m', 'r', 'r'):
+    return mrr;
+  case PACK3('r', 'm', 'i'):
+    return rmi;
+  case PACK3('r', 'm', 'r'):
+    return rmr;
+  case PACK3('r', 'r', 'i'):
+    return rri;
+  case PACK3('r', 'r', 'm'):
+    return rrm;
+  case PACK3('r', 'r', 'r'):
+    return rrr;
+  case PACK3('v', 'v', 'm'):
+    return vvm;
+  case PACK3('v', 'v', 'v'):
+    return vvv;
+  case PACK3('y', 'y', 'm'):
+    return yym;
+  case PACK3('y', 'y', 'y'):
+    return yyy;
+  case PACK4('v', 'v', 'm', 'i'):
+    return vvmi;
+  case PACK4('v', 'v', 'v', 'i'):
+    return vvvi;
+  case PACK4('y', 'y', 'm', 'i'):
+    return yymi;
+  case PACK4('y', 'y', 'y', 'i'):
+    return yyyi;
+  default:
+    return opd_error;
+  }
+}
+
+int build_instr(struct instr *instr_data, enum asm_mnemonic mnemonic,
+                const struct asm_operand opds[]) {
+
+  const char *name = instr_to_str(adc + mnemonic);
+  FAIL_IF_VAR(name == NULL, "unknown mnemonic: %d\n", mnemonic);
+  strcpy(instr_data->instruction, name);
+  // default mod displacement value r/m is register
+  instr_data->mod_disp = MOD24;
+  for (int i = 0; i < NUM_OF_OPD; i++) {
+    instr_data->opd[i].reg = reg_none;
+    instr_data->opd[i].index = reg_none;
+  }
+  for (int i = 0; opds[i].kind != AL_OPD_NONE; i++) {
+    FAIL_IF_MSG(i >= NUM_OF_OPD, "too many operands\n");
+    FAIL_IF_MSG(i > 0 && instr_data->opd[i - 1].type == 'i',
+                "cannot have an operand after immediate\n");
+    struct operand *opd = &instr_data->opd[i];
+    switch (opds[i].kind) {
+    case AL_OPD_REG:
+      opd->reg = to_asm_reg(opds[i].reg, &opd->type);
+      FAIL_IF_VAR(opd->reg == reg_error,
+                  "invalid register for instruction: %s\n", name);
+      break;
+    case AL_OPD_IMM:
+      opd->type = 'i';
+      instr_data->imm = true;
+      instr_data->cons = opds[i].value;
+      break;
+    case AL_OPD_MEM:
+      FAIL_IF(mem_operand(instr_data, &opds[i], i));
+      break;
+    default:
+      FAIL_IF_VAR(true, "illegal operand kind for instruction: %s\n", name);
+    }
+  }
+  operand_format opd_format = to_opd_format(instr_data);
+  instr_data->key = instr_to_key(adc + mnemonic, opd_format);
+  FAIL_IF_VAR(instr_data->key == INSTR_ERROR,
+              "unsupported or illegal operands for instruction: %s\n", name);
+  return EXIT_SUCCESS;
+}
+
+int emit_operands(assemblyline_t al, enum asm_mnemonic mnemonic,
+                  const struct asm_operand opds[]) {
+
+  struct instr new_instr = {0};
+  // an immediate is treated like a decimal one (see str_to_instr())
+  new_instr.assembly_opt = al->assembly_opt;
+  if (new_instr.assembly_opt & SMART_MOV_IMM)
+    new_instr.assembly_opt &= ~NASM_MOV_IMM;
+  FAIL_IF_ERR(build_instr(&new_instr, mnemonic, opds));
+  FAIL_IF_ERR(encode_instr(&new_instr));
+  unsigned int buf_pos = al->offset;
+  // chunk breaks are only counted by asm_assemble_string_counting_chunks()
+  int chunk_brks = 0;
+  FAIL_IF_ERR(emit_instr(al, &new_instr, &buf_pos, &chunk_brks));
+  // every instruction is written by its own call
+  FAIL_IF_ERR(flush_scheduled(al, &buf_pos));
+  return (int)buf_pos;
+}
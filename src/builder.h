@@ -0,0 +1,50 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for assembling instructions built from typed operands
+ * without going through their string representation*/
+#ifndef BUILDER_H
+#define BUILDER_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * converts the general purpose register @param reg to its asm_register value,
+ * or AL_NOREG if it is none or another register
+ */
+enum asm_register to_register(asm_reg reg);
+
+/**
+ * fills in the zeroed @param instr_data (except for its assembly options) with
+ * @param mnemonic and the operands @param opds, terminated by AL_OPD_NONE,
+ * before it is encoded (see encode_instr())
+ */
+int build_instr(struct instr *instr_data, enum asm_mnemonic mnemonic,
+                const struct asm_operand opds[]);
+
+/**
+ * given an instance of @param al maps @param mnemonic and the operands
+ * @param opds (terminated by AL_OPD_NONE) to a struct instr the way the
+ * tokenizer maps their string representation and writes its machine code into
+ * the buffer field of @param al at its offset. Returns the new offset or
+ * ASM_ERROR.
+ */
+int emit_operands(assemblyline_t al, enum asm_mnemonic mnemonic,
+                  const struct asm_operand opds[]);
+
+#endif
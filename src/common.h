@@ -19,12 +19,35 @@
 #define COMMON_H
 
 #define LETTERS_IN_ALPHABET 26
-// max length of filtered assembly string
-#define FILTERED_STR_LEN 100
 // default length of internal buffer
 #define MEM_BUFFER 6000
 // actual writable buffer size = MEM_BUFFER - BUFFER_TOLERANCE
 #define BUFFER_TOLERANCE 20
+// size of the huge pages internal buffers may be backed by
+#define HUGE_PAGE_SIZE 0x200000
+// rounds @param len up to a whole number of pages of @param page bytes
+#define ROUND_TO_PAGE(len, page) (((len) + (page)-1) / (page) * (page))
+// an x86 instruction is at most 15 bytes long
+#define MAX_X86_INSTR_LEN 15
+// longest nop instruction (see nop_padding())
+#define MAX_NOP_LEN 11
+// jumps crossing or ending on this boundary miss the decoded icache
+#define BRANCH_BOUNDARY 32
+// largest alignment of the align directive (the internal buffer is page
+// aligned)
+#define MAX_ALIGN 4096
+// align fills longer gaps by jumping over them instead of with nops
+#define MAX_ALIGN_NOPS 3
+// most instructions of a chunk lengthened to pad it and redundant prefixes
+// added to each (more slow down decoding on some cores, see lengthen.c)
+#define MAX_CHUNK_INSTRS 16
+#define MAX_PAD_PREFIXES 3
+// most instructions queued for a later one to fill a chunk gap (see
+// reorder.c)
+#define MAX_REORDER_INSTRS 32
+// most instructions of a straight-line block list scheduled at once (see
+// scheduler.c)
+#define MAX_SCHEDULE_INSTRS 256
 // used when 0 cannot denote none
 #define NA (-1)
 // denotes an error during assembly
@@ -137,6 +160,13 @@
 #define OPD_FORMAT_LEN 4
 #define INSTRUCTION_CHAR_LEN 15
 
+// template placeholders are assembled with these values (all bytes are non
+// zero so the encoded width of an immediate can be told from its value)
+#define PLACEHOLDER_IMM 0x8877665544332211
+#define PLACEHOLDER_DISP 0x5a4b3c2d
+#define MAX_PLACEHOLDER_LEN 255
+#define MAX_LABEL_LEN 255
+
 // opcode encoding length
 #define MAX_OPCODE_LEN 15
 #define MAX_INSTR_LEN 14
@@ -149,13 +179,6 @@
   (reduce) &= (mask);                                                          \
   (set) = true;
 
-// keyword length
-#define DWORD_LEN 5
-#define BYTE_LEN 4
-#define LONG_LEN 4
-#define SHORT_LEN 5
-#define FAR_LEN 3
-
 // mod values for the ModR/M Byte
 #define MOD8 0b01000000
 #define MOD16 0b10000000
@@ -199,6 +222,9 @@
 #define NOP9 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00
 #define NOP10 0x66, 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00
 #define NOP11 0x66, 0x66, 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00
+#define INT3 0xcc
+#define JMP_REL8 0xeb
+#define JMP_REL32 0xe9
 
 // fail conditions
 #define FAIL_IF(EXP)                                                           \
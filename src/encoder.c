@@ -144,7 +144,7 @@ static int encode_three_opds(struct instr *instrc, int r, const int m, int v) {
  */
 static int encode_special_opd(struct instr *instrc, int m, int i) {
 
-  struct operand no_register = {NULL, {'\0'}, reg_none, {'\0'}, reg_none, 0};
+  struct operand no_register = {reg_none, reg_none, 0};
   switch (INSTR_TABLE[instrc->key].encode_operand) {
   case M:
     encode_mem(instrc, m);
@@ -242,6 +242,14 @@ static void nasm_register_size_optimize(struct instr *instrc) {
 static void encode_imm_data_transfer(struct instr *instrc) {
   // calculate value for +rd and +rw
   instrc->rd_offset = instrc->opd[0].reg & VALUE_MASK;
+  // a 32-bit register takes a 32-bit immediate however it is spelled (ex:
+  // -1 or 4294967295), which must not be padded to 64 bits
+  if (!instrc->mem_disp &&
+      IN_RANGE(instrc->opd[0].reg & MODE_MASK, reg32, ext32)) {
+    instrc->cons &= MAX_UNSIGNED_32BIT;
+    if (instrc->cons >= NEG32BIT_CHECK)
+      instrc->reduced_imm = true;
+  }
   // only condition for mov with M operand encoding implementation
   // check if immediate operand is a negative 32 bit value
   if (IN_RANGE(instrc->cons, NEG32BIT + 1, NEG64BIT) &&
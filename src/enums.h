@@ -18,8 +18,6 @@
 #ifndef ENUMS_H
 #define ENUMS_H
 
-typedef enum { BEGIN, FIRST_CH, SPACE_FOUND } filter_op;
-
 // used to identify special opcodes (must be greater than 255 to avoid conflict
 // with instruction opcode)
 typedef enum {
@@ -43,7 +41,12 @@ typedef enum {
   rex_b = 0x01
 } prefix_encoding;
 
-typedef enum { CHUNK_COUNT, CHUNK_FITTING, ASSEMBLE } ASM_MODE;
+typedef enum {
+  CHUNK_COUNT,
+  CHUNK_FITTING,
+  ASSEMBLE,
+  BRANCH_PADDING
+} ASM_MODE;
 
 // describes how operands are encoded
 typedef enum {
@@ -104,6 +107,7 @@ typedef enum {
 
   EOI,
   LABEL,
+  ALIGN,
   SKIP,
   adc,
   adcx,
@@ -299,7 +303,9 @@ typedef enum {
   xbegin,
   xchg,
   xend,
-  xor
+  xor,
+  // number of values (instructions start at adc)
+  NUM_OF_INSTR_NAMES
 } asm_instr;
 
 // used to categorize instruction based on their functionality
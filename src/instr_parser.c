@@ -18,6 +18,7 @@
  and operand format of instruction*/
 #include "instr_parser.h"
 #include "common.h"
+#include "lookup_tables.h"
 #include "instruction_data.h"
 #include "instructions.h"
 #include <string.h>
@@ -26,7 +27,7 @@ operand_format get_opd_format(char *opd_en) {
 
   int i = NA;
   if (opd_en[0] != '\0')
-    i = opd_format_table_index[opd_en[0] - 'a'] - 1;
+    i = OPD_FORMAT_INDEX[opd_en[0] - 'a'] - 1;
   // find the correct operand format enum given the corresponding string
   while (OPD_FORMAT_TABLE[++i].val != opd_error) {
     if (!strcasecmp(opd_en, OPD_FORMAT_TABLE[i].str))
@@ -39,30 +40,44 @@ operand_format get_opd_format(char *opd_en) {
 
 int str_to_instr_key(char *instruction, operand_format opd_layout) {
 
-  int i = 0;
-  // set index of INSTR_TABLE[] to the first letter of instruction
-  if (IN_RANGE(instruction[0], 'a', 'z'))
-    i = instr_table_index[instruction[0] - 'a'] - 1;
-  else
+  uint64_t name_lo = 0;
+  uint64_t name_hi = 0;
+  lookup_hash_pack(instruction, &name_lo, &name_hi);
+  // resolve the (instruction, operand format) pair with a single probe
+  uint64_t hash = lookup_hash_combine(name_lo, name_hi, opd_layout);
+  unsigned int bucket = lookup_hash_mix(hash, 0) & (INSTR_HASH_BUCKETS - 1);
+  unsigned int slot = lookup_hash_mix(hash, INSTR_HASH_DISP[bucket]) &
+                      (INSTR_HASH_SLOTS - 1);
+  const struct instr_hash_entry *entry = &INSTR_HASH_TABLE[slot];
+  // the slot only holds a candidate, verify it is the same instruction
+  if (entry->name_lo == name_lo && entry->name_hi == name_hi &&
+      entry->opd_format == (int)opd_layout)
+    return entry->key;
+  // INSTR_TABLE entry is not found for instruction string and operand format
+  return INSTR_ERROR;
+}
+
+int instr_to_key(asm_instr name, operand_format opd_layout) {
+
+  if (name <= SKIP || name >= INSTR_NAMES || INSTR_NAME_KEY[name] < 0)
     return INSTR_ERROR;
-  // search for instruction entry in INSTR_TABLE[]
-  while (INSTR_TABLE[++i].name != NA) {
-    if (INSTR_TABLE[i].instr_name[0] != '\0') {
-      // compare intruction strings
-      if (!strcmp(instruction, INSTR_TABLE[i].instr_name)) {
-        int found_instr = INSTR_TABLE[i].name;
-        while (INSTR_TABLE[i].name == found_instr) {
-          // compare operand formats
-          if (INSTR_TABLE[i].opd_format[0] == opd_layout ||
-              INSTR_TABLE[i].opd_format[1] == opd_layout)
-            return i;
-          i++;
-        }
-        // operand format is not found for instruction string
-        return INSTR_ERROR;
-      }
-    }
-  }
-  // INSTR_TABLE entry is not found for instruction string
+  // the operand formats of an instruction are stored contiguously
+  for (int key = INSTR_NAME_KEY[name]; INSTR_TABLE[key].name == (int)name;
+       key++)
+    for (int i = 0; i < VALID_OPERAND_FORMATS; i++)
+      if (INSTR_TABLE[key].opd_format[i] == (int)opd_layout)
+        return key;
   return INSTR_ERROR;
 }
+
+const char *instr_to_str(asm_instr name) {
+
+  if (name <= SKIP || name >= INSTR_NAMES || INSTR_NAME_KEY[name] < 0)
+    return NULL;
+  return INSTR_TABLE[INSTR_NAME_KEY[name]].instr_name;
+}
+
+bool has_short_encoding(int key) {
+  return INSTR_TABLE[key + 1].name == INSTR_TABLE[key].name &&
+         INSTR_TABLE[key + 1].encode_operand == S;
+}
@@ -19,6 +19,7 @@
 #define INSTR_PARSER_H
 
 #include "enums.h"
+#include <stdbool.h>
 
 /**
  * takes an operanding format string representation @param opd_en and returns
@@ -33,4 +34,23 @@ operand_format get_opd_format(char *opd_en);
  */
 int str_to_instr_key(char *instruction, operand_format opd_layout);
 
+/**
+ * takes an asm_instr enum representation of an instruction @param name and an
+ * operand_format enum representation @param opd_layout and returns the index
+ * key to the matching INSTR_TABLE[] entry or INSTR_ERROR.
+ */
+int instr_to_key(asm_instr name, operand_format opd_layout);
+
+/**
+ * returns the null-terminated string representation of the instruction
+ * @param name or NULL if there is no such instruction
+ */
+const char *instr_to_str(asm_instr name);
+
+/**
+ * checks if the INSTR_TABLE[] entry @param key is followed by the short (rel8)
+ * encoding of the same branch
+ */
+bool has_short_encoding(int key);
+
 #endif
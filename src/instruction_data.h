@@ -32,6 +32,17 @@ struct assemblyline {
   // points to a memory buffer location containing the first instruction
   uint8_t *buffer;
   int buffer_len;
+  // bytes of address space reserved for an internal buffer that grows in place
+  // (see asm_set_reserve()), of which the first buffer_len are committed, or 0
+  size_t reserved;
+  // size of the pages backing an internal buffer, which are huge pages if
+  // requested and available (see asm_set_huge_pages()), or 0
+  size_t page_size;
+  bool huge_pages : 1;
+  // executable view of a buffer mapped twice from the memory file memfd, whose
+  // writable view is buffer (see asm_set_dual_mapping()), or NULL and -1
+  uint8_t *exec;
+  int memfd;
   // size of assembly program in bytes (could be manually adjusted) and offset
   // of -1 denotes assembly parsing error
   int offset;
@@ -41,6 +52,45 @@ struct assemblyline {
   uint8_t assembly_opt;
   bool debug : 1;
   bool finalized : 1;
+  // set when assembling stopped at a statement that needs the whole input: a
+  // branch to a label, or an align directive in a parallel slice (see
+  // assemble_all())
+  bool reparse : 1;
+  // start and end of the last instruction written if it may macro-fuse with a
+  // following conditional jump, otherwise fuse_start is NA (see
+  // assemble_with_branch_padding())
+  int fuse_start;
+  int fuse_end;
+  // number of threads assembling large inputs (see parallel.c)
+  unsigned int threads;
+  // when not NULL the length of every instruction written is appended to it
+  struct length_log *length_log;
+  // only the lengths and positions of the code are computed, writing each
+  // instruction to the start of the buffer and no padding (see measure.c)
+  bool lengths_only : 1;
+  // pad chunks by lengthening the instructions written to them instead of with
+  // nops, which keeps track of those of the current chunk (see lengthen.c)
+  bool lengthen : 1;
+  struct chunk_instrs *chunk_instrs;
+  // fill chunk gaps with later independent instructions, which are queued
+  // until written (see reorder.c)
+  bool reorder : 1;
+  struct reorder_window *reorder_window;
+  // peephole rules rewriting the parsed input, the number of rewrites made and
+  // the bytes they saved (see peephole.c)
+  unsigned int peephole;
+  size_t peephole_count;
+  size_t peephole_saved;
+  // micro-architecture (enum asm_uarch) the parsed input is scheduled for, or
+  // AL_UARCH_NONE (see scheduler.c)
+  unsigned int uarch;
+};
+
+// lengths of a sequence of instructions in bytes
+struct length_log {
+  uint8_t *lens;
+  size_t len;
+  size_t capacity;
 };
 
 // prefix and and register byte values
@@ -57,14 +107,8 @@ struct prefix {
 };
 
 struct operand {
-  // pointer to operand in instruction string
-  char *ptr;
-  // stores the string representation of register
-  char str[MAX_REG_LEN];
   // enum representation of register
   asm_reg reg;
-  // stores the 2nd register in a memory reference
-  char sib[MAX_REG_LEN];
   // enum representation of 2nd register in
   // a memory reference
   asm_reg index;
@@ -121,6 +165,74 @@ struct instr {
   // offset for opcode determined by register size
   int op_offset;
   unsigned int rd_offset;
+  // template placeholder names of the immediate and memory displacement
+  // (point into the source string, only valid while it is being parsed)
+  const char *imm_name;
+  const char *disp_name;
+  uint8_t imm_name_len;
+  uint8_t disp_name_len;
+  // name of the label defined (key LABEL) or targeted by a branch (points into
+  // the source string, only valid while it is being parsed)
+  const char *label_name;
+  uint8_t label_name_len;
+  // index of the LABEL instruction a branch targets within its asm_program
+  uint32_t target;
+  // alignment of an ALIGN directive and the most bytes it may skip
+  uint32_t align;
+  uint32_t align_max;
+  // encoding choices that lengthen the machine code without changing what it
+  // does: redundant prefixes, 3 byte VEX, disp32 and imm32 instead of a sign
+  // extended byte (see lengthen.c)
+  uint8_t pad_prefixes;
+  bool long_vex : 1;
+  bool long_disp : 1;
+  bool long_imm : 1;
+};
+
+// the instructions written from start to end of the current chunk since its
+// beginning (or the last label, align directive or jump)
+struct chunk_instrs {
+  struct instr instrs[MAX_CHUNK_INSTRS];
+  size_t len;
+  unsigned int start;
+  unsigned int end;
+};
+
+// an immutable sequence of parsed instructions ready to be assembled
+struct asm_program {
+  struct instr *instrs;
+  size_t len;
+  size_t capacity;
+  // allow template placeholders
+  bool placeholders;
+  // number of branches to labels (see labels.c)
+  size_t num_branches;
+  // copies of trailing statements (see assemble_tail()) that the label and
+  // placeholder names of its instructions point into
+  char **tails;
+  size_t num_tails;
+};
+
+// a fixed width field of template code that a placeholder value is written to
+struct patch_point {
+  uint32_t pos;
+  uint8_t width;
+  uint16_t placeholder;
+};
+
+// machine code with patch points for the values of its placeholders
+struct asm_template {
+  uint8_t *code;
+  size_t len;
+  // chunk or branch padding is laid out for offsets congruent to start modulo
+  // boundary (0 without padding)
+  unsigned int boundary;
+  unsigned int start;
+  struct patch_point *patches;
+  size_t num_patches;
+  // null-terminated placeholder names in order of first appearance
+  char **names;
+  size_t num_names;
 };
 
 #endif
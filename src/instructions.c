@@ -46,6 +46,7 @@ const struct opd_format_table OPD_FORMAT_TABLE[] = {
 const struct instr_table INSTR_TABLE[] = {
     {{'\0'},        EOI,         {NA, NA},   NA,  OTHER,          NA,  NA,  0,  {0}},
     {{'\0'},        LABEL,       {NA, NA},   NA,  OTHER,          NA,  NA,  0,  {0}},
+    {{'\0'},        ALIGN,       {NA, NA},   NA,  OTHER,          NA,  NA,  0,  {0}},
     {{'\0'},        SKIP,        {NA, NA},   NA,  OTHER,          NA,  NA,  0,  {0}},
     {"adc",         adc,         {rr, mr},   MR,  OPERATION,      1,   NA,  3,  {REX, 0x10, REG}},
     {{'\0'},        adc,         {NA, rm},   RM,  OPERATION,      1,   NA,  3,  {REX, 0x12, REG}},
@@ -364,8 +365,3 @@ const struct instr_table INSTR_TABLE[] = {
     {{'\0'},        xor,         {NA, NA},   I,   OPERATION,      1,   NA,  2,  {REX, 0x34}},
     {"xend",        xend,        {n,  n},    NA,  CONTROL_FLOW,   NA,  NA,  3,  {0x0f, 0x01, 0xd5}},
     {{'\0'},        NA,          {NA, NA},   NA,  OTHER,          NA,  NA,  0,  {0}}};
-
-_Atomic(int) instr_table_index[LETTERS_IN_ALPHABET] = {0}; // NOLINT
-_Atomic(int) opd_format_table_index[LETTERS_IN_ALPHABET] = {0}; // NOLINT
-
-
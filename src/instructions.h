@@ -20,7 +20,6 @@
 
 #include "common.h"
 #include "enums.h"
-#include <stdatomic.h>
 
 // table for storing register string to enum mapping
 struct opd_format_table {
@@ -86,6 +85,4 @@ struct instr_table {
 
 extern const struct opd_format_table OPD_FORMAT_TABLE[];
 extern const struct instr_table INSTR_TABLE[];
-extern _Atomic(int) instr_table_index[LETTERS_IN_ALPHABET];      // NOLINT
-extern _Atomic(int) opd_format_table_index[LETTERS_IN_ALPHABET]; // NOLINT
 #endif
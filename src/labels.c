@@ -0,0 +1,227 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements labels: branches to them are resolved once the whole program is
+ * parsed and encoded with the shortest displacement that reaches them*/
+#include "labels.h"
+#include "instr_parser.h"
+#include "lengthen.h"
+#include "parser.h"
+#include "reorder.h"
+#include <stdlib.h>
+#include <string.h>
+
+// a label defined by a program
+struct label {
+  const char *name;
+  uint8_t len;
+  uint32_t index;
+};
+
+static inline bool is_branch(const struct instr *instr_data) {
+  return instr_data->key != LABEL && instr_data->label_name != NULL;
+}
+
+/**
+ * orders the labels @param a and @param b by name
+ */
+static int compare_labels(const void *a, const void *b) {
+
+  const struct label *x = a;
+  const struct label *y = b;
+  int cmp = memcmp(x->name, y->name, x->len < y->len ? x->len : y->len);
+  return cmp ? cmp : (int)x->len - (int)y->len;
+}
+
+int resolve_labels(struct asm_program *program) {
+
+  size_t num_labels = 0;
+  program->num_branches = 0;
+  for (size_t i = 0; i < program->len; i++) {
+    if (program->instrs[i].key == LABEL)
+      num_labels++;
+    else if (is_branch(&program->instrs[i]))
+      program->num_branches++;
+  }
+  if (program->num_branches == 0)
+    return EXIT_SUCCESS;
+  FAIL_IF_MSG(program->len > UINT32_MAX, "too many instructions\n");
+  struct label *labels = malloc((num_labels + 1) * sizeof(struct label));
+  FAIL_IF_MSG(labels == NULL, "failed to allocate memory\n");
+  num_labels = 0;
+  for (size_t i = 0; i < program->len; i++)
+    if (program->instrs[i].key == LABEL)
+      labels[num_labels++] =
+          (struct label){.name = program->instrs[i].label_name,
+                         .len = program->instrs[i].label_name_len,
+                         .index = i};
+  qsort(labels, num_labels, sizeof(struct label), compare_labels);
+  int ret = EXIT_SUCCESS;
+  for (size_t i = 1; i < num_labels && ret == EXIT_SUCCESS; i++) {
+    if (compare_labels(&labels[i - 1], &labels[i]))
+      continue;
+    fprintf(stderr, "assembyline: label defined more than once: %.*s\n",
+            labels[i].len, labels[i].name);
+    ret = EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < program->len && ret == EXIT_SUCCESS; i++) {
+    struct instr *branch = &program->instrs[i];
+    if (!is_branch(branch))
+      continue;
+    struct label key = {.name = branch->label_name,
+                        .len = branch->label_name_len};
+    const struct label *label = bsearch(&key, labels, num_labels,
+                                        sizeof(struct label), compare_labels);
+    if (label != NULL) {
+      branch->target = label->index;
+      continue;
+    }
+    fprintf(stderr, "assembyline: undefined label: %.*s\n", key.len, key.name);
+    ret = EXIT_FAILURE;
+  }
+  free(labels);
+  return ret;
+}
+
+/**
+ * checks if the branch @param branch has no rel32 encoding or was declared
+ * short, so it may not be widened
+ */
+static bool is_fixed_short(const struct instr *branch) {
+  return INSTR_TABLE[branch->key].encode_operand == S ||
+         branch->keyword.is_short;
+}
+
+/**
+ * writes @param branch with the displacement @param disp in its short or (if
+ * @param near is set) rel32 encoding like emit_instr()
+ */
+static int emit_branch(assemblyline_t al, const struct instr *branch,
+                       int64_t disp, bool near, unsigned int *buf_pos,
+                       int *dest) {
+
+  struct instr encoded = *branch;
+  // short displacements are recognized in their 32 bit representation
+  encoded.cons = (uint32_t)disp;
+  encoded.keyword.is_short = !near;
+  encoded.keyword.is_long = near;
+  FAIL_IF(encode_instr(&encoded));
+  return emit_instr(al, &encoded, buf_pos, dest);
+}
+
+/**
+ * widens the short branches of @param program whose displacement does not fit
+ * 8 bits in the layout @param ends to rel32 by setting @param near
+ */
+static int widen(const struct asm_program *program, const unsigned int *ends,
+                 bool *near) {
+
+  for (size_t i = 0; i < program->len; i++) {
+    const struct instr *branch = &program->instrs[i];
+    if (!is_branch(branch) || near[i])
+      continue;
+    int64_t disp = (int64_t)ends[branch->target] - ends[i];
+    if (IN_RANGE(disp, INT8_MIN, INT8_MAX))
+      continue;
+    FAIL_IF_VAR(is_fixed_short(branch),
+                "label out of range of short branch: %s\n",
+                branch->instruction);
+    near[i] = true;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * writes @param program from @param start with the branch encodings
+ * @param near and the displacements of the previous layout @param ends, which
+ * is updated to the end of every instruction. Sets @param moved if any of them
+ * changed.
+ */
+static int layout(assemblyline_t al, const struct asm_program *program,
+                  unsigned int *ends, const bool *near, unsigned int start,
+                  unsigned int *buf_pos, int *dest, bool *moved) {
+
+  *buf_pos = start;
+  if (dest != NULL)
+    *dest = 0;
+  *moved = false;
+  drop_scheduled(al);
+  for (size_t i = 0; i < program->len; i++) {
+    const struct instr *instr_data = &program->instrs[i];
+    int64_t disp = (int64_t)ends[instr_data->target] - ends[i];
+    FAIL_IF(is_branch(instr_data) ? emit_branch(al, instr_data, disp, near[i],
+                                                buf_pos, dest)
+                                  : emit_instr(al, instr_data, buf_pos, dest));
+    if (ends[i] != *buf_pos) {
+      ends[i] = *buf_pos;
+      *moved = true;
+    }
+  }
+  // labels and branches are never reordered, so only the instructions after
+  // the last of them may still be queued
+  return flush_scheduled(al, buf_pos);
+}
+
+int relax_branches(assemblyline_t al, const struct asm_program *program,
+                   unsigned int *buf_pos, int *dest) {
+
+  unsigned int *ends = calloc(program->len, sizeof(unsigned int));
+  bool *near = calloc(program->len, sizeof(bool));
+  int ret = ends == NULL || near == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+  for (size_t i = 0; i < program->len && ret == EXIT_SUCCESS; i++) {
+    const struct instr *branch = &program->instrs[i];
+    if (!is_branch(branch))
+      continue;
+    // call only has a rel32 encoding
+    near[i] = branch->keyword.is_long ||
+              (INSTR_TABLE[branch->key].encode_operand != S &&
+               !has_short_encoding(branch->key));
+    if (near[i] && INSTR_TABLE[branch->key].encode_operand == S) {
+      fprintf(stderr, "assembyline: branch has no rel32 encoding: %s\n",
+              branch->instruction);
+      ret = EXIT_FAILURE;
+    }
+  }
+  // debug output is only printed for the final layout
+  bool debug = al->debug;
+  al->debug = false;
+  unsigned int start = *buf_pos;
+  // every layout starts from the code before it as it was (see lengthen.c)
+  struct chunk_instrs saved;
+  save_chunk_instrs(al, &saved);
+  // and logs the lengths of its instructions anew
+  size_t logged = al->length_log != NULL ? al->length_log->len : 0;
+  bool moved = true;
+  // branches are only ever widened, so this ends after at most one layout per
+  // branch (and usually two in total)
+  while (moved && ret == EXIT_SUCCESS) {
+    ret = widen(program, ends, near);
+    restore_chunk_instrs(al, &saved);
+    if (al->length_log != NULL)
+      al->length_log->len = logged;
+    if (ret == EXIT_SUCCESS)
+      ret = layout(al, program, ends, near, start, buf_pos, dest, &moved);
+  }
+  al->debug = debug;
+  restore_chunk_instrs(al, &saved);
+  if (ret == EXIT_SUCCESS && debug && al->length_log != NULL)
+    al->length_log->len = logged;
+  if (ret == EXIT_SUCCESS && debug)
+    ret = layout(al, program, ends, near, start, buf_pos, dest, &moved);
+  free(ends);
+  free(near);
+  return ret;
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for resolving labels and relaxing the branches to them*/
+#ifndef LABELS_H
+#define LABELS_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * sets the target of every branch to a label in @param program to the index
+ * of the LABEL instruction defining it and counts the branches. Fails if a
+ * label that is branched to is undefined or defined more than once.
+ */
+int resolve_labels(struct asm_program *program);
+
+/**
+ * writes the machine code of @param program, which contains branches to
+ * labels, into the buffer field of @param al at @param buf_pos like
+ * emit_instr() (counting chunk breaks into @param dest if applicable). Every
+ * branch starts with its short (rel8) encoding and is widened to rel32 only
+ * when its displacement does not fit, laying out the code again until no label
+ * moves.
+ */
+int relax_branches(assemblyline_t al, const struct asm_program *program,
+                   unsigned int *buf_pos, int *dest);
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*pads chunks by lengthening the instructions already written to them instead
+ * of with nops: every encoding choice keeps what the instruction does, so the
+ * machine code behaves like the nop padded code without executing any nop*/
+#include "lengthen.h"
+#include "assembler.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+// enough room for any encoding assemble_asm() produces
+#define MAX_ENCODING_LEN 32
+// bytes a disp8 or imm8 grows by when widened to 32 bits
+#define WIDENED_LEN 3
+
+// encoding choices in the order they are made: the wider fields first, so
+// fewer redundant prefixes are needed
+enum choice { LONG_DISP, LONG_IMM, LONG_VEX, PAD_PREFIX };
+
+static const unsigned int GROWTH[] = {WIDENED_LEN, WIDENED_LEN, 1, 1};
+
+/**
+ * returns the length of the machine code of @param instr_data
+ */
+static unsigned int encoded_len(const struct instr *instr_data) {
+  uint8_t code[MAX_ENCODING_LEN];
+  return assemble_asm(instr_data, code);
+}
+
+/**
+ * makes the encoding choice @param choice for @param instr_data of
+ * @param len bytes if it lengthens the instruction by exactly its growth,
+ * which must neither exceed the @param left bytes still to pad nor the
+ * longest x86 instruction
+ */
+static void lengthen(struct instr *instr_data, unsigned int *len,
+                     enum choice choice, unsigned int *left) {
+
+  unsigned int growth = GROWTH[choice];
+  if (growth > *left || *len + growth > MAX_X86_INSTR_LEN)
+    return;
+  struct instr longer = *instr_data;
+  switch (choice) {
+  case LONG_DISP:
+    longer.long_disp = true;
+    break;
+  case LONG_IMM:
+    longer.long_imm = true;
+    break;
+  case LONG_VEX:
+    longer.long_vex = true;
+    break;
+  case PAD_PREFIX:
+    if (longer.pad_prefixes >= MAX_PAD_PREFIXES)
+      return;
+    longer.pad_prefixes++;
+    break;
+  }
+  // choices that do not apply to the instruction leave its encoding alone
+  if (encoded_len(&longer) != *len + growth)
+    return;
+  *instr_data = longer;
+  *len += growth;
+  *left -= growth;
+}
+
+void track_chunk_instr(assemblyline_t al, const struct instr *instr_data,
+                       unsigned int start, unsigned int end) {
+
+  if (!al->lengthen)
+    return;
+  if (al->chunk_instrs == NULL) {
+    // without memory to keep track, chunks are padded with nops
+    al->chunk_instrs = calloc(1, sizeof(struct chunk_instrs));
+    if (al->chunk_instrs == NULL)
+      return;
+  }
+  struct chunk_instrs *chunk = al->chunk_instrs;
+  // start over at a chunk boundary or after code that was not tracked
+  if (chunk->len == 0 || chunk->end != start || start % al->chunk_size == 0) {
+    chunk->len = 0;
+    chunk->start = start;
+  }
+  // moving a jump would move its target
+  if (TYPE(instr_data->key, CONTROL_FLOW) ||
+      start / al->chunk_size != (end - 1) / al->chunk_size) {
+    chunk->len = 0;
+    chunk->start = end;
+    chunk->end = end;
+    return;
+  }
+  if (chunk->len == MAX_CHUNK_INSTRS) {
+    chunk->start += encoded_len(&chunk->instrs[0]);
+    chunk->len--;
+    memmove(chunk->instrs, chunk->instrs + 1,
+            chunk->len * sizeof(struct instr));
+  }
+  chunk->instrs[chunk->len++] = *instr_data;
+  chunk->end = end;
+}
+
+void forget_chunk_instrs(assemblyline_t al) {
+  if (al->chunk_instrs != NULL)
+    al->chunk_instrs->len = 0;
+}
+
+unsigned int lengthen_chunk(assemblyline_t al, unsigned int pad,
+                            unsigned int buf_pos) {
+
+  struct chunk_instrs *chunk = al->chunk_instrs;
+  if (!al->lengthen || chunk == NULL || chunk->len == 0 ||
+      chunk->end != buf_pos)
+    return 0;
+  struct instr longer[MAX_CHUNK_INSTRS];
+  unsigned int lens[MAX_CHUNK_INSTRS];
+  for (size_t i = 0; i < chunk->len; i++) {
+    longer[i] = chunk->instrs[i];
+    lens[i] = encoded_len(&longer[i]);
+  }
+  unsigned int left = pad;
+  for (enum choice choice = LONG_DISP; choice < PAD_PREFIX; choice++)
+    for (size_t i = 0; i < chunk->len && left > 0; i++)
+      lengthen(&longer[i], &lens[i], choice, &left);
+  // spread the prefixes over the instructions
+  for (unsigned int round = 0; round < MAX_PAD_PREFIXES && left > 0; round++)
+    for (size_t i = 0; i < chunk->len && left > 0; i++)
+      lengthen(&longer[i], &lens[i], PAD_PREFIX, &left);
+  if (left > 0)
+    return 0;
+  unsigned int pos = chunk->start;
+  for (size_t i = 0; i < chunk->len; i++) {
+    pos += assemble_asm(&longer[i], code_at(al, pos));
+    chunk->instrs[i] = longer[i];
+  }
+  chunk->end = pos;
+  return pad;
+}
+
+void save_chunk_instrs(assemblyline_t al, struct chunk_instrs *saved) {
+
+  saved->len = 0;
+  saved->start = 0;
+  saved->end = 0;
+  if (!al->lengthen || al->chunk_instrs == NULL)
+    return;
+  const struct chunk_instrs *chunk = al->chunk_instrs;
+  saved->len = chunk->len;
+  saved->start = chunk->start;
+  saved->end = chunk->end;
+  memcpy(saved->instrs, chunk->instrs, chunk->len * sizeof(struct instr));
+}
+
+void restore_chunk_instrs(assemblyline_t al,
+                          const struct chunk_instrs *saved) {
+
+  if (al->chunk_instrs == NULL)
+    return;
+  struct chunk_instrs *chunk = al->chunk_instrs;
+  unsigned int pos = saved->start;
+  for (size_t i = 0; i < saved->len; i++)
+    pos += assemble_asm(&saved->instrs[i], code_at(al, pos));
+  chunk->len = saved->len;
+  chunk->start = saved->start;
+  chunk->end = saved->end;
+  memcpy(chunk->instrs, saved->instrs, saved->len * sizeof(struct instr));
+}
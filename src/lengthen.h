@@ -0,0 +1,64 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for padding chunks by lengthening instructions*/
+#ifndef LENGTHEN_H
+#define LENGTHEN_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * records @param instr_data, written from @param start to @param end of the
+ * buffer field of @param al, as an instruction of the current chunk that may
+ * be lengthened. Jumps and instructions crossing a chunk boundary are never
+ * lengthened and neither is any instruction before them.
+ */
+void track_chunk_instr(assemblyline_t al, const struct instr *instr_data,
+                       unsigned int start, unsigned int end);
+
+/**
+ * stops @param al from lengthening the instructions written so far (ex: before
+ * a label, whose address must not change)
+ */
+void forget_chunk_instrs(assemblyline_t al);
+
+/**
+ * pads the current chunk of @param al, which ends at @param buf_pos, with
+ * @param pad bytes by re-encoding its instructions with longer encodings
+ * (disp32, imm32 and 3 byte VEX instead of their short forms) and redundant
+ * prefixes. The buffer must have room for @param pad more bytes. Returns
+ * @param pad or 0 if the instructions cannot absorb all of it, in which case
+ * nothing is changed.
+ */
+unsigned int lengthen_chunk(assemblyline_t al, unsigned int pad,
+                            unsigned int buf_pos);
+
+/**
+ * copies the instructions of the current chunk of @param al to @param saved
+ * before a pass that may be repeated (see restore_chunk_instrs())
+ */
+void save_chunk_instrs(assemblyline_t al, struct chunk_instrs *saved);
+
+/**
+ * writes the instructions @param saved by save_chunk_instrs() back into the
+ * buffer field of @param al, undoing any lengthening of them since
+ */
+void restore_chunk_instrs(assemblyline_t al,
+                          const struct chunk_instrs *saved);
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines the perfect hashes mapping an (instruction name, operand format) pair
+ to its INSTR_TABLE[] key and a register name to its asm_reg. The tables
+ themselves (and the first key of every asm_instr) are generated at build time
+ by tools/gen_lookup_tables from INSTR_TABLE[] and REG_TABLE[] into
+ lookup_tables.h*/
+#ifndef LOOKUP_HASH_H
+#define LOOKUP_HASH_H
+
+#include "enums.h"
+#include <stdint.h>
+
+// max number of name characters packed into the hash key
+#define LOOKUP_HASH_NAME_LEN 16
+// number of characters packed into a single 64 bit word
+#define LOOKUP_HASH_WORD_LEN 8
+
+// packs up to 5 characters the same way as lookup_hash_pack()
+#define PACK2(a, b) ((uint64_t)(a) | (uint64_t)(b) << 8)
+#define PACK3(a, b, c) (PACK2(a, b) | (uint64_t)(c) << 16)
+#define PACK4(a, b, c, d) (PACK3(a, b, c) | (uint64_t)(d) << 24)
+#define PACK5(a, b, c, d, e) (PACK4(a, b, c, d) | (uint64_t)(e) << 32)
+
+// a single slot of the generated instruction hash table
+struct instr_hash_entry {
+  // instruction name packed little endian into two 64 bit words
+  uint64_t name_lo;
+  uint64_t name_hi;
+  // operand_format enum of the entry
+  int opd_format;
+  // index into INSTR_TABLE[] or INSTR_ERROR for an empty slot
+  int key;
+};
+
+// a single slot of the generated register hash table
+struct reg_hash_entry {
+  // register name packed little endian into a 64 bit word
+  uint64_t name;
+  // mode and generic register or reg_error for an empty slot
+  asm_reg reg;
+};
+
+/**
+ * packs the null-terminated name @param name into @param lo and
+ * @param hi (zero padded) so names can be compared without strcmp
+ */
+static inline void lookup_hash_pack(const char *name, uint64_t *lo,
+                                    uint64_t *hi) {
+
+  uint64_t word[2] = {0, 0};
+  for (unsigned int i = 0; i < LOOKUP_HASH_NAME_LEN && name[i] != '\0'; i++)
+    word[i / LOOKUP_HASH_WORD_LEN] |=
+        (uint64_t)(uint8_t)name[i] << ((i % LOOKUP_HASH_WORD_LEN) * 8);
+  *lo = word[0];
+  *hi = word[1];
+}
+
+/**
+ * combines the packed name @param lo, @param hi and operand format
+ * @param opd_format into a single 64 bit value
+ */
+static inline uint64_t lookup_hash_combine(uint64_t lo, uint64_t hi,
+                                           int opd_format) {
+  return lo ^ (hi * 0x9e3779b97f4a7c15ULL) ^
+         ((uint64_t)(opd_format + 1) * 0xc2b2ae3d27d4eb4fULL);
+}
+
+/**
+ * 64 bit finalizer (murmur3 fmix64) of @param h perturbed by @param seed
+ */
+static inline uint64_t lookup_hash_mix(uint64_t h, uint64_t seed) {
+  h ^= seed * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements measuring the machine code of an input: the parsed input is laid
+ * out by a scratch instance with the same options that only computes the
+ * lengths and positions of the code (see code_at()). Chunk fitting,
+ * lengthening, branch padding, alignment and branch relaxation decide from
+ * those alone, so no code is kept and no buffer grows*/
+#include "measure.h"
+#include "assembler.h"
+#include "parser.h"
+#include <stdlib.h>
+
+// bytes of the buffer each instruction is written to
+#define MAX_ENCODING_LEN 32
+
+/**
+ * stores in @param bytes the number of bytes of machine code of @param program
+ * laid out at the offset of instance @param al with its options by a scratch
+ * instance, which appends the length of every instruction to @param log
+ * unless it is NULL
+ */
+static int lay_out(assemblyline_t al, const struct asm_program *program,
+                   size_t *bytes, struct length_log *log) {
+
+  uint8_t code[MAX_ENCODING_LEN];
+  assemblyline_t scratch = asm_create_instance(code, sizeof(code));
+  FAIL_IF_MSG(scratch == NULL, "failed to create scratch instance\n");
+  scratch->lengths_only = true;
+  scratch->offset = al->offset;
+  scratch->assembly_opt = al->assembly_opt;
+  scratch->assembly_mode = al->assembly_mode;
+  scratch->chunk_size = al->chunk_size;
+  scratch->fuse_start = al->fuse_start;
+  scratch->fuse_end = al->fuse_end;
+  scratch->lengthen = al->lengthen;
+  scratch->reorder = al->reorder;
+  scratch->length_log = log;
+  // chunk breaks are counted but not reported
+  int chunk_brks = 0;
+  int offset = assemble_program(scratch, program, &chunk_brks);
+  asm_destroy_instance(scratch);
+  FAIL_IF(offset == ASM_ERROR);
+  *bytes = (size_t)(offset - al->offset);
+  return EXIT_SUCCESS;
+}
+
+int measure(assemblyline_t al, const char *str, size_t len, size_t *bytes,
+            struct length_log *log) {
+
+  FAIL_IF_MSG(bytes == NULL, "bytes ptr cannot be NULL\n");
+  // the input is parsed once with the peephole rules and the scheduling of al
+  struct asm_program program = {0};
+  int ret = parse_all(al, str, len, &program);
+  if (ret == EXIT_SUCCESS)
+    ret = lay_out(al, &program, bytes, log);
+  free_program(&program);
+  return ret;
+}
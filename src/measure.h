@@ -0,0 +1,37 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines a function measuring the machine code of an input without assembling
+ * it into the buffer of the instance*/
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * stores in @param bytes the number of bytes of machine code (including chunk,
+ * branch and alignment padding) that @param len characters of @param str
+ * would take if assembled like assemble_all() at the offset of instance
+ * @param al with its options, and appends the length of every instruction in
+ * the order written to @param log unless it is NULL. Neither the buffer nor
+ * the offset of @param al change.
+ */
+int measure(assemblyline_t al, const char *str, size_t len, size_t *bytes,
+            struct length_log *log);
+
+#endif
@@ -0,0 +1,220 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements parallel assembly: without labels every line encodes on its own,
+ * so slices of the input are assembled concurrently and concatenated*/
+#include "parallel.h"
+#include "assembler.h"
+#include "parser.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// initial number of instruction lengths allocated for a slice
+#define NUM_OF_LENGTHS 4096
+
+// a slice of the input and the scratch instance it is assembled into
+struct worker {
+  pthread_t thread;
+  bool started;
+  const char *str;
+  size_t len;
+  assemblyline_t scratch;
+  struct length_log log;
+  int code_len;
+};
+
+int log_length(struct length_log *log, unsigned int len) {
+
+  if (log->len == log->capacity) {
+    size_t capacity = log->capacity ? 2 * log->capacity : NUM_OF_LENGTHS;
+    uint8_t *lens = realloc(log->lens, capacity);
+    FAIL_IF_MSG(lens == NULL, "failed to allocate memory\n");
+    log->lens = lens;
+    log->capacity = capacity;
+  }
+  log->lens[log->len++] = len;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * assembles the slice of the worker @param arg into its scratch instance
+ */
+static void *assemble_slice(void *arg) {
+
+  struct worker *w = arg;
+  w->code_len = ASM_ERROR;
+  // machine code is rarely longer than its source, so reserve that up front
+  if (w->len < INT_MAX - BUFFER_TOLERANCE &&
+      check_len_or_resize(w->scratch, (int)w->len))
+    return NULL;
+  w->code_len = assemble_stream(w->scratch, w->str, w->len, NULL);
+  return NULL;
+}
+
+/**
+ * splits @param len characters of @param str into at most @param num_workers
+ * slices of similar length that begin at a line and assigns them to
+ * @param workers. Returns the number of slices.
+ */
+static size_t split(const char *str, size_t len, struct worker *workers,
+                    size_t num_workers) {
+
+  size_t start = 0;
+  size_t num_slices = 0;
+  while (start < len && num_slices < num_workers) {
+    size_t end = len;
+    // every character after a line feed begins a line
+    if (num_slices + 1 < num_workers && len / num_workers * (num_slices + 1) >
+                                            start) {
+      end = len / num_workers * (num_slices + 1);
+      const char *line_feed = memchr(str + end, '\n', len - end);
+      end = line_feed != NULL ? (size_t)(line_feed - str) + 1 : len;
+    }
+    workers[num_slices].str = str + start;
+    workers[num_slices].len = end - start;
+    num_slices++;
+    start = end;
+  }
+  return num_slices;
+}
+
+/**
+ * copies the slices of @param workers in order into the buffer field of
+ * @param al at @param buf_pos
+ */
+static int concat(assemblyline_t al, const struct worker *workers,
+                  size_t num_slices, unsigned int *buf_pos) {
+
+  unsigned int total = 0;
+  unsigned int last_len = 0;
+  for (size_t i = 0; i < num_slices; i++) {
+    total += workers[i].code_len;
+    if (workers[i].log.len > 0)
+      last_len = workers[i].log.lens[workers[i].log.len - 1];
+  }
+  // the buffer is checked at the start of the last instruction (see assemble())
+  if (total > 0)
+    FAIL_IF(check_len_or_resize(al, *buf_pos + total - last_len));
+  for (size_t i = 0; i < num_slices; i++) {
+    memcpy(al->buffer + *buf_pos, workers[i].scratch->buffer,
+           workers[i].code_len);
+    *buf_pos += workers[i].code_len;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * copies the slices of @param workers instruction by instruction into the
+ * buffer field of @param al at @param buf_pos, applying the chunk fitting or
+ * counting of al->assembly_mode and storing the number of chunk breaks in
+ * @param dest
+ */
+static int concat_chunks(assemblyline_t al, const struct worker *workers,
+                         size_t num_slices, unsigned int *buf_pos, int *dest) {
+
+  FAIL_IF_MSG(al->assembly_mode == CHUNK_COUNT && dest == NULL,
+              "chunk_brks ptr cannot be NULL\n");
+  for (size_t i = 0; i < num_slices; i++) {
+    const uint8_t *code = workers[i].scratch->buffer;
+    for (size_t j = 0; j < workers[i].log.len; j++) {
+      unsigned int len = workers[i].log.lens[j];
+      FAIL_IF(check_len_or_resize(al, *buf_pos));
+      size_t free_chunk_space = al->chunk_size - (*buf_pos % al->chunk_size);
+      // the same decisions as assemble_with_chunk_fitting() and
+      // assemble_counting_chunks()
+      if (al->assembly_mode == CHUNK_COUNT) {
+        if (len > free_chunk_space)
+          (*dest)++;
+      } else if (len > free_chunk_space && len < al->chunk_size) {
+        *buf_pos += nop_padding(al->buffer + *buf_pos, free_chunk_space);
+        FAIL_IF(check_len_or_resize(al, *buf_pos));
+      }
+      memcpy(al->buffer + *buf_pos, code, len);
+      *buf_pos += len;
+      code += len;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int assemble_parallel(assemblyline_t al, const char *str, size_t len,
+                      int *dest) {
+
+  // assembly stops at the first null character
+  const char *null_char = memchr(str, '\0', len);
+  if (null_char != NULL)
+    len = null_char - str + 1;
+  size_t num_workers = len / PARALLEL_MIN_SLICE_LEN;
+  if (num_workers > al->threads)
+    num_workers = al->threads;
+  if (num_workers == 0)
+    num_workers = 1;
+  struct worker *workers = calloc(num_workers, sizeof(struct worker));
+  FAIL_IF_ERR(workers == NULL);
+  size_t num_slices = split(str, len, workers, num_workers);
+  int ret = EXIT_SUCCESS;
+  for (size_t i = 0; i < num_slices && ret == EXIT_SUCCESS; i++) {
+    struct worker *w = &workers[i];
+    w->code_len = ASM_ERROR;
+    w->scratch = asm_create_instance(NULL, 0);
+    if (w->scratch == NULL) {
+      ret = EXIT_FAILURE;
+      break;
+    }
+    w->scratch->assembly_opt = al->assembly_opt;
+    w->scratch->length_log = &w->log;
+    // the calling thread assembles the first slice
+    if (i > 0)
+      w->started = !pthread_create(&w->thread, NULL, assemble_slice, w);
+  }
+  if (ret == EXIT_SUCCESS)
+    assemble_slice(&workers[0]);
+  for (size_t i = 1; i < num_slices; i++) {
+    if (workers[i].started)
+      pthread_join(workers[i].thread, NULL);
+    else if (ret == EXIT_SUCCESS && workers[i].scratch != NULL)
+      // fall back to the calling thread if a thread could not be created
+      assemble_slice(&workers[i]);
+  }
+  // slices with branches to labels or align directives are assembled serially
+  // from the parsed input
+  bool reparse = false;
+  for (size_t i = 0; i < num_slices && ret == EXIT_SUCCESS; i++) {
+    if (workers[i].code_len != ASM_ERROR)
+      continue;
+    if (workers[i].scratch->reparse)
+      reparse = true;
+    else
+      ret = EXIT_FAILURE;
+  }
+  unsigned int buf_pos = al->offset;
+  if (ret == EXIT_SUCCESS && !reparse)
+    ret = al->assembly_mode == ASSEMBLE
+              ? concat(al, workers, num_slices, &buf_pos)
+              : concat_chunks(al, workers, num_slices, &buf_pos, dest);
+  for (size_t i = 0; i < num_slices; i++) {
+    if (workers[i].scratch != NULL)
+      asm_destroy_instance(workers[i].scratch);
+    free(workers[i].log.lens);
+  }
+  free(workers);
+  FAIL_IF_ERR(ret);
+  if (reparse)
+    return assemble_parsed(al, str, len, dest);
+  return (int)buf_pos;
+}
@@ -0,0 +1,46 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for assembling large inputs with several threads*/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+// inputs are only split into slices of at least this many characters
+#define PARALLEL_MIN_SLICE_LEN 0x10000
+
+/**
+ * appends the instruction length @param len to @param log
+ */
+int log_length(struct length_log *log, unsigned int len);
+
+/**
+ * assembles @param len characters of @param str like assemble_all() with up to
+ * al->threads threads: the input is split at line breaks into slices that are
+ * assembled into scratch instances concurrently and then copied into the
+ * buffer field of @param al at their prefix summed offsets (applying chunk
+ * fitting and counting in a sequential pass). The machine code is identical to
+ * assembling @param str with a single thread. Inputs with branches to labels
+ * or align directives are assembled by assemble_parsed() instead. Returns the
+ * new offset or ASM_ERROR.
+ */
+int assemble_parallel(assemblyline_t al, const char *str, size_t len,
+                      int *dest);
+
+#endif
@@ -19,19 +19,29 @@ and converting that filtered string into its respective struct instr
 representation*/
 #define _GNU_SOURCE 1 // NOLINT
 #define MAX_OPD 5
-#define MAX_LINE_LEN 100
 #define OBJDUMP_MAX_LINE_LEN 7
+// trailing statements shorter than this are copied on the stack
+#define TAIL_COPY_LEN 128
+// initial number of instructions allocated for a parsed program
+#define NUM_OF_INSTR 64
 #include "parser.h"
 #include "assembler.h"
+#include "buffer.h"
 #include "encoder.h"
 #include "instr_parser.h"
 #include "instructions.h"
+#include "labels.h"
+#include "lengthen.h"
+#include "parallel.h"
+#include "peephole.h"
 #include "reg_parser.h"
+#include "reorder.h"
+#include "scheduler.h"
+#include "template.h"
 #include "tokenizer.h"
-#include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 
 /**
  * checks the validity of each register within @param check_instr
@@ -46,53 +56,58 @@ static int check_registers(struct instr *check_instr) {
 }
 
 /**
- * convert each operand string register in @param instr_data to enum
+ * encodes the tokenized @param instr_data of the statement @param line of
+ * @param line_len characters (used for error messages)
  */
-static void all_opd_str_to_reg(struct instr *instr_data) {
-
-  for (int i = 0; i < FOURTH_OPERAND; i++)
-    instr_data->opd[i].reg = str_to_reg(instr_data->opd[i].str);
-  for (int i = 0; i < FOURTH_OPERAND; i++)
-    instr_data->opd[i].index = str_to_reg(instr_data->opd[i].sib);
-}
-
-/**
- * tokenize and parse @param filtered_asm_str to fill in @param instr_data
- */
-static int line_to_instr(struct instr *instr_data, char *filtered_asm_str) {
-  // back up instruction for error checking
-  char asm_str[MAX_LINE_LEN];
-  strncpy(asm_str, filtered_asm_str, MAX_LINE_LEN);
-  // default mod displacement value r/m is register
-  instr_data->mod_disp = MOD24;
-  // clear the least significant bit
-  if (instr_data->assembly_opt & SMART_MOV_IMM)
-    instr_data->assembly_opt &= ~NASM_MOV_IMM;
-  // tokenize filtered instruction for mapping to instr internal structure
-  FAIL_IF_MSG(instr_tok(instr_data, filtered_asm_str), "syntax error\n");
+static int line_to_instr(struct instr *instr_data, const char *line,
+                         int line_len) {
   // convert operand format from string to enum representation
   char opd_type[MAX_OPD] = {'\0'};
   for (int i = 0; i < NUM_OF_OPD; i++)
     opd_type[i] = instr_data->opd[i].type;
   operand_format opd_format = get_opd_format(opd_type);
   FAIL_IF_VAR(opd_format == opd_error, "illegal operand format: %s\n", opd_type)
-  // convert register string to enum representation
-  all_opd_str_to_reg(instr_data);
+  // convert instruction string to enum representation
+  instr_data->key = str_to_instr_key(instr_data->instruction, opd_format);
+  if (instr_data->key == INSTR_ERROR) {
+    // trim the statement for printing
+    while (line_len > 0 && (*line == ' ' || *line == '\t')) {
+      line++;
+      line_len--;
+    }
+    while (line_len > 0 && (line[line_len - 1] == ' ' ||
+                            line[line_len - 1] == '\t'))
+      line_len--;
+    fprintf(stderr, "assembyline: unsupported or illegal instruction: %.*s\n",
+            line_len, line);
+    return EXIT_FAILURE;
+  }
+  // branches to labels are encoded once their displacement is known
+  if (instr_data->label_name != NULL) {
+    FAIL_IF_VAR(!TYPE(instr_data->key, CONTROL_FLOW),
+                "labels are only supported as branch targets: %s\n",
+                instr_data->instruction);
+    return EXIT_SUCCESS;
+  }
+  return encode_instr(instr_data);
+}
+
+int encode_instr(struct instr *instr_data) {
+
   int m_index = instr_data->mem_index;
   // [MEM] no register
   if (instr_data->opd[m_index].type == 'm' &&
-      instr_data->opd[m_index].str[0] == '\0' &&
-      instr_data->opd[m_index].sib[0] == '\0') {
+      instr_data->opd[m_index].reg == reg_none &&
+      instr_data->opd[m_index].index == reg_none) {
     instr_data->mod_disp &= MOD16;
     instr_data->opd[m_index].reg = spl;
   }
-  // convert instruction string to enum representation
-  instr_data->key = str_to_instr_key(instr_data->instruction, opd_format);
-  FAIL_IF_VAR(instr_data->key == INSTR_ERROR,
-              "unsupported or illegal instruction: %s\n", asm_str);
+  if (instr_data->imm_name != NULL)
+    FAIL_IF(set_imm_placeholder(instr_data));
   if (instr_data->imm && TYPE(instr_data->key, CONTROL_FLOW)) {
-    if (IN_RANGE(instr_data->cons, NEG80_32BIT, MAX_UNSIGNED_32BIT) ||
-        (instr_data->cons <= MAX_SIGNED_8BIT && !instr_data->keyword.is_long))
+    if (!instr_data->keyword.is_long &&
+        (IN_RANGE(instr_data->cons, NEG80_32BIT, MAX_UNSIGNED_32BIT) ||
+         instr_data->cons <= MAX_SIGNED_8BIT))
       instr_data->keyword.is_short = true;
     else if (instr_data->cons > MAX_SIGNED_8BIT &&
              instr_data->keyword.is_short) {
@@ -100,8 +115,10 @@ static int line_to_instr(struct instr *instr_data, char *filtered_asm_str) {
       return EXIT_FAILURE;
     }
   }
-  // find the encoding for a short jump instruction if applicable
-  instr_data->key += instr_data->keyword.is_short;
+  // find the encoding for a short jump instruction if applicable (call has
+  // none)
+  if (instr_data->keyword.is_short && has_short_encoding(instr_data->key))
+    instr_data->key++;
   // values will be determined during encoding
   instr_data->hex.reg = NONE;
   instr_data->hex.rex = NONE;
@@ -128,72 +145,45 @@ static int line_to_instr(struct instr *instr_data, char *filtered_asm_str) {
   // (used push imm16 or imm32 when immediate is greater than 0x7f)
   if (NAME(instr_data->key, push) && instr_data->cons > MAX_SIGNED_8BIT)
     instr_data->key++;
+  reduce_imm(instr_data);
   return EXIT_SUCCESS;
 }
 
 /**
- * reads @param unfiltered_str and writes the filtered string into @param
- * filter_str
+ * reads the line at @param str (bounded by @param end) and fills in the
+ * @param instr_data fields. The number of characters consumed including the
+ * comment and line break is stored in @param read_len
  */
-static int filter_assembly_str_fsa(const char unfiltered_str[],
-                                   char filter_str[]) {
-
-  filter_op filter_state = BEGIN;
-  int j = 0;
-  int i = 0;
-  while (unfiltered_str[i] != ';' && unfiltered_str[i] != '%' &&
-         unfiltered_str[i] != '\r' && unfiltered_str[i] != '\n' &&
-         unfiltered_str[i] != '\0' && j < MAX_LINE_LEN) {
-    switch (filter_state) {
-    case BEGIN:
-      if (unfiltered_str[i] >= 'A' && unfiltered_str[i] <= 'z') {
-        filter_str[j++] = (char)tolower(unfiltered_str[i]);
-        filter_state = FIRST_CH;
-      }
-      break;
-    case FIRST_CH:
-      if (unfiltered_str[i] > '!')
-        filter_str[j++] = (char)tolower(unfiltered_str[i]);
-      else if (unfiltered_str[i] == ' ') {
-        filter_str[j++] = (char)tolower(unfiltered_str[i]);
-        filter_state = SPACE_FOUND;
-      }
-      break;
-    case SPACE_FOUND:
-      if (unfiltered_str[i] > '!')
-        filter_str[j++] = (char)tolower(unfiltered_str[i]);
-      break;
-    }
-    // last printable ascii character
-    FAIL_IF_MSG(unfiltered_str[i] > '~', "Printable ascii characters only\n");
-    i++;
-  }
-  return i;
-}
-
-/**
- * reads @param unfiltered_str and fills in the @param instr_data fields
- */
-static int str_to_instr(struct instr *instr_data, const char unfiltered_str[],
-                        int *read_len) {
+static int str_to_instr(struct instr *instr_data, const char *str,
+                        const char *end, int *read_len) {
 
-  char filter_str[FILTERED_STR_LEN] = {'\0'};
-  // sanitize user input and copy filtered string to filter_str
-  int ch_pos = filter_assembly_str_fsa(unfiltered_str, filter_str);
+  // default mod displacement value r/m is register
+  instr_data->mod_disp = MOD24;
+  // clear the least significant bit
+  if (instr_data->assembly_opt & SMART_MOV_IMM)
+    instr_data->assembly_opt &= ~NASM_MOV_IMM;
+  // tokenize the line straight into instr_data
+  int ch_pos = 0;
+  FAIL_IF_MSG(instr_tok(instr_data, str, &ch_pos), "syntax error\n");
+  int stmt_len = ch_pos;
+  // an instruction after a label is read as the next statement
+  if (instr_data->key == LABEL && !is_stmt_end(str[ch_pos])) {
+    *read_len = ch_pos;
+    return EXIT_SUCCESS;
+  }
   // skip comments/macro
-  while (unfiltered_str[ch_pos] != '\n' && unfiltered_str[ch_pos] != '\r' &&
-         unfiltered_str[ch_pos] != '\0')
+  while (str + ch_pos < end && str[ch_pos] != '\n' && str[ch_pos] != '\r' &&
+         str[ch_pos] != '\0')
     ch_pos++;
-  if (unfiltered_str[ch_pos] == '\n' || unfiltered_str[ch_pos] == '\r')
+  if (str + ch_pos < end && (str[ch_pos] == '\n' || str[ch_pos] == '\r'))
     ch_pos++;
   *read_len = ch_pos;
-  // map filter_str to instr_data if not it is not a label or header
-  if (filter_str[0] != '\0' && strstr(filter_str, "section") == NULL &&
-      strstr(filter_str, "global") == NULL && strchr(filter_str, ':') == NULL)
-    return line_to_instr(instr_data, filter_str);
-  // set to skip and return EXIT_SUCCESS
-  instr_data->key = SKIP;
-  return EXIT_SUCCESS;
+  // headers and blank lines are set to SKIP, labels to LABEL and align
+  // directives to ALIGN
+  if (instr_data->key == SKIP || instr_data->key == LABEL ||
+      instr_data->key == ALIGN)
+    return EXIT_SUCCESS;
+  return line_to_instr(instr_data, str, stmt_len);
 }
 
 /**
@@ -223,49 +213,62 @@ static void debug_with_chunksize(uint8_t *buf, unsigned int opcode_pos,
   printf("\n");
 }
 
-/**
- * checks if the buffer length has been exceeded
- */
-static int check_len_or_resize(assemblyline_t al, int buf_pos) {
+int check_len_or_resize(assemblyline_t al, int buf_pos) {
 
+  // nothing but the first instruction is ever written (see code_at())
+  if (al->lengths_only)
+    return EXIT_SUCCESS;
   if (buf_pos + BUFFER_TOLERANCE > al->buffer_len) {
     FAIL_IF_VAR(al->external, "exceeded memory buffer: al->buffer_len = %d\n",
                 al->buffer_len)
-#ifdef __linux__
-    // resize internal memory buffer
-    void *resize = mremap(al->buffer, al->buffer_len,
-                          al->buffer_len + MEM_BUFFER, MREMAP_MAYMOVE);
-    // NOLINTNEXTLINE(performance-no-int-to-ptr)
-    FAIL_SYS(resize == MAP_FAILED, "failed to resize buffer\n", EXIT_FAILURE)
-    al->buffer_len += MEM_BUFFER;
-    al->buffer = (uint8_t *)resize;
-#else
-    fprintf(stderr, "internal buffer too small. Not running on Linux, "
-                    "Thus there is no mremap. Use your own buffer, or "
-                    "implement another strategy. ");
-    return EXIT_FAILURE;
-#endif
+    return grow_buffer(al, (size_t)buf_pos + BUFFER_TOLERANCE);
   }
   return EXIT_SUCCESS;
 }
 
+uint8_t *code_at(assemblyline_t al, unsigned int buf_pos) {
+  return al->lengths_only ? al->buffer : al->buffer + buf_pos;
+}
+
+/**
+ * writes @param len bytes of nops at @param buf_pos of instance @param al
+ * unless it only computes lengths and positions, and returns @param len
+ */
+static unsigned int pad_nops(assemblyline_t al, unsigned int buf_pos,
+                             unsigned int len) {
+  return al->lengths_only ? len : nop_padding(al->buffer + buf_pos, len);
+}
+
+/**
+ * appends the length @param len of an instruction written by instance
+ * @param al to its length log, if it has one
+ */
+static int log_written(assemblyline_t al, unsigned int len) {
+
+  if (al->length_log == NULL)
+    return EXIT_SUCCESS;
+  return log_length(al->length_log, len);
+}
+
 /**
  * given and instance of @param al write the machine code of @param new_instr
  * into @param buf_pos while counting the number of instructions that break a
  * chunk boundary, storing the number of breaks into @param chunk_brks
  */
-static int assemble_counting_chunks(assemblyline_t al, struct instr *new_instr,
+static int assemble_counting_chunks(assemblyline_t al,
+                                    const struct instr *new_instr,
                                     unsigned int *buf_pos, int *chunk_brks) {
 
   FAIL_IF_MSG(chunk_brks == NULL, "chunk_brks ptr cannot be NULL\n");
   FAIL_IF(check_len_or_resize(al, *buf_pos));
   unsigned int free_space = al->chunk_size - (*buf_pos % al->chunk_size);
-  unsigned int written_length = assemble_asm(new_instr, al->buffer + *buf_pos);
+  unsigned int written_length = assemble_asm(new_instr, code_at(al, *buf_pos));
   // check if the current instruction machine code crosses the chunk boundary
   if (written_length > free_space)
     (*chunk_brks)++;
   if (al->debug)
     debug_without_chunksize(written_length, al->buffer + *buf_pos);
+  FAIL_IF(log_written(al, written_length));
   *buf_pos += written_length;
   return EXIT_SUCCESS;
 }
@@ -274,24 +277,28 @@ static int assemble_counting_chunks(assemblyline_t al, struct instr *new_instr,
  * given and instance of @param al write the machine code of @param new_instr
  * into @param buf_pos
  */
-static int assemble(assemblyline_t al, struct instr *new_instr,
+static int assemble(assemblyline_t al, const struct instr *new_instr,
                     unsigned int *buf_pos) {
 
   FAIL_IF(check_len_or_resize(al, *buf_pos));
-  unsigned int written_length = assemble_asm(new_instr, al->buffer + *buf_pos);
+  unsigned int written_length = assemble_asm(new_instr, code_at(al, *buf_pos));
   if (al->debug)
     debug_without_chunksize(written_length, al->buffer + *buf_pos);
+  FAIL_IF(log_written(al, written_length));
   *buf_pos += written_length;
   return EXIT_SUCCESS;
 }
 
-/**
- * given and instance of @param al write the machine code of @param new_instr
- * into @param buf_pos while enforcing chunk boundaries with nop padding
- */
-static int assemble_with_chunk_fitting(assemblyline_t al,
-                                       struct instr *new_instr,
-                                       unsigned int *buf_pos) {
+bool fits_chunk(assemblyline_t al, unsigned int len, unsigned int buf_pos) {
+
+  // instructions longer than a chunk cross a boundary wherever they start
+  size_t free_chunk_space = al->chunk_size - (buf_pos % al->chunk_size);
+  return len <= free_chunk_space || len >= al->chunk_size;
+}
+
+int assemble_with_chunk_fitting(assemblyline_t al,
+                                const struct instr *new_instr,
+                                unsigned int *buf_pos) {
 
   bool assemble_again = false;
   do {
@@ -300,14 +307,18 @@ static int assemble_with_chunk_fitting(assemblyline_t al,
     FAIL_IF(check_len_or_resize(al, *buf_pos));
     // check the number of bytes available in chunk
     size_t free_chunk_space = al->chunk_size - (*buf_pos % al->chunk_size);
-    size_t written_length = assemble_asm(new_instr, al->buffer + *buf_pos);
+    size_t written_length = assemble_asm(new_instr, code_at(al, *buf_pos));
     // write machine code to memory if there is sufficient chunk space
-    if (written_length <= free_chunk_space ||
-        written_length >= al->chunk_size ||
-        written_length == free_chunk_space + al->chunk_size) {
+    if (fits_chunk(al, written_length, *buf_pos)) {
+      track_chunk_instr(al, new_instr, *buf_pos, *buf_pos + written_length);
+      FAIL_IF(log_written(al, written_length));
       *buf_pos += written_length;
     } else {
-      *buf_pos += nop_padding(al->buffer + *buf_pos, free_chunk_space);
+      FAIL_IF(check_len_or_resize(al, *buf_pos + free_chunk_space));
+      unsigned int padding = lengthen_chunk(al, free_chunk_space, *buf_pos);
+      if (padding == 0)
+        padding = pad_nops(al, *buf_pos, free_chunk_space);
+      *buf_pos += padding;
       assemble_again = true;
     }
   } while (assemble_again);
@@ -315,39 +326,437 @@ static int assemble_with_chunk_fitting(assemblyline_t al,
 }
 
 /**
- * given and instance of @param al assembles @param str writing the machine
- * code into @param dest. Assembly behaviour will differ depending on
- * assembly_mode
+ * checks if @param instr_data is a jump, call or return (which the JCC erratum
+ * applies to)
  */
-int assemble_all(assemblyline_t al, const char *str, int *dest) {
+static bool is_jump(const struct instr *instr_data) {
+  return TYPE(instr_data->key, CONTROL_FLOW) && !NAME(instr_data->key, xend);
+}
 
-  if (dest != NULL)
-    *dest = 0;
+/**
+ * checks if @param instr_data may macro-fuse with a following conditional jump
+ */
+static bool starts_fused_pair(const struct instr *instr_data) {
+
+  // an immediate and a memory operand together never fuse
+  if (instr_data->imm &&
+      (instr_data->opd[0].type == 'm' || instr_data->opd[1].type == 'm'))
+    return false;
+  int key = instr_data->key;
+  return NAME(key, cmp) || NAME(key, test) || NAME(key, add) ||
+         NAME(key, sub) || NAME(key, and) || NAME(key, inc) || NAME(key, dec);
+}
+
+/**
+ * checks if @param instr_data is a conditional jump that may macro-fuse with
+ * the preceding instruction. Not every condition fuses with every instruction,
+ * but keeping a pair that does not fuse together is harmless.
+ */
+static bool ends_fused_pair(const struct instr *instr_data) {
+
+  int key = instr_data->key;
+  return is_jump(instr_data) && !NAME(key, jmp) && !NAME(key, call) &&
+         !NAME(key, ret) && !NAME(key, jrcxz);
+}
+
+bool is_fused_pair(const struct instr *first, const struct instr *jump) {
+  return starts_fused_pair(first) && ends_fused_pair(jump);
+}
+
+/**
+ * given and instance of @param al write the machine code of @param new_instr
+ * into @param buf_pos while padding every jump (together with the
+ * instruction it macro-fuses with) that would cross or end on a
+ * BRANCH_BOUNDARY to start at the boundary
+ */
+static int assemble_with_branch_padding(assemblyline_t al,
+                                        const struct instr *new_instr,
+                                        unsigned int *buf_pos) {
+
+  FAIL_IF(check_len_or_resize(al, *buf_pos));
+  unsigned int start = *buf_pos;
+  unsigned int end = start + assemble_asm(new_instr, code_at(al, start));
+  FAIL_IF(log_written(al, end - start));
+  // the instruction right before a conditional jump is moved along with it
+  if (al->fuse_start != NA && (unsigned int)al->fuse_end == start &&
+      ends_fused_pair(new_instr))
+    start = al->fuse_start;
+  al->fuse_start = starts_fused_pair(new_instr) ? (int)*buf_pos : NA;
+  al->fuse_end = (int)end;
+  *buf_pos = end;
+  if (!is_jump(new_instr) || start / BRANCH_BOUNDARY == end / BRANCH_BOUNDARY)
+    return EXIT_SUCCESS;
+  unsigned int pad = BRANCH_BOUNDARY - start % BRANCH_BOUNDARY;
+  *buf_pos += pad;
+  if (al->lengths_only)
+    return EXIT_SUCCESS;
+  FAIL_IF(check_len_or_resize(al, end + pad));
+  memmove(al->buffer + start + pad, al->buffer + start, end - start);
+  nop_padding(al->buffer + start, pad);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * given and instance of @param al pads @param buf_pos up to the alignment of
+ * the align directive @param align_instr unless that skips more than its
+ * maximum. With chunk fitting, only nops that fit the chunks are used.
+ */
+static int emit_align(assemblyline_t al, const struct instr *align_instr,
+                      unsigned int *buf_pos) {
+
+  unsigned int pad = (align_instr->align - *buf_pos % align_instr->align) %
+                     align_instr->align;
+  if (pad == 0 || pad > align_instr->align_max)
+    return EXIT_SUCCESS;
+  FAIL_IF(check_len_or_resize(al, *buf_pos + pad));
+  uint8_t *padding = al->buffer + *buf_pos;
+  if (al->assembly_mode != CHUNK_FITTING) {
+    if (!al->lengths_only)
+      align_padding(padding, pad);
+    if (al->debug && al->assembly_mode != BRANCH_PADDING)
+      debug_without_chunksize(pad, padding);
+    *buf_pos += pad;
+    return EXIT_SUCCESS;
+  }
+  while (pad > 0) {
+    unsigned int free_chunk_space = al->chunk_size - *buf_pos % al->chunk_size;
+    unsigned int len = pad < free_chunk_space ? pad : free_chunk_space;
+    *buf_pos += pad_nops(al, *buf_pos, len);
+    pad -= len;
+  }
+  return EXIT_SUCCESS;
+}
+
+int emit_instr(assemblyline_t al, const struct instr *new_instr,
+               unsigned int *buf_pos, int *dest) {
+
+  // the instructions queued before one that may not be moved are written
+  // first, so it stays where it is relative to them
+  if (al->reorder && al->assembly_mode == CHUNK_FITTING) {
+    if (is_reorderable(new_instr))
+      return schedule_instr(al, new_instr, buf_pos);
+    FAIL_IF(flush_scheduled(al, buf_pos));
+  }
+  // labels (which the jump they precede may target) and align directives end
+  // a fused pair, and the code before them is not lengthened
+  if (new_instr->key == LABEL || new_instr->key == ALIGN) {
+    al->fuse_start = NA;
+    forget_chunk_instrs(al);
+    return new_instr->key == ALIGN ? emit_align(al, new_instr, buf_pos)
+                                   : EXIT_SUCCESS;
+  }
+  switch (al->assembly_mode) {
+  case ASSEMBLE:
+    FAIL_IF(assemble(al, new_instr, buf_pos));
+    break;
+  case CHUNK_COUNT:
+    FAIL_IF(assemble_counting_chunks(al, new_instr, buf_pos, dest));
+    break;
+  case CHUNK_FITTING:
+    FAIL_IF(assemble_with_chunk_fitting(al, new_instr, buf_pos));
+    break;
+  case BRANCH_PADDING:
+    FAIL_IF(assemble_with_branch_padding(al, new_instr, buf_pos));
+    break;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * appends @param new_instr to the instructions of @param program
+ */
+static int append_instr(struct asm_program *program,
+                        const struct instr *new_instr) {
+
+  if (program->len == program->capacity) {
+    size_t capacity = program->capacity ? 2 * program->capacity : NUM_OF_INSTR;
+    struct instr *instrs =
+        realloc(program->instrs, capacity * sizeof(struct instr));
+    FAIL_IF_MSG(instrs == NULL, "failed to allocate memory\n");
+    program->instrs = instrs;
+    program->capacity = capacity;
+  }
+  program->instrs[program->len++] = *new_instr;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * given and instance of @param al parses the line at @param str (bounded by
+ * @param end) and either appends it to @param program or, if @param program
+ * is NULL, writes its machine code into @param buf_pos. The number of
+ * characters consumed is stored in @param read_len
+ */
+static int assemble_line(assemblyline_t al, const char *str, const char *end,
+                         unsigned int *buf_pos, int *dest,
+                         struct asm_program *program, int *read_len) {
+
+  struct instr new_instr = {0};
+  new_instr.assembly_opt = al->assembly_opt;
+  FAIL_IF(str_to_instr(&new_instr, str, end, read_len));
+  if (new_instr.key == SKIP)
+    return EXIT_SUCCESS;
+  FAIL_IF_MSG((new_instr.imm_name != NULL || new_instr.disp_name != NULL) &&
+                  (program == NULL || !program->placeholders),
+              "placeholders are only allowed in templates\n");
+  if (program != NULL)
+    return append_instr(program, &new_instr);
+  // a label writes no code, but nothing before it is reordered, lengthened or
+  // fused past it (see emit_instr())
+  if (new_instr.key == LABEL)
+    return emit_instr(al, &new_instr, buf_pos, dest);
+  // stop at the first branch to a label, the input is then parsed as a whole
+  // (see assemble_all()). So are parallel slices (which log their lengths,
+  // see parallel.c) at an align directive, whose padding depends on the
+  // position of the slice.
+  if (new_instr.label_name != NULL ||
+      (new_instr.key == ALIGN && al->length_log != NULL)) {
+    al->reparse = true;
+    return EXIT_FAILURE;
+  }
+  return emit_instr(al, &new_instr, buf_pos, dest);
+}
+
+/**
+ * given and instance of @param al assembles the trailing statement @param str
+ * of @param len characters that is cut off by the end of the input from a
+ * null-terminated copy (see assemble_line())
+ */
+static int assemble_tail(assemblyline_t al, const char *str, size_t len,
+                         unsigned int *buf_pos, int *dest,
+                         struct asm_program *program) {
+
+  // names of parsed instructions point into the copy, so a program keeps it
+  char stack_copy[TAIL_COPY_LEN];
+  char *copy =
+      len < TAIL_COPY_LEN && program == NULL ? stack_copy : malloc(len + 1);
+  FAIL_IF_MSG(copy == NULL, "failed to allocate memory\n");
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  size_t num_instrs = program != NULL ? program->len : 0;
+  int ret = EXIT_SUCCESS;
+  // a label may be followed by an instruction on the same line
+  for (size_t pos = 0; ret == EXIT_SUCCESS && pos < len && copy[pos] != '\0';) {
+    int read_len = 0;
+    ret = assemble_line(al, copy + pos, copy + len, buf_pos, dest, program,
+                        &read_len);
+    pos += read_len;
+  }
+  bool named = false;
+  for (size_t i = num_instrs; program != NULL && i < program->len; i++)
+    named |= program->instrs[i].label_name != NULL ||
+             program->instrs[i].imm_name != NULL ||
+             program->instrs[i].disp_name != NULL;
+  if (ret == EXIT_SUCCESS && named) {
+    char **tails =
+        realloc(program->tails, (program->num_tails + 1) * sizeof(char *));
+    if (tails != NULL) {
+      program->tails = tails;
+      program->tails[program->num_tails++] = copy;
+      return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "assembyline: failed to allocate memory\n");
+    ret = EXIT_FAILURE;
+  }
+  if (copy != stack_copy)
+    free(copy);
+  return ret;
+}
+
+/**
+ * given and instance of @param al reads @param len characters of @param str
+ * line by line (see assemble_line()) starting at @param buf_pos
+ */
+static int read_all(assemblyline_t al, const char *str, size_t len,
+                    unsigned int *buf_pos, int *dest,
+                    struct asm_program *program) {
+
+  const char *end = str + len;
+  // the tokenizer never reads past a statement end character, so every line
+  // is assembled in place except a trailing statement without one
+  const char *tail = end;
+  while (tail > str && !is_stmt_end(tail[-1]))
+    tail--;
   const char *tokenizer = str;
-  unsigned int buf_pos = al->offset;
-  // read str and assemble instruction line by line
-  while (*tokenizer != '\0') {
-    struct instr new_instr = {0};
-    new_instr.assembly_opt = al->assembly_opt;
+  while (tokenizer < tail && *tokenizer != '\0') {
     int chars_read = 0;
-    FAIL_IF_ERR(str_to_instr(&new_instr, tokenizer, &chars_read));
+    FAIL_IF(assemble_line(al, tokenizer, end, buf_pos, dest, program,
+                          &chars_read));
     tokenizer += chars_read;
-    if (new_instr.key != SKIP) {
-      switch (al->assembly_mode) {
-      case ASSEMBLE:
-        FAIL_IF_ERR(assemble(al, &new_instr, &buf_pos));
-        break;
-      case CHUNK_COUNT:
-        FAIL_IF_ERR(assemble_counting_chunks(al, &new_instr, &buf_pos, dest));
-        break;
-      case CHUNK_FITTING:
-        FAIL_IF_ERR(assemble_with_chunk_fitting(al, &new_instr, &buf_pos));
-        break;
+  }
+  if (tokenizer == tail && tail < end)
+    FAIL_IF(assemble_tail(al, tail, end - tail, buf_pos, dest, program));
+  return EXIT_SUCCESS;
+}
+
+int assemble_all(assemblyline_t al, const char *str, size_t len, int *dest) {
+
+  if (dest != NULL)
+    *dest = 0;
+  // debug output is only printed once every branch to a label is resolved, and
+  // the peephole pass and the scheduler look ahead past the current line
+  if (al->debug || al->peephole || al->uarch)
+    return assemble_parsed(al, str, len, dest);
+  // slices cannot move the instruction fused with a jump of the next one, nor
+  // lengthen or reorder the instructions of the previous one
+  if (al->threads > 1 && al->assembly_mode != BRANCH_PADDING &&
+      !(al->assembly_mode == CHUNK_FITTING && (al->lengthen || al->reorder)) &&
+      len / PARALLEL_MIN_SLICE_LEN >= 2)
+    return assemble_parallel(al, str, len, dest);
+  struct chunk_instrs saved;
+  save_chunk_instrs(al, &saved);
+  size_t logged = al->length_log != NULL ? al->length_log->len : 0;
+  int offset = assemble_stream(al, str, len, dest);
+  // branches to labels are assembled from the whole parsed input (undoing any
+  // lengthening of the code before it and the lengths logged since)
+  if (offset == ASM_ERROR && al->reparse) {
+    restore_chunk_instrs(al, &saved);
+    if (al->length_log != NULL)
+      al->length_log->len = logged;
+    return assemble_parsed(al, str, len, dest);
+  }
+  return offset;
+}
+
+int assemble_stream(assemblyline_t al, const char *str, size_t len,
+                    int *dest) {
+
+  unsigned int buf_pos = al->offset;
+  al->reparse = false;
+  drop_scheduled(al);
+  FAIL_IF_ERR(read_all(al, str, len, &buf_pos, dest, NULL));
+  FAIL_IF_ERR(flush_scheduled(al, &buf_pos));
+  return (int)buf_pos;
+}
+
+int assemble_parsed(assemblyline_t al, const char *str, size_t len,
+                    int *dest) {
+
+  struct asm_program program = {0};
+  int offset = ASM_ERROR;
+  if (parse_all(al, str, len, &program) == EXIT_SUCCESS)
+    offset = assemble_program(al, &program, dest);
+  free_program(&program);
+  return offset;
+}
+
+/**
+ * rewrites the parsed @param program with the peephole rules of instance
+ * @param al and schedules it, resolves its branches to labels and releases its
+ * unused capacity
+ */
+static int finish_program(assemblyline_t al, struct asm_program *program) {
+
+  // instructions are removed and moved before branches refer to labels by
+  // index
+  if (al->peephole)
+    FAIL_IF(peephole(al, program));
+  if (al->uarch)
+    FAIL_IF(schedule_program(al, program));
+  FAIL_IF(resolve_labels(program));
+  // the parsed program is immutable, so release the unused capacity
+  if (program->len > 0 && program->len < program->capacity) {
+    struct instr *instrs =
+        realloc(program->instrs, program->len * sizeof(struct instr));
+    if (instrs != NULL) {
+      program->instrs = instrs;
+      program->capacity = program->len;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * parses the @param n lines @param lines of @param lens characters each (see
+ * assemble_lines()) into a single program and assembles it, so that branches
+ * may target labels on other lines
+ */
+static int assemble_parsed_lines(assemblyline_t al, const char *const *lines,
+                                 const size_t *lens, size_t n,
+                                 size_t *failed_line) {
+
+  struct asm_program program = {0};
+  int offset = ASM_ERROR;
+  size_t i = 0;
+  for (; i < n; i++) {
+    size_t len = lens != NULL ? lens[i] : strlen(lines[i]) + 1;
+    if (read_all(al, lines[i], len, NULL, NULL, &program))
+      break;
+  }
+  // chunk breaks are only counted by asm_assemble_string_counting_chunks()
+  int chunk_brks = 0;
+  if (i == n && finish_program(al, &program) == EXIT_SUCCESS)
+    offset = assemble_program(al, &program, &chunk_brks);
+  // failures after parsing (ex: an undefined label) are reported as line n
+  if (offset == ASM_ERROR && failed_line != NULL)
+    *failed_line = i;
+  free_program(&program);
+  return offset;
+}
+
+int assemble_lines(assemblyline_t al, const char *const *lines,
+                   const size_t *lens, size_t n, size_t *failed_line) {
+
+  unsigned int buf_pos = al->offset;
+  // make room for a maximum length instruction per line up front, unless the
+  // buffer grows in place without copies anyway
+  if (!al->external && al->reserved == 0 &&
+      n < (size_t)(INT_MAX - BUFFER_TOLERANCE - buf_pos) / MAX_X86_INSTR_LEN)
+    FAIL_IF_ERR(check_len_or_resize(al, buf_pos + n * MAX_X86_INSTR_LEN));
+  if (al->debug || al->peephole || al->uarch)
+    return assemble_parsed_lines(al, lines, lens, n, failed_line);
+  // chunk breaks are only counted by asm_assemble_string_counting_chunks()
+  int chunk_brks = 0;
+  al->reparse = false;
+  drop_scheduled(al);
+  struct chunk_instrs saved;
+  save_chunk_instrs(al, &saved);
+  for (size_t i = 0; i < n; i++) {
+    size_t len = lens != NULL ? lens[i] : strlen(lines[i]) + 1;
+    if (read_all(al, lines[i], len, &buf_pos, &chunk_brks, NULL)) {
+      if (al->reparse) {
+        restore_chunk_instrs(al, &saved);
+        return assemble_parsed_lines(al, lines, lens, n, failed_line);
       }
+      if (failed_line != NULL)
+        *failed_line = i;
+      return ASM_ERROR;
     }
   }
+  FAIL_IF_ERR(flush_scheduled(al, &buf_pos));
+  return (int)buf_pos;
+}
+
+void free_program(struct asm_program *program) {
+
+  free(program->instrs);
+  for (size_t i = 0; i < program->num_tails; i++)
+    free(program->tails[i]);
+  free(program->tails);
+}
+
+int parse_all(assemblyline_t al, const char *str, size_t len,
+              struct asm_program *program) {
+
+  FAIL_IF(read_all(al, str, len, NULL, NULL, program));
+  return finish_program(al, program);
+}
+
+int assemble_program(assemblyline_t al, const struct asm_program *program,
+                     int *dest) {
+
+  if (dest != NULL)
+    *dest = 0;
+  unsigned int buf_pos = al->offset;
+  drop_scheduled(al);
+  if (program->num_branches > 0)
+    FAIL_IF_ERR(relax_branches(al, program, &buf_pos, dest));
+  for (size_t i = 0; i < program->len && program->num_branches == 0; i++)
+    FAIL_IF_ERR(emit_instr(al, &program->instrs[i], &buf_pos, dest));
+  FAIL_IF_ERR(flush_scheduled(al, &buf_pos));
   // print machine code with chunk boundary fitting
   if (al->assembly_mode == CHUNK_FITTING && al->debug)
     debug_with_chunksize(al->buffer, buf_pos, al->chunk_size);
+  if (al->assembly_mode == BRANCH_PADDING && al->debug)
+    debug_with_chunksize(al->buffer, buf_pos, BRANCH_BOUNDARY);
   return (int)buf_pos;
 }
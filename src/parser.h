@@ -24,11 +24,112 @@
 #include "instructions.h"
 
 /**
- * assemble given a @param str contaning the the
+ * checks if the buffer length of @param al has been exceeded at @param buf_pos
+ * and grows an internal buffer as needed
+ */
+int check_len_or_resize(assemblyline_t al, int buf_pos);
+
+/**
+ * returns where instance @param al writes code at @param buf_pos: that
+ * position of its buffer, or the start of the buffer if it only computes
+ * lengths and positions (see measure.c)
+ */
+uint8_t *code_at(assemblyline_t al, unsigned int buf_pos);
+
+/**
+ * checks if an instruction of @param len bytes written at @param buf_pos of
+ * instance @param al needs no padding before it to fit the chunk size
+ */
+bool fits_chunk(assemblyline_t al, unsigned int len, unsigned int buf_pos);
+
+/**
+ * given and instance of @param al write the machine code of @param new_instr
+ * into @param buf_pos while enforcing chunk boundaries with nop padding (or by
+ * lengthening the instructions before it, see lengthen.c)
+ */
+int assemble_with_chunk_fitting(assemblyline_t al,
+                                const struct instr *new_instr,
+                                unsigned int *buf_pos);
+
+/**
+ * encodes @param instr_data, whose operands and INSTR_TABLE[] key are set,
+ * into the prefix, offset and immediate fields read by assemble_asm()
+ */
+int encode_instr(struct instr *instr_data);
+
+/**
+ * checks if @param first and the conditional jump @param jump that follows it
+ * are kept together by branch padding since they may macro-fuse
+ */
+bool is_fused_pair(const struct instr *first, const struct instr *jump);
+
+/**
+ * given and instance of @param al writes the machine code of @param new_instr
+ * into @param buf_pos. Assembly behaviour will differ depending on
+ * assembly_mode
+ */
+int emit_instr(assemblyline_t al, const struct instr *new_instr,
+               unsigned int *buf_pos, int *dest);
+
+/**
+ * assemble given @param len characters of @param str contaning the the
  * string representation of a x64 assembly program and writes the corresponding
- * machine code into the buffer field of @param al. Also counts the number of
- * chunks break in the buffer and stores in @param dest (if applicable)
+ * machine code into the buffer field of @param al. @param str does not need to
+ * be null-terminated, but assembly stops at the first null character. Also
+ * counts the number of chunks break in the buffer and stores in @param dest
+ * (if applicable)
+ */
+int assemble_all(assemblyline_t al, const char *str, size_t len, int *dest);
+
+/**
+ * assembles @param len characters of @param str line by line like
+ * assemble_all() but stops at the first branch to a label (or align directive
+ * of a parallel slice), setting the reparse field of @param al. Returns the
+ * new offset or ASM_ERROR.
+ */
+int assemble_stream(assemblyline_t al, const char *str, size_t len,
+                    int *dest);
+
+/**
+ * parses @param len characters of @param str as a whole and then assembles
+ * them like assemble_all(). Used for inputs with branches to labels, which are
+ * only resolved once every label is known.
+ */
+int assemble_parsed(assemblyline_t al, const char *str, size_t len,
+                    int *dest);
+
+/**
+ * assembles the @param n lines @param lines of @param lens characters each
+ * (see assemble_all(), @param lens may be NULL for null-terminated lines) into
+ * the buffer field of @param al after reserving space for them once. The index
+ * of a line that fails to assemble is stored in @param failed_line (if not
+ * NULL), or @param n if the failure is not specific to a line (ex: a branch to
+ * an undefined label). Returns the new offset or ASM_ERROR.
+ */
+int assemble_lines(assemblyline_t al, const char *const *lines,
+                   const size_t *lens, size_t n, size_t *failed_line);
+
+/**
+ * frees the instructions of @param program and the copies of trailing
+ * statements its names point into (but not @param program itself)
+ */
+void free_program(struct asm_program *program);
+
+/**
+ * parses @param len characters of @param str (see assemble_all()) with the
+ * assembly options of @param al and appends the resulting instructions to
+ * @param program, which must be zero-initialized. Resolves the labels that
+ * branches of @param program target.
+ */
+int parse_all(assemblyline_t al, const char *str, size_t len,
+              struct asm_program *program);
+
+/**
+ * writes the machine code of the parsed @param program into the buffer field
+ * of @param al, starting at its offset. Also counts the number of chunks
+ * break in the buffer and stores in @param dest (if applicable)
  */
-int assemble_all(assemblyline_t al, const char *str, int *dest);
+int assemble_program(assemblyline_t al, const struct asm_program *program,
+                     int *dest);
 
 #endif
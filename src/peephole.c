@@ -0,0 +1,367 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*rewrites naive idioms of a parsed program into shorter or cheaper
+ * instructions that do the same, ex: mov rax, 0 into xor eax, eax. A rewrite
+ * that changes the flags is only made where they are dead: the next
+ * instruction of the basic block that touches them writes them without reading
+ * them (see get_effects()), or returns.*/
+#include "peephole.h"
+#include "assembler.h"
+#include "builder.h"
+#include "parser.h"
+#include "reorder.h"
+#include <stdlib.h>
+
+// enough room for any encoding assemble_asm() produces
+#define MAX_ENCODING_LEN 32
+// numbers of rsp, which cannot be an index register, and of rbp (and r13),
+// which cannot be a base register without a displacement
+#define RSP_NUM 4
+#define RBP_NUM 5
+
+/**
+ * checks if @param reg is a 32 or 64-bit general purpose register
+ */
+static bool is_wide_reg(asm_reg reg) {
+
+  if (reg & (reg_none | reg_error))
+    return false;
+  switch (reg & MODE_MASK) {
+  case reg32:
+  case ext32:
+  case reg64:
+  case ext64:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * checks if operand @param i of @param instr_data is a general purpose
+ * register (of 32 or 64 bits if @param wide is set)
+ */
+static bool is_gpr(const struct instr *instr_data, int i, bool wide) {
+  const struct operand *opd = &instr_data->opd[i];
+  return opd->type == 'r' && to_register(opd->reg) != AL_NOREG &&
+         (!wide || is_wide_reg(opd->reg));
+}
+
+/**
+ * checks if the last operand of @param instr_data, operand @param i, is the
+ * immediate @param value (and not a template placeholder)
+ */
+static bool is_imm(const struct instr *instr_data, int i,
+                   unsigned long value) {
+  return instr_data->opd[i].type == 'i' &&
+         (i + 1 == NUM_OF_OPD || instr_data->opd[i + 1].type == '\0') &&
+         instr_data->imm_name == NULL && instr_data->cons == value;
+}
+
+/**
+ * returns the 32-bit (or 64-bit if @param wide is set) general purpose
+ * register with the number of @param reg
+ */
+static enum asm_register resize_reg(asm_reg reg, bool wide) {
+
+  bool ext = (reg & MODE_MASK) == ext32 || (reg & MODE_MASK) == ext64;
+  if (wide)
+    return to_register((ext ? ext64 : reg64) | (reg & REG_MASK));
+  return to_register((ext ? ext32 : reg32) | (reg & REG_MASK));
+}
+
+/**
+ * checks if the flags are dead after the instruction at @param pos of
+ * @param program. They are live at the end of the program, as the input of a
+ * later call may read them.
+ */
+static bool flags_dead(const struct asm_program *program, size_t pos) {
+
+  for (size_t i = pos + 1; i < program->len; i++) {
+    const struct instr *next = &program->instrs[i];
+    // the status flags are not preserved across calls
+    if (INSTR_TABLE[next->key].name == ret)
+      return true;
+    struct effects e;
+    if (!get_effects(next, &e) || e.reads_flags)
+      return false;
+    if (e.writes_flags)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * checks if @param instr_data moves back what the mov @param prev moved, ie.
+ * mov b, a after mov a, b (64-bit registers, as a 32-bit mov would clear the
+ * upper half of b)
+ */
+static bool is_mov_back(const struct instr *prev,
+                        const struct instr *instr_data) {
+
+  if (INSTR_TABLE[prev->key].name != mov ||
+      INSTR_TABLE[instr_data->key].name != mov)
+    return false;
+  for (int i = 0; i < 2; i++)
+    if (!is_gpr(prev, i, true) || !is_gpr(instr_data, i, true) ||
+        resize_reg(instr_data->opd[i].reg, true) !=
+            to_register(instr_data->opd[i].reg))
+      return false;
+  return prev->opd[2].type == '\0' && instr_data->opd[2].type == '\0' &&
+         prev->opd[0].reg != prev->opd[1].reg &&
+         prev->opd[0].reg == instr_data->opd[1].reg &&
+         prev->opd[1].reg == instr_data->opd[0].reg;
+}
+
+/**
+ * returns the length of the machine code of @param instr_data
+ */
+static unsigned int encoded_len(const struct instr *instr_data) {
+  uint8_t code[MAX_ENCODING_LEN];
+  return assemble_asm(instr_data, code);
+}
+
+/**
+ * builds @param mnemonic with the operands @param opds (see build_instr()) into
+ * @param new_instr with the assembly options of @param instr_data
+ */
+static int build(struct instr *new_instr, const struct instr *instr_data,
+                 enum asm_mnemonic mnemonic, const struct asm_operand opds[]) {
+
+  *new_instr = (struct instr){0};
+  new_instr->assembly_opt = instr_data->assembly_opt;
+  FAIL_IF(build_instr(new_instr, mnemonic, opds));
+  return encode_instr(new_instr);
+}
+
+/**
+ * replaces @param instr_data by @param new_instr and adds the rewrite and the
+ * bytes it saves to the counts of instance @param al
+ */
+static void commit(assemblyline_t al, struct instr *instr_data,
+                   const struct instr *new_instr) {
+
+  unsigned int len = encoded_len(instr_data);
+  unsigned int new_len = encoded_len(new_instr);
+  al->peephole_count++;
+  al->peephole_saved += len > new_len ? len - new_len : 0;
+  *instr_data = *new_instr;
+}
+
+/**
+ * replaces @param instr_data by @param mnemonic with the operands @param opds
+ * for instance @param al (see commit())
+ */
+static int replace(assemblyline_t al, struct instr *instr_data,
+                   enum asm_mnemonic mnemonic,
+                   const struct asm_operand opds[]) {
+
+  struct instr new_instr;
+  FAIL_IF(build(&new_instr, instr_data, mnemonic, opds));
+  commit(al, instr_data, &new_instr);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * returns the size in bits of the destination of @param instr_data
+ */
+static unsigned int dest_bits(const struct instr *instr_data) {
+
+  if (instr_data->opd[0].type == 'm')
+    return instr_data->keyword.is_byte    ? 8
+           : instr_data->keyword.is_word  ? 16
+           : instr_data->keyword.is_dword ? 32
+                                          : 64;
+  switch (instr_data->opd[0].reg & MODE_MASK) {
+  case reg64:
+  case ext64:
+    return 64;
+  case reg32:
+  case ext32:
+    return 32;
+  case reg16:
+  case ext16:
+    return 16;
+  default:
+    return 8;
+  }
+}
+
+/**
+ * returns the value the mov of a constant @param instr_data with a
+ * destination of @param bits sets
+ */
+static unsigned long mov_value(const struct instr *instr_data,
+                               unsigned int bits) {
+
+  // an imm32 sign-extended to 64 bits is stored without its sign extension
+  if (bits == 64 && INSTR_TABLE[instr_data->key].encode_operand != I)
+    return (unsigned long)(int64_t)(int32_t)instr_data->cons;
+  return bits == 64 ? instr_data->cons
+                    : instr_data->cons & ((1UL << bits) - 1);
+}
+
+/**
+ * replaces @param best by @param mnemonic with the operands @param opds if it
+ * is shorter (see build())
+ */
+static void try_shorter(struct instr *best, const struct instr *instr_data,
+                        enum asm_mnemonic mnemonic,
+                        const struct asm_operand opds[]) {
+
+  struct instr new_instr;
+  if (build(&new_instr, instr_data, mnemonic, opds) == EXIT_SUCCESS &&
+      encoded_len(&new_instr) < encoded_len(best))
+    *best = new_instr;
+}
+
+/**
+ * rewrites the mov of a constant at @param pos of @param program into the
+ * shortest instruction that sets its register destination to the same value
+ * for instance @param al: xor r32, r32 for 0 and or r, -1 for all ones where
+ * the flags are dead, mov r32, imm32 for values a 32-bit destination
+ * zero-extends and mov r64, imm32 for values it sign-extends, which leaves
+ * movabs for the values nothing else sets. Memory destinations are left alone:
+ * and m, 0 and or m, -1 are shorter but load the memory they store to.
+ */
+static int materialize(assemblyline_t al, struct asm_program *program,
+                       size_t pos) {
+
+  struct instr *instr_data = &program->instrs[pos];
+  struct asm_operand dest = AL_REG(to_register(instr_data->opd[0].reg));
+  if (INSTR_TABLE[instr_data->key].name != mov || !instr_data->imm ||
+      !is_imm(instr_data, 1, instr_data->cons) ||
+      !is_gpr(instr_data, 0, false))
+    return EXIT_SUCCESS;
+  unsigned int bits = dest_bits(instr_data);
+  unsigned long mask = bits == 64 ? ~0UL : (1UL << bits) - 1;
+  unsigned long value = mov_value(instr_data, bits);
+  bool wide = bits >= 32;
+  struct instr best = *instr_data;
+  if ((value == 0 || value == mask) && flags_dead(program, pos)) {
+    struct asm_operand zero = dest;
+    if (wide)
+      zero = AL_REG(resize_reg(instr_data->opd[0].reg, false));
+    if (value == 0)
+      try_shorter(&best, instr_data, AL_XOR,
+                  (struct asm_operand[]){zero, zero, {AL_OPD_NONE}});
+    else
+      try_shorter(&best, instr_data, AL_OR,
+                  (struct asm_operand[]){dest, AL_IMM(-1), {AL_OPD_NONE}});
+  }
+  if (wide && value <= MAX_UNSIGNED_32BIT) {
+    struct asm_operand dest32 =
+        AL_REG(resize_reg(instr_data->opd[0].reg, false));
+    try_shorter(&best, instr_data, AL_MOV,
+                (struct asm_operand[]){dest32, AL_IMM(value), {AL_OPD_NONE}});
+  } else if (wide && bits == 64 && (int64_t)value == (int32_t)value) {
+    try_shorter(&best, instr_data, AL_MOV,
+                (struct asm_operand[]){dest, AL_IMM((int32_t)value),
+                                       {AL_OPD_NONE}});
+  }
+  if (encoded_len(&best) < encoded_len(instr_data))
+    commit(al, instr_data, &best);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * rewrites the instruction at @param pos of @param program with the first of
+ * the peephole rules of instance @param al that applies
+ */
+static int rewrite(assemblyline_t al, struct asm_program *program,
+                   size_t pos) {
+
+  struct instr *instr_data = &program->instrs[pos];
+  const struct operand *opd = instr_data->opd;
+  unsigned int rules = al->peephole;
+  int name = INSTR_TABLE[instr_data->key].name;
+  if (rules & AL_PEEPHOLE_CONST) {
+    size_t count = al->peephole_count;
+    FAIL_IF(materialize(al, program, pos));
+    if (al->peephole_count != count)
+      return EXIT_SUCCESS;
+  }
+  if (!is_gpr(instr_data, 0, false))
+    return EXIT_SUCCESS;
+  enum asm_register dest = to_register(opd[0].reg);
+  // mov r, 0 -> xor r32, r32 (which clears the upper half too)
+  if ((rules & AL_PEEPHOLE_ZERO) && name == mov && is_wide_reg(opd[0].reg) &&
+      is_imm(instr_data, 1, 0) && flags_dead(program, pos)) {
+    enum asm_register dest32 = resize_reg(opd[0].reg, false);
+    return replace(al, instr_data, AL_XOR,
+                   (struct asm_operand[]){AL_REG(dest32), AL_REG(dest32),
+                                          {AL_OPD_NONE}});
+  }
+  // cmp r, 0 -> test r, r sets the same flags (except for AF, which test
+  // leaves undefined)
+  if ((rules & AL_PEEPHOLE_TEST) && name == cmp && is_imm(instr_data, 1, 0))
+    return replace(al, instr_data, AL_TEST,
+                   (struct asm_operand[]){AL_REG(dest), AL_REG(dest),
+                                          {AL_OPD_NONE}});
+  // add r, 1 -> inc r and sub r, 1 -> dec r, which leave CF alone
+  if ((rules & AL_PEEPHOLE_INC) && (name == add || name == sub) &&
+      is_imm(instr_data, 1, 1) && flags_dead(program, pos))
+    return replace(al, instr_data, name == add ? AL_INC : AL_DEC,
+                   (struct asm_operand[]){AL_REG(dest), {AL_OPD_NONE}});
+  // imul r, r, 2/4/8 -> shl r, 1/2/3 and imul r, s, 2 -> lea r, [s+s]
+  if (!(rules & AL_PEEPHOLE_MUL) || name != imul || !is_wide_reg(opd[0].reg))
+    return EXIT_SUCCESS;
+  asm_reg src = opd[0].reg;
+  int imm_pos = 1;
+  if (is_gpr(instr_data, 1, true)) {
+    src = opd[1].reg;
+    imm_pos = 2;
+  }
+  for (unsigned int shift = 1; shift <= 3; shift++) {
+    if (!is_imm(instr_data, imm_pos, 1UL << shift) ||
+        !flags_dead(program, pos))
+      continue;
+    if (src == opd[0].reg)
+      return replace(al, instr_data, AL_SHL,
+                     (struct asm_operand[]){AL_REG(dest), AL_IMM(shift),
+                                            {AL_OPD_NONE}});
+    // the upper half of the sum is cleared by a 32-bit destination, and rbp
+    // and r13 would need a displacement
+    if (shift == 1 && (src & REG_MASK) != RSP_NUM &&
+        (src & VALUE_MASK) != RBP_NUM) {
+      enum asm_register src64 = resize_reg(src, true);
+      return replace(al, instr_data, AL_LEA,
+                     (struct asm_operand[]){AL_REG(dest),
+                                            AL_MEM(src64, src64, 1, 0),
+                                            {AL_OPD_NONE}});
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int peephole(assemblyline_t al, struct asm_program *program) {
+
+  size_t len = 0;
+  for (size_t i = 0; i < program->len; i++) {
+    if ((al->peephole & AL_PEEPHOLE_MOV) && len > 0 &&
+        is_mov_back(&program->instrs[len - 1], &program->instrs[i])) {
+      al->peephole_count++;
+      al->peephole_saved += encoded_len(&program->instrs[i]);
+      continue;
+    }
+    FAIL_IF(rewrite(al, program, i));
+    // the instructions after i are looked ahead at as they were parsed
+    program->instrs[len++] = program->instrs[i];
+  }
+  program->len = len;
+  return EXIT_SUCCESS;
+}
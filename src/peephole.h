@@ -0,0 +1,32 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines the peephole pass rewriting naive idioms of parsed programs*/
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * rewrites the instructions of the parsed @param program (before its branches
+ * are resolved) with the peephole rules enabled for instance @param al (see
+ * asm_set_peephole()) and adds the number of rewrites to its count
+ */
+int peephole(assemblyline_t al, struct asm_program *program);
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements a thread safe pool of instances whose memory buffers stay mapped
+ * between uses*/
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+// released instances kept with their memory buffers mapped for reuse
+struct asm_pool {
+  pthread_mutex_t lock;
+  // stack of retained instances
+  struct assemblyline **instances;
+  size_t max_retained;
+  struct asm_pool_stats stats;
+};
+
+struct asm_pool *create_pool(size_t max_retained) {
+
+  struct asm_pool *pool = calloc(1, sizeof(struct asm_pool));
+  if (pool == NULL)
+    return NULL;
+  if (max_retained > 0)
+    pool->instances = malloc(max_retained * sizeof(struct assemblyline *));
+  if ((max_retained > 0 && pool->instances == NULL) ||
+      pthread_mutex_init(&pool->lock, NULL)) {
+    free(pool->instances);
+    free(pool);
+    return NULL;
+  }
+  pool->max_retained = max_retained;
+  return pool;
+}
+
+assemblyline_t pool_acquire(struct asm_pool *pool) {
+
+  assemblyline_t al = NULL;
+  pthread_mutex_lock(&pool->lock);
+  if (pool->stats.retained > 0) {
+    al = pool->instances[--pool->stats.retained];
+    pool->stats.bytes_retained -= al->buffer_len;
+    pool->stats.hits++;
+  } else {
+    pool->stats.misses++;
+  }
+  pthread_mutex_unlock(&pool->lock);
+  // instances are created and reset outside of the lock
+  if (al == NULL)
+    return asm_create_instance(NULL, 0);
+  asm_reset(al);
+  return al;
+}
+
+int pool_release(struct asm_pool *pool, assemblyline_t al) {
+
+  bool retained = false;
+  if (!al->external) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->stats.retained < pool->max_retained) {
+      pool->instances[pool->stats.retained++] = al;
+      pool->stats.bytes_retained += al->buffer_len;
+      retained = true;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  if (!retained)
+    return asm_destroy_instance(al);
+  return EXIT_SUCCESS;
+}
+
+struct asm_pool_stats pool_stats(struct asm_pool *pool) {
+
+  pthread_mutex_lock(&pool->lock);
+  struct asm_pool_stats stats = pool->stats;
+  pthread_mutex_unlock(&pool->lock);
+  return stats;
+}
+
+int destroy_pool(struct asm_pool *pool) {
+
+  int ret = EXIT_SUCCESS;
+  for (size_t i = 0; i < pool->stats.retained; i++)
+    ret |= asm_destroy_instance(pool->instances[i]);
+  free(pool->instances);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+  return ret;
+}
@@ -0,0 +1,53 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for reusing instances and their memory buffers*/
+#ifndef POOL_H
+#define POOL_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * allocates a pool that retains up to @param max_retained instances. Returns
+ * NULL on failure.
+ */
+struct asm_pool *create_pool(size_t max_retained);
+
+/**
+ * pops a retained instance from @param pool and resets it, or creates a new
+ * instance if @param pool is empty. Returns NULL on failure.
+ */
+assemblyline_t pool_acquire(struct asm_pool *pool);
+
+/**
+ * pushes @param al onto @param pool, or destroys it if @param pool is full or
+ * @param al does not own its memory buffer
+ */
+int pool_release(struct asm_pool *pool, assemblyline_t al);
+
+/**
+ * returns a snapshot of the statistics of @param pool
+ */
+struct asm_pool_stats pool_stats(struct asm_pool *pool);
+
+/**
+ * destroys the retained instances of @param pool and frees @param pool
+ */
+int destroy_pool(struct asm_pool *pool);
+
+#endif
@@ -29,12 +29,6 @@
  */
 int get_opcode_offset(struct instr *instrc);
 
-/**
- * finds the register in @param str and copies the characters to @param reg
- * ex: "[rax+0x8]" or "rax ," -> "rax"
- */
-void get_reg_str(char *opd_str, char *reg);
-
 /**
  * converts @param neg_num to is negative 2's complement representation and
  * return the value
@@ -42,24 +36,11 @@ void get_reg_str(char *opd_str, char *reg);
 uint32_t process_neg_disp(uint32_t neg_num);
 
 /**
- * finds the index register in @param mem and copies characters to @param reg
- * ex: "[rax+rbp]" -> "rbp"
- */
-unsigned int get_index_reg(struct instr *instruc, const char *mem, char reg[]);
-
-/**
- * finds the addition sign in @param mem and returns the index of memory
- * displacement as well as determining its base its sign(+ or -)
- */
-int find_add_mem(char *mem, bool *neg, int *base);
-
-int find_mem_const(char *mem, bool *neg, int *base);
-
-/**
- * determines operand type of @param operand, returns 'r' for register, 'm' for
- * memory reference, and 'i' immediate.
+ * takes a register name packed little endian into @param name (see
+ * lookup_hash_pack()) and returns the corresponding enum representation or
+ * reg_error
  */
-char get_operand_type(const char *operand);
+asm_reg packed_str_to_reg(uint64_t name);
 
 /**
  * takes a string representation of a register @param reg and return the
@@ -0,0 +1,267 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*fills the gap before a chunk boundary with a later instruction instead of
+ * nops: the instructions of a basic block are queued, and one that fits the
+ * gap is moved up if it depends on none of the instructions it passes. An
+ * instruction depends on another if either writes a register, the flags or
+ * memory the other reads or writes. Memory is treated as a whole, so loads may
+ * pass loads but nothing passes a store.*/
+#include "reorder.h"
+#include "assembler.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+// enough room for any encoding assemble_asm() produces
+#define MAX_ENCODING_LEN 32
+
+// the instructions queued to be written in program order
+struct reorder_window {
+  struct instr instrs[MAX_REORDER_INSTRS];
+  struct effects effects[MAX_REORDER_INSTRS];
+  uint8_t lens[MAX_REORDER_INSTRS];
+  size_t len;
+};
+
+/**
+ * returns the bit of the general purpose or vector register @param reg, or 0
+ * if there is no register
+ */
+static uint32_t reg_bit(asm_reg reg) {
+
+  if (reg & (reg_none | reg_error))
+    return 0;
+  unsigned int num = reg & REG_MASK;
+  // ah, ch, dh and bh share the number of spl, bpl, sil and dil
+  if ((reg & MODE_MASK) == noext8)
+    num -= spl;
+  return 1U << num;
+}
+
+/**
+ * sets the flags @param instr_data reads and writes in @param e. Returns false
+ * if its effects are not known, ex: as it reads or writes registers that are
+ * not its operands, is a jump or is meant to stay in place (fences, timers and
+ * nops).
+ */
+static bool flag_effects(const struct instr *instr_data, struct effects *e) {
+
+  int name = INSTR_TABLE[instr_data->key].name;
+  // conditional moves and sets read the flags
+  if (IN_RANGE(name, cmova, cmovz) || IN_RANGE(name, seta, setz)) {
+    e->reads_flags = true;
+    return true;
+  }
+  // SSE and AVX instructions leave the flags alone
+  if (IN_RANGE(name, paddb, pmuludq) || IN_RANGE(name, psrldq, punpcklqdq) ||
+      IN_RANGE(name, vaddpd, vsubpd))
+    return true;
+  switch (name) {
+  case adc:
+  case adcx:
+  case adox:
+  case sbb:
+  case rcr:
+  // inc, dec and clc leave some flags as they were, and so does a shift by 0
+  case clc:
+  case dec:
+  case inc:
+  case ror:
+  case sal:
+  case sar:
+  case shl:
+  case shld:
+  case shr:
+  case shrd:
+    e->reads_flags = true;
+    e->writes_flags = true;
+    return true;
+  case add:
+  case and:
+  case bextr:
+  case bzhi:
+  case cmp:
+  case imul:
+  case mul:
+  case neg:
+  case or:
+  case sub:
+  case test:
+  case xor:
+    e->writes_flags = true;
+    return true;
+  case cvtdq2pd:
+  case cvtpd2dq:
+  case divpd:
+  case lea:
+  case mov:
+  case movd:
+  case movntdqa:
+  case movq:
+  case movzx:
+  case mulpd:
+  case mulx:
+  case not:
+  case por:
+  case pxor:
+  case rorx:
+  case sarx:
+  case shlx:
+  case shrx:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool get_effects(const struct instr *instr_data, struct effects *e) {
+
+  *e = (struct effects){0};
+  if (!flag_effects(instr_data, e))
+    return false;
+  const struct instr_table *row = &INSTR_TABLE[instr_data->key];
+  int name = row->name;
+  // mul and one-operand imul (its only M encoding) multiply rax into rdx:rax
+  bool widening = name == mul || (name == imul && row->encode_operand == M);
+  for (int i = 0; i < NUM_OF_OPD; i++) {
+    const struct operand *opd = &instr_data->opd[i];
+    // the first operand is the destination, except of compares and widening
+    // multiplies, and mulx writes its second one too
+    bool dest = (i == 0 && name != cmp && name != test && !widening) ||
+                (i == 1 && name == mulx);
+    switch (opd->type) {
+    case 'r':
+    case 'v':
+    case 'y':
+      e->reads |= reg_bit(opd->reg);
+      if (dest)
+        e->writes |= reg_bit(opd->reg);
+      break;
+    case 'm':
+      e->reads |= reg_bit(opd->reg) | reg_bit(opd->index);
+      // lea only computes the address
+      e->reads_mem |= name != lea;
+      e->writes_mem |= dest;
+      break;
+    default:
+      break;
+    }
+  }
+  // mulx reads rdx
+  if (widening)
+    e->writes |= reg_bit(al) | reg_bit(dl);
+  if (widening || name == mulx)
+    e->reads |= reg_bit(al) | reg_bit(dl);
+  return true;
+}
+
+/**
+ * checks if the instructions of effects @param a and @param b must stay in
+ * order
+ */
+static bool depends(const struct effects *a, const struct effects *b) {
+  return (a->writes & (b->reads | b->writes)) || (a->reads & b->writes) ||
+         (a->writes_flags && (b->reads_flags || b->writes_flags)) ||
+         (a->reads_flags && b->writes_flags) ||
+         (a->writes_mem && (b->reads_mem || b->writes_mem)) ||
+         (a->reads_mem && b->writes_mem);
+}
+
+bool is_reorderable(const struct instr *instr_data) {
+  struct effects e;
+  return get_effects(instr_data, &e);
+}
+
+/**
+ * returns the index of the longest queued instruction of @param window that
+ * fits the @param gap bytes before the next chunk boundary and may be moved
+ * above the instructions queued before it, or 0 if there is none
+ */
+static size_t find_filler(const struct reorder_window *window,
+                          unsigned int gap) {
+
+  size_t filler = 0;
+  for (size_t i = 1; i < window->len; i++) {
+    if (window->lens[i] > gap ||
+        (filler && window->lens[i] <= window->lens[filler]))
+      continue;
+    bool independent = true;
+    for (size_t j = 0; j < i && independent; j++)
+      independent = !depends(&window->effects[j], &window->effects[i]);
+    if (independent)
+      filler = i;
+  }
+  return filler;
+}
+
+/**
+ * writes the next queued instruction of instance @param al to @param buf_pos:
+ * the first one, or a filler if it does not fit the current chunk (see
+ * find_filler())
+ */
+static int write_next(assemblyline_t al, unsigned int *buf_pos) {
+
+  struct reorder_window *window = al->reorder_window;
+  size_t next = 0;
+  if (!fits_chunk(al, window->lens[0], *buf_pos)) {
+    unsigned int gap = al->chunk_size - (*buf_pos % al->chunk_size);
+    next = find_filler(window, gap);
+  }
+  // an instruction that fits no gap is padded like any other
+  FAIL_IF(assemble_with_chunk_fitting(al, &window->instrs[next], buf_pos));
+  window->len--;
+  size_t moved = window->len - next;
+  memmove(&window->instrs[next], &window->instrs[next + 1],
+          moved * sizeof(struct instr));
+  memmove(&window->effects[next], &window->effects[next + 1],
+          moved * sizeof(struct effects));
+  memmove(&window->lens[next], &window->lens[next + 1], moved);
+  return EXIT_SUCCESS;
+}
+
+int schedule_instr(assemblyline_t al, const struct instr *instr_data,
+                   unsigned int *buf_pos) {
+
+  if (al->reorder_window == NULL) {
+    // without memory to queue instructions, they are written in order
+    al->reorder_window = calloc(1, sizeof(struct reorder_window));
+    if (al->reorder_window == NULL)
+      return assemble_with_chunk_fitting(al, instr_data, buf_pos);
+  }
+  struct reorder_window *window = al->reorder_window;
+  // the earliest instruction no longer waits for a later one to fill its gap
+  if (window->len == MAX_REORDER_INSTRS)
+    FAIL_IF(write_next(al, buf_pos));
+  uint8_t code[MAX_ENCODING_LEN];
+  window->instrs[window->len] = *instr_data;
+  get_effects(instr_data, &window->effects[window->len]);
+  window->lens[window->len] = assemble_asm(instr_data, code);
+  window->len++;
+  return EXIT_SUCCESS;
+}
+
+int flush_scheduled(assemblyline_t al, unsigned int *buf_pos) {
+
+  while (al->reorder_window != NULL && al->reorder_window->len > 0)
+    FAIL_IF(write_next(al, buf_pos));
+  return EXIT_SUCCESS;
+}
+
+void drop_scheduled(assemblyline_t al) {
+  if (al->reorder_window != NULL)
+    al->reorder_window->len = 0;
+}
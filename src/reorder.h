@@ -0,0 +1,74 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for filling chunk gaps by reordering instructions*/
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+// the registers (a bit per general purpose and per vector register), flags
+// and memory an instruction reads and writes. Instructions that leave some of
+// the flags as they were (ex: inc) read and write them.
+struct effects {
+  uint32_t reads;
+  uint32_t writes;
+  bool reads_flags : 1;
+  bool writes_flags : 1;
+  bool reads_mem : 1;
+  bool writes_mem : 1;
+};
+
+/**
+ * stores the effects of @param instr_data in @param e and returns false if they
+ * are not known, ex: as it reads or writes registers that are not its
+ * operands, is a jump or is meant to stay in place (fences, timers and nops)
+ */
+bool get_effects(const struct instr *instr_data, struct effects *e);
+
+/**
+ * checks if the registers, flags and memory @param instr_data reads and writes
+ * are known, so that it may be moved past the instructions around it. Any
+ * other instruction (ex: a jump, label, fence or push) ends the block of
+ * instructions that are reordered.
+ */
+bool is_reorderable(const struct instr *instr_data);
+
+/**
+ * queues the reorderable @param instr_data for instance @param al. Queued
+ * instructions are written from @param buf_pos in program order, except that
+ * when the next one would cross a chunk boundary, a later one that fits the
+ * gap and depends on none of the instructions it is moved above is written
+ * first.
+ */
+int schedule_instr(assemblyline_t al, const struct instr *instr_data,
+                   unsigned int *buf_pos);
+
+/**
+ * writes all instructions queued by schedule_instr() for instance @param al
+ * from @param buf_pos
+ */
+int flush_scheduled(assemblyline_t al, unsigned int *buf_pos);
+
+/**
+ * discards the instructions queued by schedule_instr() for instance @param al
+ * without writing them (ex: before a pass that starts over)
+ */
+void drop_scheduled(assemblyline_t al);
+
+#endif
@@ -0,0 +1,360 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*reorders the straight-line blocks of a parsed program to shorten their
+ * critical path: a block is a run of instructions whose effects are known (see
+ * get_effects()), and an instruction depends on an earlier one if either
+ * writes a register or memory the other reads or writes, or the flags the
+ * other reads. Flags that are written again before they are read are dead, so
+ * instructions writing them (ex: imul, add) may pass each other, just not into
+ * the range between a flag write that is read and its reader. The
+ * instructions are list scheduled cycle by cycle, each time issuing the ready
+ * instruction with the longest path of latencies to the end of the block that
+ * fits the issue width and the execution ports left, and ties are broken by
+ * program order so the result is deterministic.*/
+#include "scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the execution ports each class of instructions uses
+static const enum sched_unit CLASS_UNIT[NUM_CLASSES] = {
+    [CLASS_MOVE] = UNIT_NONE, [CLASS_ALU] = UNIT_ALU,
+    [CLASS_IMUL] = UNIT_MUL,  [CLASS_WIDE_MUL] = UNIT_MUL,
+    [CLASS_VEC] = UNIT_VEC,   [CLASS_VEC_MUL] = UNIT_FMA,
+    [CLASS_FP] = UNIT_FMA,    [CLASS_DIV] = UNIT_DIV};
+
+// indexed by enum asm_uarch
+static const struct uarch_model UARCH_MODELS[] = {
+    [AL_UARCH_SKYLAKE] = {.width = 4,
+                          .units = {[UNIT_ALU] = 4,
+                                    [UNIT_MUL] = 1,
+                                    [UNIT_VEC] = 3,
+                                    [UNIT_FMA] = 2,
+                                    [UNIT_DIV] = 1},
+                          .load_ports = 2,
+                          .store_ports = 1,
+                          .load_latency = 5,
+                          .latency = {[CLASS_ALU] = 1,
+                                      [CLASS_IMUL] = 3,
+                                      [CLASS_WIDE_MUL] = 4,
+                                      [CLASS_VEC] = 1,
+                                      [CLASS_VEC_MUL] = 5,
+                                      [CLASS_FP] = 4,
+                                      [CLASS_DIV] = 14}},
+    [AL_UARCH_ZEN3] = {.width = 6,
+                       .units = {[UNIT_ALU] = 4,
+                                 [UNIT_MUL] = 1,
+                                 [UNIT_VEC] = 4,
+                                 [UNIT_FMA] = 2,
+                                 [UNIT_DIV] = 1},
+                       .load_ports = 3,
+                       .store_ports = 2,
+                       .load_latency = 4,
+                       .latency = {[CLASS_ALU] = 1,
+                                   [CLASS_IMUL] = 3,
+                                   [CLASS_WIDE_MUL] = 4,
+                                   [CLASS_VEC] = 1,
+                                   [CLASS_VEC_MUL] = 3,
+                                   [CLASS_FP] = 3,
+                                   [CLASS_DIV] = 13}},
+};
+
+const struct uarch_model *get_uarch_model(unsigned int uarch) {
+  if (uarch == AL_UARCH_NONE || uarch > AL_UARCH_ZEN3)
+    return NULL;
+  return &UARCH_MODELS[uarch];
+}
+
+// the instructions, ports and loads and stores issued in the current cycle
+struct cycle_use {
+  unsigned int instrs;
+  unsigned int units[NUM_UNITS];
+  unsigned int loads;
+  unsigned int stores;
+};
+
+/**
+ * returns the class of the instruction @param instr_data with the effects
+ * @param e
+ */
+static enum sched_class get_class(const struct instr *instr_data,
+                                  const struct effects *e) {
+
+  int name = INSTR_TABLE[instr_data->key].name;
+  switch (name) {
+  // one-operand imul (its only M encoding) writes rdx:rax like mul
+  case imul:
+    return INSTR_TABLE[instr_data->key].encode_operand == M ? CLASS_WIDE_MUL
+                                                            : CLASS_IMUL;
+  case mul:
+  case mulx:
+    return CLASS_WIDE_MUL;
+  case divpd:
+  case vdivpd:
+    return CLASS_DIV;
+  case cvtdq2pd:
+  case cvtpd2dq:
+  case mulpd:
+  case vaddpd:
+  case vmulpd:
+  case vsubpd:
+    return CLASS_FP;
+  case mov:
+  case movd:
+  case movntdqa:
+  case movq:
+  case movzx:
+  case vmovdqu:
+  case vmovupd:
+    if (e->reads_mem || e->writes_mem)
+      return CLASS_MOVE;
+    break;
+  default:
+    break;
+  }
+  if (IN_RANGE(name, pmuldq, pmuludq) || IN_RANGE(name, vpmuldq, vpmuludq))
+    return CLASS_VEC_MUL;
+  if (IN_RANGE(name, paddb, pmuludq) || IN_RANGE(name, psrldq, punpcklqdq) ||
+      IN_RANGE(name, vaddpd, vsubpd) || name == por || name == pxor)
+    return CLASS_VEC;
+  return CLASS_ALU;
+}
+
+/**
+ * checks if @param b must stay after the earlier @param a
+ */
+static bool depends(const struct sched_node *a, const struct sched_node *b) {
+  const struct effects *x = &a->effects;
+  const struct effects *y = &b->effects;
+  return (x->writes & (y->reads | y->writes)) || (x->reads & y->writes) ||
+         (x->writes_flags && y->reads_flags) ||
+         (x->reads_flags && y->writes_flags) ||
+         (x->writes_flags && y->writes_flags && b->flags_live) ||
+         (x->writes_mem && (y->reads_mem || y->writes_mem)) ||
+         (x->reads_mem && y->writes_mem);
+}
+
+/**
+ * returns the cycles @param b waits for @param a it depends on: the latency of
+ * @param a if @param b reads a register or the flags it writes, that of a load
+ * forwarded from a store if @param b reads the memory @param a writes, and none
+ * if they only must stay in order
+ */
+static unsigned int edge_latency(const struct uarch_model *model,
+                                 const struct sched_node *a,
+                                 const struct sched_node *b) {
+
+  if ((a->effects.writes & b->effects.reads) ||
+      (a->effects.writes_flags && b->effects.reads_flags))
+    return a->latency;
+  if (a->effects.writes_mem && b->effects.reads_mem)
+    return model->load_latency;
+  return 0;
+}
+
+/**
+ * checks if @param node may be issued in the cycle with @param use of
+ * @param model
+ */
+static bool fits_cycle(const struct uarch_model *model,
+                       const struct cycle_use *use,
+                       const struct sched_node *node) {
+
+  return use->instrs < model->width &&
+         (node->unit == UNIT_NONE ||
+          use->units[node->unit] < model->units[node->unit]) &&
+         (!node->load || use->loads < model->load_ports) &&
+         (!node->store || use->stores < model->store_ports);
+}
+
+/**
+ * adds @param node issued to @param use
+ */
+static void take_cycle(struct cycle_use *use, const struct sched_node *node) {
+  use->instrs++;
+  use->units[node->unit]++;
+  use->loads += node->load;
+  use->stores += node->store;
+}
+
+void build_nodes(const struct uarch_model *model, const struct instr *instrs,
+                 struct sched_node *nodes, size_t n) {
+
+  // the flags are read after the block (ex: by a conditional jump) unless a
+  // later instruction of it writes them first
+  bool flags_live = true;
+  for (size_t i = n; i-- > 0;) {
+    struct sched_node *node = &nodes[i];
+    *node = (struct sched_node){0};
+    get_effects(&instrs[i], &node->effects);
+    node->flags_live = flags_live;
+    if (node->effects.reads_flags || node->effects.writes_flags)
+      flags_live = node->effects.reads_flags;
+    enum sched_class class = get_class(&instrs[i], &node->effects);
+    node->unit = CLASS_UNIT[class];
+    node->latency = model->latency[class];
+    // lea only computes an address, and a move to memory only stores
+    node->store = node->effects.writes_mem;
+    node->load = node->effects.reads_mem &&
+                 INSTR_TABLE[instrs[i].key].name != lea &&
+                 !(class == CLASS_MOVE && node->store);
+    if (node->load)
+      node->latency += model->load_latency;
+    // widening multiplies take a second micro-op for the upper half
+    node->uops = (node->unit != UNIT_NONE) + node->load + node->store +
+                 (class == CLASS_WIDE_MUL);
+    node->height = node->latency;
+    for (size_t k = i + 1; k < n; k++) {
+      if (!depends(node, &nodes[k]))
+        continue;
+      nodes[k].preds++;
+      unsigned int height =
+          edge_latency(model, node, &nodes[k]) + nodes[k].height;
+      if (height > node->height)
+        node->height = height;
+    }
+  }
+}
+
+/**
+ * returns the number of cycles of @param model that the @param n nodes
+ * @param nodes take when issued in the @param order given, each as soon as its
+ * operands are ready and a port is free but none before the previous one
+ */
+static unsigned int issue_cycles(const struct uarch_model *model,
+                                 const struct sched_node *nodes,
+                                 const size_t *order, size_t n) {
+
+  unsigned int issue[MAX_SCHEDULE_INSTRS];
+  unsigned int cycle = 0;
+  unsigned int end = 0;
+  struct cycle_use use = {0};
+  for (size_t p = 0; p < n; p++) {
+    const struct sched_node *node = &nodes[order[p]];
+    unsigned int ready = cycle;
+    for (size_t q = 0; q < p; q++) {
+      const struct sched_node *pred = &nodes[order[q]];
+      unsigned int at = issue[q] + edge_latency(model, pred, node);
+      if (order[q] < order[p] && depends(pred, node) && at > ready)
+        ready = at;
+    }
+    if (ready > cycle) {
+      cycle = ready;
+      use = (struct cycle_use){0};
+    }
+    while (!fits_cycle(model, &use, node)) {
+      cycle++;
+      use = (struct cycle_use){0};
+    }
+    take_cycle(&use, node);
+    issue[p] = cycle;
+    if (cycle + node->latency > end)
+      end = cycle + node->latency;
+  }
+  return end;
+}
+
+/**
+ * stores the order in which the @param n nodes @param nodes are list scheduled
+ * for @param model in @param order
+ */
+static void list_schedule(const struct uarch_model *model,
+                          struct sched_node *nodes, size_t *order, size_t n) {
+
+  unsigned int cycle = 0;
+  struct cycle_use use = {0};
+  for (size_t scheduled = 0; scheduled < n;) {
+    size_t best = n;
+    for (size_t i = 0; i < n; i++) {
+      const struct sched_node *node = &nodes[i];
+      if (node->done || node->preds > 0 || node->ready > cycle ||
+          !fits_cycle(model, &use, node))
+        continue;
+      if (best == n || node->height > nodes[best].height)
+        best = i;
+    }
+    if (best == n) {
+      cycle++;
+      use = (struct cycle_use){0};
+      continue;
+    }
+    struct sched_node *node = &nodes[best];
+    take_cycle(&use, node);
+    node->issue = cycle;
+    node->done = true;
+    order[scheduled++] = best;
+    // only later instructions depend on it
+    for (size_t k = best + 1; k < n; k++) {
+      if (nodes[k].done || !depends(node, &nodes[k]))
+        continue;
+      nodes[k].preds--;
+      unsigned int ready = cycle + edge_latency(model, node, &nodes[k]);
+      if (ready > nodes[k].ready)
+        nodes[k].ready = ready;
+    }
+  }
+}
+
+/**
+ * reorders the @param n instructions @param instrs of a block for
+ * @param model if the list scheduled order takes fewer cycles, using the
+ * memory @param nodes and @param tmp of as many elements
+ */
+static void schedule_block(const struct uarch_model *model,
+                           struct instr *instrs, size_t n,
+                           struct sched_node *nodes, struct instr *tmp) {
+
+  size_t order[MAX_SCHEDULE_INSTRS] = {0};
+  build_nodes(model, instrs, nodes, n);
+  // the parsed order
+  for (size_t i = 0; i < n; i++)
+    order[i] = i;
+  unsigned int cycles = issue_cycles(model, nodes, order, n);
+  list_schedule(model, nodes, order, n);
+  if (issue_cycles(model, nodes, order, n) >= cycles)
+    return;
+  for (size_t i = 0; i < n; i++)
+    tmp[i] = instrs[order[i]];
+  memcpy(instrs, tmp, n * sizeof(struct instr));
+}
+
+int schedule_program(assemblyline_t al, struct asm_program *program) {
+
+  const struct uarch_model *model = get_uarch_model(al->uarch);
+  struct sched_node *nodes =
+      calloc(MAX_SCHEDULE_INSTRS, sizeof(struct sched_node));
+  struct instr *tmp = calloc(MAX_SCHEDULE_INSTRS, sizeof(struct instr));
+  // without memory to schedule them, instructions stay in program order
+  if (nodes == NULL || tmp == NULL) {
+    free(nodes);
+    free(tmp);
+    return EXIT_SUCCESS;
+  }
+  size_t start = 0;
+  for (size_t i = 0; i <= program->len; i++) {
+    struct effects e;
+    // a block ends before an instruction with unknown effects or at its limit
+    bool end = i == program->len || !get_effects(&program->instrs[i], &e);
+    if (!end && i - start < MAX_SCHEDULE_INSTRS)
+      continue;
+    if (i - start > 1)
+      schedule_block(model, &program->instrs[start], i - start, nodes, tmp);
+    start = end ? i + 1 : i;
+  }
+  free(nodes);
+  free(tmp);
+  return EXIT_SUCCESS;
+}
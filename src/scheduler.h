@@ -0,0 +1,110 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines the latencies and ports of micro-architectures and the list
+ * scheduler reordering straight-line blocks of parsed programs by them*/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+#include "reorder.h"
+
+// classes of instructions by their latency and the ports they execute on
+enum sched_class {
+  // moves to or from memory only use a load or store port
+  CLASS_MOVE,
+  CLASS_ALU,
+  CLASS_IMUL,
+  // mul, one-operand imul and mulx write 2 registers
+  CLASS_WIDE_MUL,
+  CLASS_VEC,
+  CLASS_VEC_MUL,
+  CLASS_FP,
+  CLASS_DIV,
+  NUM_CLASSES
+};
+
+// groups of execution ports
+enum sched_unit {
+  UNIT_NONE,
+  UNIT_ALU,
+  UNIT_MUL,
+  UNIT_VEC,
+  UNIT_FMA,
+  UNIT_DIV,
+  NUM_UNITS
+};
+
+// instructions issued per cycle, ports per group and latencies in cycles of a
+// micro-architecture
+struct uarch_model {
+  uint8_t width;
+  uint8_t units[NUM_UNITS];
+  uint8_t load_ports;
+  uint8_t store_ports;
+  // added to the latency of instructions reading memory, and the latency of
+  // a load forwarded from an earlier store
+  uint8_t load_latency;
+  uint8_t latency[NUM_CLASSES];
+};
+
+// an instruction of the block being scheduled
+struct sched_node {
+  struct effects effects;
+  enum sched_unit unit;
+  unsigned int latency;
+  // longest path of latencies from the instruction to the end of the block
+  unsigned int height;
+  // earliest cycle its operands are ready and the cycle it is issued
+  unsigned int ready;
+  unsigned int issue;
+  // micro-ops it is split into
+  unsigned int uops;
+  // number of instructions it depends on that are not issued yet
+  size_t preds;
+  // the flags it writes may be read before they are written again
+  bool flags_live : 1;
+  bool load : 1;
+  bool store : 1;
+  bool done : 1;
+};
+
+/**
+ * returns the latencies and ports of the micro-architecture @param uarch, or
+ * NULL if it is not one of enum asm_uarch (or AL_UARCH_NONE)
+ */
+const struct uarch_model *get_uarch_model(unsigned int uarch);
+
+/**
+ * sets the effects, latencies, micro-ops, dependencies and longest paths of
+ * latencies to the end of the block of the @param n nodes @param nodes of the
+ * instructions @param instrs, all of which have known effects (see
+ * get_effects()), for @param model
+ */
+void build_nodes(const struct uarch_model *model, const struct instr *instrs,
+                 struct sched_node *nodes, size_t n);
+
+/**
+ * reorders the straight-line blocks of the parsed @param program (before its
+ * branches are resolved) for the micro-architecture of instance @param al (see
+ * asm_set_scheduling()). A block is only reordered if the new order issues in
+ * fewer cycles than the parsed one.
+ */
+int schedule_program(assemblyline_t al, struct asm_program *program);
+
+#endif
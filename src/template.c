@@ -0,0 +1,315 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*implements code templates: placeholders are assembled once with their widest
+ * encoding and instantiated by copying the code and patching fixed width
+ * fields*/
+#include "template.h"
+#include "assembler.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+// enough room for any encoding assemble_asm() produces
+#define MAX_ENCODING_LEN 32
+#define DWORD_BYTES 4
+
+/**
+ * returns the widest immediate (in bytes) the instruction @param instr_data
+ * can be encoded with
+ */
+static unsigned int imm_placeholder_width(const struct instr *instr_data) {
+
+  const struct operand *opd = &instr_data->opd[0];
+  unsigned int mode = opd->reg & MODE_MASK;
+  bool is_reg = opd->type == 'r';
+  // push is parsed as its 8 bit form (6a ib) but widened to 68 id by the value
+  if (NAME(instr_data->key, push))
+    return DWORD_BYTES;
+  // shifts, vector and byte operations only take 8 bit immediates
+  if (instr_data->keyword.is_byte || TYPE(instr_data->key, SHIFT) ||
+      encodes_ib(instr_data->key) ||
+      (is_reg && (mode <= noext8 || mode == mmx64)))
+    return 1;
+  if (instr_data->keyword.is_word ||
+      (is_reg && (mode == reg16 || mode == ext16)))
+    return 2;
+  // only mov has a 64 bit immediate
+  if (is_reg && (mode == reg64 || mode == ext64) &&
+      NAME(instr_data->key, mov))
+    return sizeof(uint64_t);
+  return DWORD_BYTES;
+}
+
+/**
+ * returns the @param width low bytes of @param value
+ */
+static uint64_t low_bytes(uint64_t value, unsigned int width) {
+  if (width >= sizeof(uint64_t))
+    return value;
+  return value & ((1UL << (width * BIT_8)) - 1);
+}
+
+int set_imm_placeholder(struct instr *instr_data) {
+
+  FAIL_IF_VAR(TYPE(instr_data->key, CONTROL_FLOW),
+              "placeholders are unsupported in branches: %s\n",
+              instr_data->instruction);
+  // every byte of the placeholder value is non zero, so none is dropped
+  instr_data->cons =
+      low_bytes(PLACEHOLDER_IMM, imm_placeholder_width(instr_data));
+  return EXIT_SUCCESS;
+}
+
+/**
+ * checks the @param width bytes at @param code hold the little endian
+ * @param value
+ */
+static bool matches(const uint8_t *code, uint64_t value, unsigned int width) {
+  for (unsigned int i = 0; i < width; i++)
+    if (code[i] != ((value >> (i * BIT_8)) & MAX_UNSIGNED_8BIT))
+      return false;
+  return true;
+}
+
+/**
+ * adds a patch point of @param width bytes at @param pos for the placeholder
+ * @param name of @param name_len characters to @param tmpl
+ */
+static int add_patch(struct asm_template *tmpl, size_t pos, unsigned int width,
+                     const char *name, uint8_t name_len) {
+
+  size_t index = 0;
+  while (index < tmpl->num_names &&
+         (strlen(tmpl->names[index]) != name_len ||
+          strncmp(tmpl->names[index], name, name_len)))
+    index++;
+  if (index == tmpl->num_names) {
+    FAIL_IF_MSG(tmpl->num_names > UINT16_MAX, "too many placeholders\n");
+    char **names =
+        realloc(tmpl->names, (tmpl->num_names + 1) * sizeof(char *));
+    FAIL_IF_MSG(names == NULL, "failed to allocate memory\n");
+    tmpl->names = names;
+    tmpl->names[index] = strndup(name, name_len);
+    FAIL_IF_MSG(tmpl->names[index] == NULL, "failed to allocate memory\n");
+    tmpl->num_names++;
+  }
+  struct patch_point *patches = realloc(
+      tmpl->patches, (tmpl->num_patches + 1) * sizeof(struct patch_point));
+  FAIL_IF_MSG(patches == NULL, "failed to allocate memory\n");
+  tmpl->patches = patches;
+  tmpl->patches[tmpl->num_patches++] =
+      (struct patch_point){.pos = pos, .width = width, .placeholder = index};
+  return EXIT_SUCCESS;
+}
+
+/**
+ * locates the placeholders of @param instr_data, whose encoding ends at
+ * @param end of the template code, and adds their patch points to @param tmpl
+ */
+static int add_patch_points(struct asm_template *tmpl,
+                            const struct instr *instr_data, size_t end) {
+
+  if (instr_data->imm_name == NULL && instr_data->disp_name == NULL)
+    return EXIT_SUCCESS;
+  uint8_t code[MAX_ENCODING_LEN];
+  unsigned int code_len = assemble_asm(instr_data, code);
+  size_t start = end - code_len;
+  // the immediate is always the last field of an instruction
+  unsigned int imm_len = 0;
+  if (instr_data->imm_name != NULL)
+    for (uint64_t cons = instr_data->cons; cons != 0; cons >>= BIT_8)
+      imm_len++;
+  if (instr_data->disp_name != NULL) {
+    // the displacement must be a single 32 bit field before the immediate
+    int disp_pos = NA;
+    for (unsigned int i = 0; i + DWORD_BYTES + imm_len <= code_len; i++) {
+      if (!matches(code + i, PLACEHOLDER_DISP, DWORD_BYTES))
+        continue;
+      FAIL_IF_VAR(disp_pos != NA,
+                  "unsupported displacement placeholder in: %s\n",
+                  instr_data->instruction);
+      disp_pos = i;
+    }
+    FAIL_IF_VAR(disp_pos == NA,
+                "unsupported displacement placeholder in: %s\n",
+                instr_data->instruction);
+    FAIL_IF(add_patch(tmpl, start + disp_pos, DWORD_BYTES,
+                      instr_data->disp_name, instr_data->disp_name_len));
+  }
+  if (instr_data->imm_name != NULL) {
+    FAIL_IF_VAR(imm_len > code_len ||
+                    instr_data->cons != low_bytes(PLACEHOLDER_IMM, imm_len) ||
+                    !matches(code + code_len - imm_len, instr_data->cons,
+                             imm_len),
+                "unsupported immediate placeholder in: %s\n",
+                instr_data->instruction);
+    FAIL_IF(add_patch(tmpl, end - imm_len, imm_len, instr_data->imm_name,
+                      instr_data->imm_name_len));
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * returns the length of the machine code of @param instr_data
+ */
+static unsigned int encoded_len(const struct instr *instr_data) {
+  uint8_t code[MAX_ENCODING_LEN];
+  return assemble_asm(instr_data, code);
+}
+
+/**
+ * moves the patch points @param first up to @param last of @param tmpl ahead
+ * by @param shift bytes (branch padding moves the instruction fused with a
+ * jump along with it)
+ */
+static void shift_patches(struct asm_template *tmpl, size_t first, size_t last,
+                          unsigned int shift) {
+  for (size_t i = first; i < last; i++)
+    tmpl->patches[i].pos += shift;
+}
+
+/**
+ * returns the boundary the padding of instance @param al lines up with, or 0 if
+ * it does not pad
+ */
+static unsigned int padding_boundary(assemblyline_t al) {
+
+  switch (al->assembly_mode) {
+  case CHUNK_FITTING:
+    return al->chunk_size;
+  case BRANCH_PADDING:
+    return BRANCH_BOUNDARY;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * assembles the parsed template @param program with the chunk size of
+ * @param al into @param tmpl, with its padding laid out for the offset of
+ * @param al
+ */
+static int emit_template(assemblyline_t al, const struct asm_program *program,
+                         struct asm_template *tmpl) {
+
+  assemblyline_t scratch = asm_create_instance(NULL, 0);
+  FAIL_IF(scratch == NULL);
+  scratch->assembly_mode =
+      al->assembly_mode == CHUNK_COUNT ? ASSEMBLE : al->assembly_mode;
+  scratch->chunk_size = al->chunk_size;
+  tmpl->boundary = padding_boundary(scratch);
+  tmpl->start = tmpl->boundary > 0 ? al->offset % tmpl->boundary : 0;
+  // the scratch code starts at the same position relative to a boundary
+  unsigned int buf_pos = tmpl->start;
+  // patch points of the previous instruction
+  size_t prev_patches = 0;
+  int ret = EXIT_SUCCESS;
+  for (size_t i = 0; i < program->len && ret == EXIT_SUCCESS; i++) {
+    const struct instr *instr_data = &program->instrs[i];
+    unsigned int start = buf_pos;
+    size_t patches = tmpl->num_patches;
+    ret = emit_instr(scratch, instr_data, &buf_pos, NULL);
+    if (ret == EXIT_SUCCESS && scratch->assembly_mode == BRANCH_PADDING &&
+        i > 0 && is_fused_pair(&program->instrs[i - 1], instr_data))
+      shift_patches(tmpl, prev_patches, patches,
+                    buf_pos - start - encoded_len(instr_data));
+    if (ret == EXIT_SUCCESS)
+      ret = add_patch_points(tmpl, instr_data, buf_pos - tmpl->start);
+    prev_patches = patches;
+  }
+  if (ret == EXIT_SUCCESS) {
+    tmpl->len = buf_pos - tmpl->start;
+    tmpl->code = malloc(tmpl->len + 1);
+    if (tmpl->code != NULL) {
+      memcpy(tmpl->code, scratch->buffer + tmpl->start, tmpl->len);
+    } else {
+      ret = EXIT_FAILURE;
+    }
+  }
+  asm_destroy_instance(scratch);
+  return ret;
+}
+
+int build_template(assemblyline_t al, const char *str, size_t len,
+                   struct asm_template *tmpl) {
+
+  struct asm_program program = {.placeholders = true};
+  int ret = parse_all(al, str, len, &program);
+  if (ret == EXIT_SUCCESS && program.num_branches > 0) {
+    fprintf(stderr, "assembyline: labels are unsupported in templates\n");
+    ret = EXIT_FAILURE;
+  }
+  // templates are instantiated at any offset, so they cannot be aligned
+  for (size_t i = 0; i < program.len && ret == EXIT_SUCCESS; i++) {
+    if (program.instrs[i].key != ALIGN)
+      continue;
+    fprintf(stderr, "assembyline: align is unsupported in templates\n");
+    ret = EXIT_FAILURE;
+  }
+  // placeholder names point into str, so resolve them before returning
+  if (ret == EXIT_SUCCESS)
+    ret = emit_template(al, &program, tmpl);
+  free_program(&program);
+  return ret;
+}
+
+int assemble_template(assemblyline_t al, const struct asm_template *tmpl,
+                      const uint64_t values[]) {
+
+  // reject values that do not fit their field before writing any code
+  for (size_t i = 0; i < tmpl->num_patches; i++) {
+    const struct patch_point *patch = &tmpl->patches[i];
+    uint64_t value = values[patch->placeholder];
+    unsigned int bits = patch->width * BIT_8;
+    if (patch->width >= sizeof(uint64_t) || value >> bits == 0 ||
+        value >> (bits - 1) == UINT64_MAX >> (bits - 1))
+      continue;
+    fprintf(stderr,
+            "assembyline: value of placeholder {%s} does not fit in %u "
+            "bytes\n",
+            tmpl->names[patch->placeholder], patch->width);
+    return ASM_ERROR;
+  }
+  unsigned int buf_pos = al->offset;
+  // the padding only lines up with the boundaries it was laid out for
+  if (tmpl->boundary > 0 && buf_pos % tmpl->boundary != tmpl->start) {
+    fprintf(stderr,
+            "assembyline: template padding does not line up with offset %u "
+            "(laid out for %u modulo %u)\n",
+            buf_pos, tmpl->start, tmpl->boundary);
+    return ASM_ERROR;
+  }
+  FAIL_IF_ERR(check_len_or_resize(al, buf_pos + tmpl->len));
+  uint8_t *code = al->buffer + buf_pos;
+  memcpy(code, tmpl->code, tmpl->len);
+  for (size_t i = 0; i < tmpl->num_patches; i++) {
+    const struct patch_point *patch = &tmpl->patches[i];
+    uint64_t value = values[patch->placeholder];
+    for (unsigned int j = 0; j < patch->width; j++)
+      code[patch->pos + j] = (value >> (j * BIT_8)) & MAX_UNSIGNED_8BIT;
+  }
+  return (int)(buf_pos + tmpl->len);
+}
+
+void free_template(struct asm_template *tmpl) {
+
+  for (size_t i = 0; i < tmpl->num_names; i++)
+    free(tmpl->names[i]);
+  free(tmpl->names);
+  free(tmpl->patches);
+  free(tmpl->code);
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*defines functions for assembling code templates with placeholders in
+ * immediates and displacements, and for instantiating them*/
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include "assemblyline.h"
+#include "common.h"
+#include "instruction_data.h"
+
+/**
+ * sets the immediate of @param instr_data, which holds a template placeholder,
+ * to the value that selects the widest immediate encoding of its instruction
+ * (so that patching never changes the instruction length)
+ */
+int set_imm_placeholder(struct instr *instr_data);
+
+/**
+ * assembles @param len characters of @param str containing template
+ * placeholders with the assembly options, chunk size and branch padding of
+ * @param al into @param tmpl, which must be zero-initialized. Records the byte
+ * offset and width of every placeholder.
+ */
+int build_template(assemblyline_t al, const char *str, size_t len,
+                   struct asm_template *tmpl);
+
+/**
+ * copies the code of @param tmpl into the buffer field of @param al at its
+ * offset and writes @param values (indexed by placeholder) to its patch
+ * points. Returns the new offset or ASM_ERROR.
+ */
+int assemble_template(assemblyline_t al, const struct asm_template *tmpl,
+                      const uint64_t values[]);
+
+/**
+ * frees the memory held by the fields of @param tmpl
+ */
+void free_template(struct asm_template *tmpl);
+
+#endif
@@ -14,28 +14,125 @@
  * limitations under the License.
  */
 
-/*implements functions for tokenizing a preprocessed assembly instruction
- * string*/
+/*implements a single pass tokenizer mapping an assembly line directly to its
+ * struct instr fields*/
 #include "tokenizer.h"
-#include "instr_parser.h"
+#include "lookup_hash.h"
 #include "reg_parser.h"
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+static inline char lower(char c) {
+  return IN_RANGE(c, 'A', 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+static inline bool is_alpha(char c) { return IN_RANGE(lower(c), 'a', 'z'); }
+
+static inline bool is_digit(char c) { return IN_RANGE(c, '0', '9'); }
+
+static inline bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline bool is_label_char(char c) {
+  return is_alpha(c) || is_digit(c) || c == '_' || c == '.';
+}
+
+static inline void skip_blank(const char **pos) {
+  while (is_blank(**pos))
+    (*pos)++;
+}
+
+/**
+ * returns the value of the (hex) digit @param c or NA
+ */
+static inline int digit_value(char c) {
+  c = lower(c);
+  if (is_digit(c))
+    return c - '0';
+  if (IN_RANGE(c, 'a', 'f'))
+    return c - 'a' + RADIX_10;
+  return NA;
+}
+
 /**
- * sets @param len number of characters to ' ' for @param str
+ * reads the identifier at @param pos, packing up to 8 lowercase characters
+ * into @param name. Returns the length of the identifier.
  */
-static void clearstring(char *str, int len) {
-  for (int i = 0; i < len; i++)
-    str[i] = ' ';
+static unsigned int scan_ident(const char **pos, uint64_t *name) {
+
+  const char *p = *pos;
+  unsigned int len = 0;
+  *name = 0;
+  while (is_alpha(*p) || is_digit(*p)) {
+    if (len < sizeof(*name))
+      *name |= (uint64_t)(uint8_t)lower(*p) << (len * BIT_8);
+    len++;
+    p++;
+  }
+  *pos = p;
+  return len;
+}
+
+/**
+ * reads the decimal or 0x prefixed hexadecimal number at @param pos into
+ * @param value. Like strtoul() the value saturates on overflow and is negated
+ * when @param neg is set. Sets @param hex when the number is hexadecimal.
+ * Returns the number of characters read or 0 if @param pos is not a number.
+ */
+static unsigned int scan_number(const char **pos, bool neg,
+                                unsigned long *value, bool *hex) {
+
+  const char *p = *pos;
+  unsigned long base = RADIX_10;
+  if (p[0] == '0' && lower(p[1]) == 'x' && digit_value(p[2]) != NA) {
+    base = RADIX_16;
+    p += 2;
+  }
+  const char *digits = p;
+  unsigned long num = 0;
+  bool overflow = false;
+  int digit = digit_value(*p);
+  while (digit != NA && (unsigned long)digit < base) {
+    if (num > (ULONG_MAX - digit) / base)
+      overflow = true;
+    num = num * base + digit;
+    digit = digit_value(*++p);
+  }
+  // a number must be followed by a delimiter ex: "10h" is rejected
+  if (p == digits || is_alpha(*p) || is_digit(*p))
+    return 0;
+  if (overflow)
+    *value = ULONG_MAX;
+  else
+    *value = neg ? -num : num;
+  *hex = base == RADIX_16;
+  unsigned int len = p - *pos;
+  *pos = p;
+  return len;
 }
 
 /**
- * Given an instance of @param instr_buffer and the sign of memory offset @param
- * neg, sets the 'm' displacement value for modRM32_64[m][r] table
+ * reads the template placeholder at @param pos (ex: "{ptr}") and stores its
+ * name in @param name and @param name_len
  */
-static void get_mod_disp(struct instr *instr_buffer, bool neg) {
+static int placeholder_tok(const char **pos, const char **name,
+                           uint8_t *name_len) {
+
+  const char *p = *pos + 1;
+  while (is_alpha(*p) || is_digit(*p) || *p == '_')
+    p++;
+  unsigned long len = p - (*pos + 1);
+  FAIL_IF(*p != '}' || len == 0 || len > MAX_PLACEHOLDER_LEN);
+  *name = *pos + 1;
+  *name_len = len;
+  *pos = p + 1;
+  return EXIT_SUCCESS;
+}
+
+void get_mod_disp(struct instr *instr_buffer, bool neg) {
   // set modRM_64[i][j] 'i' displacement value depending on the range of
   // memory_offset
   uint32_t memory_offset = instr_buffer->mem_offset;
@@ -55,182 +152,376 @@ static void get_mod_disp(struct instr *instr_buffer, bool neg) {
 }
 
 /**
- * Given an instance of @param instr_buffer convert a memory displacement string
- * representation @param mem into its equivalent unsigned long representation
+ * reads the branch target label at @param pos (ex: "loop_start") and stores
+ * its name in @param instr_buffer
  */
-static int mem_tok(struct instr *instr_buffer, char *mem, int opd_pos) {
+static int label_tok(struct instr *instr_buffer, const char **pos) {
 
-  instr_buffer->mem_disp = true;
+  const char *p = *pos;
+  while (is_label_char(*p))
+    p++;
+  unsigned long len = p - *pos;
+  FAIL_IF_MSG(len > MAX_LABEL_LEN, "label name too long\n");
+  instr_buffer->label_name = *pos;
+  instr_buffer->label_name_len = len;
+  // the displacement is known once the label is resolved (see labels.c)
+  instr_buffer->imm = true;
+  instr_buffer->cons = 0;
+  *pos = p;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * converts the packed register name @param name of @param len characters to
+ * its enum representation
+ */
+static asm_reg ident_to_reg(uint64_t name, unsigned int len) {
+  if (len >= MAX_REG_LEN)
+    return reg_error;
+  return packed_str_to_reg(name);
+}
+
+int set_scale(struct instr *instr_buffer, unsigned long scale) {
+
+  switch (scale) {
+  case 1:
+    instr_buffer->sib_disp = SIB;
+    break;
+  case 2:
+    instr_buffer->sib_disp = SIB2;
+    break;
+  case 4:
+    instr_buffer->sib_disp = SIB4;
+    break;
+  case 8:
+    instr_buffer->sib_disp = SIB8;
+    break;
+  default:
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Given an instance of @param instr_buffer reads the memory reference at
+ * @param pos (ex: "[rax+4*rbx+0x10]") for operand position @param opd_pos.
+ * A leading constant becomes the absolute address, the first unscaled register
+ * the base, a scaled or second register the index and a signed constant the
+ * displacement.
+ */
+static int mem_tok(struct instr *instr_buffer, const char **pos, int opd_pos) {
+
+  struct operand *opd = &instr_buffer->opd[opd_pos];
+  const char *p = *pos + 1;
+  bool has_disp = false;
   bool neg = false;
-  int base = 0;
-  // set index for memory operand
+  bool hex = false;
+  uint64_t name = 0;
+  unsigned long num = 0;
+  instr_buffer->mem_disp = true;
   instr_buffer->mem_index = opd_pos;
-  // find the index position of the memory displacement string
-  int index_add = find_add_mem(mem, &neg, &base);
-  int index_const = find_mem_const(mem, &neg, &base);
-  FAIL_IF_MSG(get_index_reg(instr_buffer, mem, instr_buffer->opd[opd_pos].sib),
-              "invalid memory syntax\n");
   instr_buffer->mem_offset = 0;
-  // convert string to unsigned long for memory displacement representation
-  if (index_add != NA) {
-    instr_buffer->mem_offset = strtoul(mem + index_add, NULL, base);
-    // if displacement is negative represent in 2's complement
-    if (neg)
-      instr_buffer->mem_offset = process_neg_disp(instr_buffer->mem_offset);
-  } else if (index_const != NA) {
-    instr_buffer->mem_value = true;
-    instr_buffer->mem_const = strtoul(mem + index_const, NULL, base);
-    // if displacement is negative represent in 2's complement
-    if (neg)
-      instr_buffer->mem_const = ~instr_buffer->mem_const + 1;
+  instr_buffer->sib_disp = SIB;
+  opd->type = 'm';
+  // '\0' denotes the first term when it is not signed
+  char sign = '\0';
+  skip_blank(&p);
+  if (*p == '+' || *p == '-')
+    sign = *p++;
+  bool first = true;
+  while (true) {
+    skip_blank(&p);
+    if (*p == '{') {
+      // template placeholder for a 32 bit displacement
+      FAIL_IF(sign != '+' || has_disp || instr_buffer->mem_value);
+      FAIL_IF(placeholder_tok(&p, &instr_buffer->disp_name,
+                              &instr_buffer->disp_name_len));
+      has_disp = true;
+      instr_buffer->mem_offset = PLACEHOLDER_DISP;
+    } else if (is_alpha(*p)) {
+      // register term: base, index or index*scale
+      unsigned int len = scan_ident(&p, &name);
+      asm_reg reg = ident_to_reg(name, len);
+      FAIL_IF(sign == '-');
+      skip_blank(&p);
+      if (*p == '*') {
+        p++;
+        skip_blank(&p);
+        FAIL_IF(!scan_number(&p, false, &num, &hex) ||
+                set_scale(instr_buffer, num));
+        FAIL_IF(opd->index != reg_none);
+        opd->index = reg;
+      } else if (opd->reg == reg_none && !instr_buffer->mem_value) {
+        opd->reg = reg;
+      } else {
+        FAIL_IF(opd->index != reg_none);
+        opd->index = reg;
+      }
+    } else {
+      // constant term: index scale, absolute address or displacement
+      FAIL_IF(!scan_number(&p, false, &num, &hex));
+      skip_blank(&p);
+      if (*p == '*') {
+        p++;
+        skip_blank(&p);
+        FAIL_IF(sign == '-' || !is_alpha(*p) || set_scale(instr_buffer, num));
+        unsigned int len = scan_ident(&p, &name);
+        FAIL_IF(opd->index != reg_none);
+        opd->index = ident_to_reg(name, len);
+      } else if (first && sign != '+') {
+        instr_buffer->mem_value = true;
+        instr_buffer->mem_const = num;
+        // if displacement is negative represent in 2's complement
+        if (sign == '-')
+          instr_buffer->mem_const = ~instr_buffer->mem_const + 1;
+      } else {
+        FAIL_IF(has_disp || instr_buffer->mem_value);
+        has_disp = true;
+        neg = sign == '-';
+        instr_buffer->mem_offset = num;
+        // if displacement is negative represent in 2's complement
+        if (neg)
+          instr_buffer->mem_offset = process_neg_disp(instr_buffer->mem_offset);
+      }
+    }
+    skip_blank(&p);
+    if (*p != '+' && *p != '-')
+      break;
+    sign = *p++;
+    first = false;
   }
+  FAIL_IF(*p != ']');
   get_mod_disp(instr_buffer, neg);
+  *pos = p + 1;
   return EXIT_SUCCESS;
 }
 
 /**
- * Given an instance of @param instr_buffer convert a immediate string
- * representation @param imme into its equivalent unsigned long representation
+ * Given an instance of @param instr_buffer reads the immediate at @param pos
+ * into its unsigned long representation. @param opd_len is the length of the
+ * operand so far (keywords included).
  */
-static void imm_tok(struct instr *instr_buffer, char *imme) {
+static int imm_tok(struct instr *instr_buffer, const char **pos,
+                   unsigned int opd_len) {
 
-  size_t imme_str_len = strlen(imme);
-  char *saved_saved = NULL;
-  instr_buffer->imm = true;
-  int base = RADIX_10;
-  imme = strtok_r(imme, " ", &saved_saved);
-  if (imme[1] == 'x' || imme[2] == 'x') {
-    base = RADIX_16;
-    if ((instr_buffer->assembly_opt & SMART_MOV_IMM) &&
-        imme_str_len < STR_HEX_64)
-      instr_buffer->assembly_opt |= NASM_MOV_IMM;
+  const char *p = *pos;
+  bool neg = false;
+  bool hex = false;
+  if (*p == '+' || *p == '-') {
+    neg = *p++ == '-';
+    opd_len++;
+    skip_blank(&p);
   }
-  // convert string to unsigned long for immediate representation
-  instr_buffer->cons = strtoul(imme, NULL, base);
+  unsigned int len = scan_number(&p, neg, &instr_buffer->cons, &hex);
+  FAIL_IF(len == 0);
+  instr_buffer->imm = true;
+  if (hex && (instr_buffer->assembly_opt & SMART_MOV_IMM) &&
+      opd_len + len < STR_HEX_64)
+    instr_buffer->assembly_opt |= NASM_MOV_IMM;
+  *pos = p;
+  return EXIT_SUCCESS;
 }
 
 /**
- * Given an instance of @param instr_buffer, checks for the presence of a
- * keyword (byte, short, or long) for @param opds at operand postion
- * @param opd_pos.
+ * Given an instance of @param instr_buffer, applies the keyword (byte, word,
+ * dword, qword, short, long or far) packed in @param name. Returns false if
+ * @param name is not a keyword.
  */
-static void check_for_keyword(struct instr *instr_buffer, char *all_opd,
-                              int opd_pos) {
-
-  char *pointer = all_opd;
-  while (*pointer == ' ')
-    pointer++;
+static bool check_for_keyword(struct instr *instr_buffer, uint64_t name) {
 
-  if (strstr(pointer, "byte") == pointer) {
+  switch (name) {
+  case PACK4('b', 'y', 't', 'e'):
     instr_buffer->keyword.is_byte = true;
-    clearstring(pointer, BYTE_LEN);
-    return;
-  }
-
-  if (strstr(pointer, "word") == pointer) {
+    return true;
+  case PACK4('w', 'o', 'r', 'd'):
     instr_buffer->keyword.is_word = true;
-    clearstring(pointer, BYTE_LEN);
-    return;
-  }
-
-  if (strstr(pointer, "dword") == pointer) {
+    return true;
+  case PACK5('d', 'w', 'o', 'r', 'd'):
     instr_buffer->keyword.is_dword = true;
-    clearstring(pointer, DWORD_LEN);
-    return;
-  }
-
-  if (strstr(pointer, "qword") == pointer) {
-    clearstring(pointer, DWORD_LEN);
-    return;
-  }
-
-  if (strstr(pointer, "short") == pointer) {
+    return true;
+  case PACK5('q', 'w', 'o', 'r', 'd'):
+    return true;
+  case PACK5('s', 'h', 'o', 'r', 't'):
     instr_buffer->keyword.is_short = true;
     instr_buffer->keyword.is_long = false;
-    clearstring(pointer, SHORT_LEN);
-    return;
-  }
-
-  if (strstr(pointer, "long") == pointer) {
+    return true;
+  case PACK4('l', 'o', 'n', 'g'):
     instr_buffer->keyword.is_long = true;
     instr_buffer->keyword.is_short = false;
-    clearstring(pointer, LONG_LEN);
-    return;
-  }
-
-  if (strstr(pointer, "far") == pointer) {
+    return true;
+  case PACK3('f', 'a', 'r'):
     instr_buffer->keyword.is_far = true;
-    clearstring(pointer, FAR_LEN);
-    // check for a possible next keyword in the case for `far qword` etc.
-    check_for_keyword(instr_buffer, pointer, opd_pos);
-    return;
+    return true;
+  default:
+    return false;
   }
 }
 
 /**
- * Given an instance of @param instr_buffer, checks the operand type of
- * @param opds at operand postion @param opd_pos to get the register if
- * operand is not an immediate.
+ * Given an instance of @param instr_buffer, reads the operand at @param pos
+ * (optionally preceded by keywords) into operand position @param opd_pos
  */
-static int check_operand_type(struct instr *instr_buffer, char *all_opd,
-                              int opd_pos, char *saved_opd) {
-
-  switch (instr_buffer->opd[opd_pos].type) {
-  // convert immediate to unsigned long
-  case 'i':
-    imm_tok(instr_buffer, all_opd);
-    if (strtok_r(NULL, "", &saved_opd) == NULL)
-      return EXIT_SUCCESS;
-    FAIL_IF_MSG(true, "cannot have an operand after immediate\n");
-    break;
-  // get register string from operand
-  case 'r':
-  case 'v':
-  case 'y':
-  case 'm':
-    // get register for memory and non memory operand
-    get_reg_str(all_opd, instr_buffer->opd[opd_pos].str);
-    if (instr_buffer->opd[opd_pos].type == 'm')
-      return mem_tok(instr_buffer, all_opd, opd_pos);
-    return EXIT_SUCCESS;
-  // operand type is not found
-  default:
+static int operand_tok(struct instr *instr_buffer, const char **pos,
+                       int opd_pos) {
+
+  struct operand *opd = &instr_buffer->opd[opd_pos];
+  const char *p = *pos;
+  const char *ident = p;
+  uint64_t name = 0;
+  unsigned int len = 0;
+  unsigned int opd_len = 0;
+  // keywords ex: "far qword [rax]"
+  while (is_alpha(*p)) {
+    ident = p;
+    len = scan_ident(&p, &name);
+    if (len >= MAX_REG_LEN || !check_for_keyword(instr_buffer, name))
+      break;
+    opd_len += len;
+    len = 0;
+    skip_blank(&p);
+  }
+  // identifiers that are not registers are labels ex: "jmp loop_start"
+  if ((len > 0 &&
+       (is_label_char(*p) || ident_to_reg(name, len) == reg_error)) ||
+      (len == 0 && (*p == '_' || *p == '.'))) {
+    // rescan the identifier with the characters allowed in labels
+    if (len > 0)
+      p = ident;
+    opd->type = 'i';
+    FAIL_IF(label_tok(instr_buffer, &p));
+  } else if (len > 0) {
+    // the operand type is noted by the first character of the register
+    char first = (char)(name & MAX_UNSIGNED_8BIT);
+    if (IN_RANGE(first, 'a', 's'))
+      opd->type = 'r';
+    else if (first == 'x')
+      opd->type = 'v';
+    else if (first == 'y')
+      opd->type = 'y';
+    else
+      FAIL_IF_VAR(true, "illegal operand : \"%s\"\n",
+                  instr_buffer->instruction);
+    opd->reg = ident_to_reg(name, len);
+  } else if (*p == '[') {
+    FAIL_IF_MSG(mem_tok(instr_buffer, &p, opd_pos), "invalid memory syntax\n");
+  } else if (*p == '{') {
+    // template placeholder, the width is decided once the instruction is known
+    opd->type = 'i';
+    FAIL_IF_MSG(placeholder_tok(&p, &instr_buffer->imm_name,
+                                &instr_buffer->imm_name_len),
+                "invalid placeholder\n");
+    instr_buffer->imm = true;
+    instr_buffer->cons = PLACEHOLDER_IMM;
+  } else if (is_digit(*p) || *p == '+' || *p == '-') {
+    opd->type = 'i';
+    FAIL_IF(imm_tok(instr_buffer, &p, opd_len));
+  } else {
     FAIL_IF_VAR(true, "illegal operand : \"%s\"\n", instr_buffer->instruction);
   }
+  *pos = p;
+  return EXIT_SUCCESS;
 }
 
 /**
- * Given an instance of @param instr_buffer, tokenize operand string @param
- * opds at operand postion @param opd_pos.
+ * Given an instance of @param instr_buffer reads the operands of the align
+ * directive at @param pos: a power of two alignment, optionally followed by the
+ * most bytes that may be skipped to reach it (ex: "16" or "16, 7")
  */
-static int operand_tok(struct instr *instr_buffer, char *opds, int opd_pos) {
-
-  char *saved_opd = NULL;
-  FAIL_IF(opds[0] == ',');
-  // get the 1st operand
-  char *all_opd = strtok_r(opds, ",", &saved_opd);
-  check_for_keyword(instr_buffer, all_opd, opd_pos);
-  // get the operand type can be 'i', 'r', or 'm'
-  instr_buffer->opd[opd_pos].type = get_operand_type(all_opd);
-  FAIL_IF(check_operand_type(instr_buffer, all_opd, opd_pos, saved_opd));
-  // get next operand
-  char *next_operands = strtok_r(NULL, "", &saved_opd);
-  if (next_operands == NULL)
-    return EXIT_SUCCESS;
-  // recursively call operand_tok to process next operand
-  if (opd_pos <= FOURTH_OPERAND)
-    return operand_tok(instr_buffer, next_operands, opd_pos + 1);
-  return EXIT_FAILURE;
+static int align_tok(struct instr *instr_buffer, const char **pos) {
+
+  const char *p = *pos;
+  unsigned long align = 0;
+  unsigned long max = 0;
+  bool hex = false;
+  FAIL_IF_MSG(scan_number(&p, false, &align, &hex) == 0 || align == 0 ||
+                  align > MAX_ALIGN || (align & (align - 1)) != 0,
+              "align expects a power of two up to 4096\n");
+  max = align - 1;
+  skip_blank(&p);
+  if (*p == ',') {
+    p++;
+    skip_blank(&p);
+    FAIL_IF_MSG(scan_number(&p, false, &max, &hex) == 0,
+                "align expects the most bytes to skip after ','\n");
+    skip_blank(&p);
+  }
+  FAIL_IF(!is_stmt_end(*p));
+  instr_buffer->key = ALIGN;
+  instr_buffer->align = align;
+  instr_buffer->align_max = max < align ? max : align - 1;
+  *pos = p;
+  return EXIT_SUCCESS;
 }
 
-int instr_tok(struct instr *instr_buffer, char *comp_instr) {
+int instr_tok(struct instr *instr_buffer, const char *line, int *stmt_len) {
 
-  char *saved_instr = NULL;
-  // get the string component containing the instruction
-  char *instruction_str = strtok_r(comp_instr, " \t", &saved_instr);
-  strncpy(instr_buffer->instruction, instruction_str, MAX_INSTR_LEN);
-  char *next_operands = strtok_r(NULL, "", &saved_instr);
-  if (next_operands != NULL)
-    return operand_tok(instr_buffer, next_operands, FIRST_OPERAND);
+  const char *p = line;
+  for (int i = 0; i < NUM_OF_OPD; i++) {
+    instr_buffer->opd[i].reg = reg_none;
+    instr_buffer->opd[i].index = reg_none;
+  }
+  skip_blank(&p);
+  // directives may be written in their primitive form ex: "[section .text]"
+  bool bracket = *p == '[';
+  if (bracket)
+    p++;
+  // copy the lowercase instruction name (longer names are unsupported anyway)
+  const char *name_start = p;
+  unsigned int len = 0;
+  while (*p > ' ' && *p <= '~' && *p != ',' && *p != ':' && *p != '[' &&
+         !is_stmt_end(*p)) {
+    if (len < MAX_INSTR_LEN)
+      instr_buffer->instruction[len] = lower(*p);
+    len++;
+    p++;
+  }
+  instr_buffer->instruction[len < MAX_INSTR_LEN ? len : MAX_INSTR_LEN] = '\0';
+  const char *name_end = p;
+  skip_blank(&p);
+  bool label = len > 0 && !bracket && *p == ':';
+  // blank lines, labels and section/global directives are skipped (labels are
+  // kept as LABEL to be resolved if they are branched to)
+  if ((len == 0 && !bracket) || *p == ':' ||
+      !strcmp(instr_buffer->instruction, "section") ||
+      !strcmp(instr_buffer->instruction, "global")) {
+    FAIL_IF(len == 0 && !is_stmt_end(*p));
+    instr_buffer->key = SKIP;
+    if (label) {
+      FAIL_IF_MSG(len > MAX_LABEL_LEN, "label name too long\n");
+      instr_buffer->key = LABEL;
+      instr_buffer->label_name = name_start;
+      instr_buffer->label_name_len = len;
+      // an instruction on the same line is a statement of its own
+      p++;
+      skip_blank(&p);
+    }
+    while (!label && !is_stmt_end(*p))
+      p++;
+    *stmt_len = p - line;
+    return EXIT_SUCCESS;
+  }
+  FAIL_IF(bracket || len == 0);
+  // the instruction name is separated from the operands by blanks
+  FAIL_IF(p == name_end && !is_stmt_end(*p));
+  if (!strcmp(instr_buffer->instruction, "align")) {
+    FAIL_IF(align_tok(instr_buffer, &p));
+    *stmt_len = p - line;
+    return EXIT_SUCCESS;
+  }
+  // operands are separated by ','
+  for (int opd_pos = FIRST_OPERAND; !is_stmt_end(*p); opd_pos++) {
+    FAIL_IF_MSG(opd_pos >= NUM_OF_OPD, "too many operands\n");
+    FAIL_IF(operand_tok(instr_buffer, &p, opd_pos));
+    skip_blank(&p);
+    if (*p != ',')
+      break;
+    FAIL_IF_MSG(instr_buffer->opd[opd_pos].type == 'i',
+                "cannot have an operand after immediate\n");
+    p++;
+    skip_blank(&p);
+    FAIL_IF(is_stmt_end(*p));
+  }
+  FAIL_IF(!is_stmt_end(*p));
+  *stmt_len = p - line;
   return EXIT_SUCCESS;
 }
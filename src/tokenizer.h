@@ -23,9 +23,33 @@
 #include "instruction_data.h"
 
 /**
- * Given an instance of @param instr_buffer, tokenize @param comp_instr string
- * and maps instruction componenets to buffer fields within @param instr_buffer
+ * a statement ends at a comment, a macro, the end of the line or string
  */
-int instr_tok(struct instr *instr_buffer, char *comp_instr);
+static inline bool is_stmt_end(char c) {
+  return c == ';' || c == '%' || c == '\r' || c == '\n' || c == '\0';
+}
+
+/**
+ * Given an instance of @param instr_buffer, tokenizes the assembly line
+ * @param line in a single forward pass and maps the instruction name, operand
+ * types, registers, scale, displacement and immediate directly to the fields
+ * of @param instr_buffer. Blank lines and section/global directives set
+ * instr_buffer->key to SKIP, labels set it to LABEL and align directives to
+ * ALIGN. The length of the statement (up to its comment or end of line, or
+ * up to the instruction following a label) is stored in @param stmt_len. No
+ * character past the first statement end character of @param line is read.
+ */
+int instr_tok(struct instr *instr_buffer, const char *line, int *stmt_len);
+
+/**
+ * Given an instance of @param instr_buffer and the sign of memory offset @param
+ * neg, sets the 'm' displacement value for modRM32_64[m][r] table
+ */
+void get_mod_disp(struct instr *instr_buffer, bool neg);
+
+/**
+ * sets the sib scale of @param instr_buffer from @param scale
+ */
+int set_scale(struct instr *instr_buffer, unsigned long scale);
 
 #endif
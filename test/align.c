@@ -0,0 +1,217 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles align directives and compares them against the same code with
+ * explicit padding*/
+#include <assemblyline.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 8192
+#define INT3 0xcc
+#define LOOP_RESULT (5 * 0x1234)
+#define NUM_OF_LINES 20000
+
+struct test_struct {
+  const char *prog;
+  size_t chunk_size;
+  const char *expected;
+};
+
+/**
+ * assembles @param t and its expected code without chunk size and checks both
+ * produce the same machine code
+ */
+static int compare(const struct test_struct *t) {
+
+  static uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, t->expected))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  asm_set_chunk_size(al, t->chunk_size);
+  if (asm_assemble_str(al, t->prog) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' (chunk size %zu) does not assemble like '%s'\n",
+            t->prog, t->chunk_size, t->expected);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * checks that @param prog is padded from @param start to @param end with a
+ * jump over int3 of @param jmp_len bytes
+ */
+static int check_jump_over(const char *prog, int start, int end,
+                           int jmp_len) {
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, prog) || asm_get_offset(al) <= end)
+    goto done;
+  const uint8_t *code = asm_get_code(al);
+  uint32_t disp = 0;
+  for (int i = jmp_len - 1; i > 0; i--)
+    disp = disp << 8 | code[start + i];
+  if (code[start] != (jmp_len == 2 ? 0xeb : 0xe9) ||
+      disp != (uint32_t)(end - start - jmp_len))
+    goto done;
+  for (int i = start + jmp_len; i < end; i++)
+    if (code[i] != INT3)
+      goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' is not padded with a jump\n", prog);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * runs a loop over an aligned label with chunk size @param chunk_size
+ */
+static int run_loop(size_t chunk_size) {
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(al, chunk_size);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, "mov ecx, 5\n"
+                           "xor eax, eax\n"
+                           "align 64\n"
+                           "top:\n"
+                           "add eax, 0x1234\n"
+                           "dec ecx\n"
+                           "jne top\n"
+                           "ret\n") == EXIT_SUCCESS) {
+    long (*func)() = asm_get_code(al);
+    result = func() == LOOP_RESULT ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (result)
+    fprintf(stderr, "aligned loop fails (chunk size %zu)\n", chunk_size);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * assembles a large program with an align directive in its middle with a
+ * single and with several threads and checks both produce the same code
+ */
+static int compare_parallel(void) {
+
+  char *prog = malloc(NUM_OF_LINES * sizeof("add rax, 1\n") + MAX_CODE_LEN);
+  if (prog == NULL)
+    return EXIT_FAILURE;
+  char *end = prog;
+  for (int i = 0; i < NUM_OF_LINES; i++) {
+    end = stpcpy(end, "add rax, 1\n");
+    if (i == NUM_OF_LINES / 2)
+      end = stpcpy(end, "inc rax\nalign 16\n");
+  }
+  assemblyline_t serial = asm_create_instance(NULL, 0);
+  assemblyline_t parallel = asm_create_instance(NULL, 0);
+  asm_set_threads(parallel, 4);
+  int result = EXIT_FAILURE;
+  if (!asm_assemble_str(serial, prog) && !asm_assemble_str(parallel, prog) &&
+      asm_get_offset(serial) == asm_get_offset(parallel) &&
+      !memcmp(asm_get_code(serial), asm_get_code(parallel),
+              asm_get_offset(serial)))
+    result = EXIT_SUCCESS;
+  else
+    fprintf(stderr, "align differs with several threads\n");
+  asm_destroy_instance(serial);
+  asm_destroy_instance(parallel);
+  free(prog);
+  return result;
+}
+
+/**
+ * checks that @param al fails to assemble @param prog from the start of its
+ * buffer
+ */
+static bool rejects(assemblyline_t al, const char *prog) {
+  asm_set_offset(al, 0);
+  return asm_assemble_str(al, prog) == EXIT_FAILURE;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // gaps are filled with the fewest nops
+      {"inc rax\nalign 4\nret", 0, "inc rax\nnop\nret"},
+      {"inc rax\nalign 16\nret", 0, "inc rax\nnop11\nnop2\nret"},
+      {"inc rax\nalign 32\nret", 0, "inc rax\nnop11\nnop11\nnop7\nret"},
+      {"nop2\nalign 0x20\nret", 0, "nop2\nnop11\nnop11\nnop8\nret"},
+      // aligned code and gaps beyond the maximum are not padded
+      {"align 16\nret", 0, "ret"},
+      {"nop8\nnop8\nalign 16\nret", 0, "nop8\nnop8\nret"},
+      {"inc rax\nalign 16, 12\nret", 0, "inc rax\nret"},
+      {"inc rax\nalign 16, 13\nret", 0, "inc rax\nnop11\nnop2\nret"},
+      {"inc rax ; first\n  align 8 ; comment\nret", 0, "inc rax\nnop5\nret"},
+      // with chunk fitting, the nops fit the chunks
+      {"inc rax\nalign 16\nret", 5, "inc rax\nnop2\nnop5\nnop5\nnop\nret"},
+      {"inc rax\nalign 32\nret", 16, "inc rax\nnop11\nnop2\nnop11\nnop5\nret"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+
+  // longer gaps are jumped over
+  result |= check_jump_over("inc rax\nalign 64\nret", 3, 64, 2);
+  result |= check_jump_over("inc rax\nalign 4096\nret", 3, 4096, 5);
+  size_t chunk_sizes[] = {0, 5, 16};
+  for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++)
+    result |= run_loop(chunk_sizes[i]);
+  result |= compare_parallel();
+
+  // a parsed program is aligned at the offset it is assembled at
+  uint8_t code[MAX_CODE_LEN];
+  const char *prog = "inc rax\nalign 16\nret";
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_program_t program = asm_parse_str(al, prog);
+  asm_set_offset(al, 1);
+  int failed = program == NULL || asm_assemble_program(al, program);
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 1);
+  if (failed || asm_assemble_str(al, prog) || asm_get_offset(al) != 16 + 1 ||
+      code_len != 16 + 1 || memcmp(code, asm_get_code(al), code_len)) {
+    fprintf(stderr, "parsed program is not aligned at its offset\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_program(program);
+
+  // invalid align directives fail
+  if (!rejects(al, "align") || !rejects(al, "align 0") ||
+      !rejects(al, "align 24") || !rejects(al, "align 8192") ||
+      !rejects(al, "align 16,") || !rejects(al, "align 16, x") ||
+      !rejects(al, "align 16 8") || !rejects(al, "align16") ||
+      asm_create_template(al, "align 16\nmov rax, {v}") != NULL) {
+    fprintf(stderr, "invalid align directives should have been rejected\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
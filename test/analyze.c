@@ -0,0 +1,96 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*estimates the cost of programs and compares it against the cost worked out
+ * by hand*/
+#include <assemblyline.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct test_struct {
+  const char *prog;
+  enum asm_uarch uarch;
+  size_t instrs;
+  size_t uops;
+  double rthroughput;
+  unsigned int latency;
+  // pressure on the ALU, multiplication, load and store ports
+  double alu;
+  double mul;
+  double load;
+  double store;
+};
+
+/**
+ * analyzes @param t for its micro-architecture and checks the estimates
+ */
+static int compare(const struct test_struct *t) {
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_program_t program = asm_parse_str(al, t->prog);
+  struct asm_analysis a;
+  int result = EXIT_FAILURE;
+  if (program == NULL || asm_analyze_program(program, t->uarch, &a) ||
+      a.instrs != t->instrs || a.uops != t->uops ||
+      a.rthroughput != t->rthroughput || a.latency != t->latency ||
+      a.pressure[AL_PORT_ALU] != t->alu || a.pressure[AL_PORT_MUL] != t->mul ||
+      a.pressure[AL_PORT_LOAD] != t->load ||
+      a.pressure[AL_PORT_STORE] != t->store)
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' is not analyzed as expected\n", t->prog);
+  asm_destroy_program(program);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // independent multiplications are bound by the single multiplier
+      {"imul rax, rbx, 3\nimul rcx, rdx, 5\nret", AL_UARCH_SKYLAKE, 3, 3, 2,
+       4, 0.25, 2, 0, 0},
+      // a load, an addition and a store in a chain
+      {"mov rax, [rdi]\nadd rax, 1\nmov [rsi], rax\nret", AL_UARCH_SKYLAKE, 4,
+       4, 1, 7, 0.5, 0, 0.5, 1},
+      {"mov rax, [rdi]\nadd rax, 1\nmov [rsi], rax\nret", AL_UARCH_ZEN3, 4, 4,
+       4.0 / 6, 6, 0.5, 0, 1.0 / 3, 0.5},
+      // mul takes 2 micro-ops, and labels none
+      {"top:\nmul rbx\nadd rax, rdx\nret", AL_UARCH_SKYLAKE, 3, 4, 2, 6, 0.5,
+       2, 0, 0},
+      // and so does one-operand imul, which also writes rdx
+      {"imul rbx\nadd rax, rdx\nret", AL_UARCH_SKYLAKE, 3, 4, 2, 6, 0.5, 2, 0,
+       0},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+
+  // there is no cost without a micro-architecture
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_program_t program = asm_parse_str(al, "ret");
+  struct asm_analysis a;
+  if (program == NULL ||
+      asm_analyze_program(program, AL_UARCH_NONE, &a) != EXIT_FAILURE) {
+    fprintf(stderr, "analysis without a micro-architecture did not fail\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_program(program);
+  asm_destroy_instance(al);
+  return result;
+}
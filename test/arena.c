@@ -0,0 +1,141 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*commits functions into arenas, runs them and checks the occupancy of the
+ * arenas as they are freed*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_FUNCS 2000
+#define NUM_NOPS 5000
+#define SLAB_LEN 0x10000
+
+/**
+ * assembles @param str with instance @param al from its start and commits it
+ * into @param arena
+ */
+static asm_func_t commit(asm_arena_t arena, assemblyline_t al,
+                         const char *str) {
+
+  asm_set_offset(al, 0);
+  if (asm_assemble_str(al, str))
+    return NULL;
+  return asm_arena_commit(arena, al);
+}
+
+/**
+ * runs the function @param func, which returns an int
+ */
+static int run(asm_func_t func) {
+  return ((int (*)(void))asm_func_get_code(func))();
+}
+
+/**
+ * commits functions of every size class into an arena (mapped twice if
+ * @param dual is set), runs them and frees them again
+ */
+static int test_arena(bool dual) {
+
+  asm_arena_t arena = asm_create_arena(dual);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_func_t funcs[NUM_FUNCS];
+  // small functions share a slab in cache line aligned blocks, and branches
+  // within them work wherever they are put
+  funcs[0] = commit(arena, al, "mov rax, 1\nret");
+  funcs[1] = commit(arena, al,
+                    "xor eax, eax\nmov rcx, 10\ntop:\nadd rax, 2\ndec rcx\n"
+                    "jne top\nret");
+  funcs[2] = commit(arena, al, "mov rax, 3\nret");
+  if (funcs[0] == NULL || funcs[1] == NULL || funcs[2] == NULL ||
+      run(funcs[0]) != 1 || run(funcs[1]) != 20 || run(funcs[2]) != 3) {
+    fprintf(stderr, "failed to run committed functions\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < 3; i++) {
+    if ((uintptr_t)asm_func_get_code(funcs[i]) % 64 != 0) {
+      fprintf(stderr, "committed function is not aligned\n");
+      return EXIT_FAILURE;
+    }
+  }
+  struct asm_arena_stats stats = asm_arena_get_stats(arena);
+  if (stats.funcs != 3 || stats.slabs != 1 || stats.bytes_allocated != 192 ||
+      stats.bytes_mapped != SLAB_LEN ||
+      stats.occupancy != 192.0 / SLAB_LEN ||
+      stats.fragmentation != 1 - (double)stats.bytes_used / 192) {
+    fprintf(stderr, "unexpected statistics of small functions\n");
+    return EXIT_FAILURE;
+  }
+  // freed blocks are reused, and freeing twice fails
+  void *code = asm_func_get_code(funcs[1]);
+  if (asm_arena_free(arena, funcs[1]) ||
+      !asm_arena_free(arena, funcs[1])) {
+    fprintf(stderr, "failed to free function\n");
+    return EXIT_FAILURE;
+  }
+  funcs[1] = commit(arena, al, "mov rax, 2\nret");
+  if (funcs[1] == NULL || asm_func_get_code(funcs[1]) != code ||
+      run(funcs[1]) != 2) {
+    fprintf(stderr, "freed block is not reused\n");
+    return EXIT_FAILURE;
+  }
+  // large functions get pages of their own
+  char *large = malloc(NUM_NOPS * 4 + 16);
+  char *end = large;
+  for (int i = 0; i < NUM_NOPS; i++)
+    end = stpcpy(end, "nop\n");
+  strcpy(end, "mov rax, 4\nret");
+  funcs[3] = commit(arena, al, large);
+  free(large);
+  if (funcs[3] == NULL || run(funcs[3]) != 4 ||
+      asm_arena_get_stats(arena).slabs != 2 ||
+      asm_arena_free(arena, funcs[3]) ||
+      asm_arena_get_stats(arena).slabs != 1) {
+    fprintf(stderr, "failed to run large function\n");
+    return EXIT_FAILURE;
+  }
+  // slabs are added as needed and unmapped once empty (except the last one)
+  for (int i = 3; i < NUM_FUNCS; i++)
+    funcs[i] = commit(arena, al, "mov rax, 5\nret");
+  stats = asm_arena_get_stats(arena);
+  if (stats.funcs != NUM_FUNCS || stats.slabs != 2 || run(funcs[1500]) != 5) {
+    fprintf(stderr, "unexpected statistics of many functions\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < NUM_FUNCS; i++)
+    asm_arena_free(arena, funcs[i]);
+  stats = asm_arena_get_stats(arena);
+  if (stats.funcs != 0 || stats.bytes_used != 0 || stats.slabs != 1) {
+    fprintf(stderr, "unexpected statistics of empty arena\n");
+    return EXIT_FAILURE;
+  }
+  // there is nothing to commit from an empty instance
+  asm_set_offset(al, 0);
+  if (asm_arena_commit(arena, al) != NULL) {
+    fprintf(stderr, "committed an empty function\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return asm_destroy_arena(arena);
+}
+
+int main() {
+  if (test_arena(false) || test_arena(true))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles length bounded buffers that are not null-terminated*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MAX_CODE_LEN 64
+
+struct test_struct {
+  const char *buf;
+  size_t len;
+  const char *expected;
+};
+
+/**
+ * assembles @param buf of @param len characters and the null-terminated
+ * @param expected and checks both produce the same machine code
+ */
+static int compare(const char *buf, size_t len, const char *expected) {
+
+  uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_SUCCESS;
+  if (asm_assemble_str(al, expected)) {
+    fprintf(stderr, "failed to assemble '%s'\n", expected);
+    result = EXIT_FAILURE;
+    goto done;
+  }
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  if (asm_assemble_buf(al, buf, len) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len)) {
+    fprintf(stderr, "'%.*s' does not assemble like '%s'\n", (int)len, buf,
+            expected);
+    result = EXIT_FAILURE;
+  }
+done:
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  const char *prog = "mov rax, [rsi+0x10]\n"
+                     "add rax, rbx\n"
+                     "lea rcx, [rax+8*rdx-0x20]\n"
+                     "ret";
+  struct test_struct tests[] = {
+      // the bound cuts off the following lines
+      {"inc rax\ninc rbx", 7, "inc rax"},
+      {"ret ; comment", 5, "ret"},
+      // the bound cuts off the last statement
+      {"mov eax, 0x12345678", 12, "mov eax, 0x1"},
+      // assembly stops at the first null character
+      {"inc rax\0inc rbx", 15, "inc rax"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(tests[i].buf, tests[i].len, tests[i].expected);
+
+  // place the program right before an inaccessible page so that reading past
+  // its end faults
+  size_t page = sysconf(_SC_PAGESIZE);
+  uint8_t *mem = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED || mprotect(mem + page, page, PROT_NONE))
+    return EXIT_FAILURE;
+  size_t len = strlen(prog);
+  char *buf = (char *)mem + page - len;
+  memcpy(buf, prog, len);
+  result |= compare(buf, len, prog);
+
+  // the counting chunks variant counts like its string counterpart
+  int counted = -1;
+  int expected = -1;
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int failed = asm_assemble_buf_counting_chunks(al, buf, len, 4, &counted);
+  asm_set_offset(al, 0);
+  failed |= asm_assemble_string_counting_chunks(al, (char *)prog, 4, &expected);
+  if (failed || counted != expected) {
+    fprintf(stderr, "counted %d instead of %d chunk breaks\n", counted,
+            expected);
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  munmap(mem, 2 * page);
+  return result;
+}
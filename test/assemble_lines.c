@@ -0,0 +1,118 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles arrays of lines and compares them against assembling the joined
+ * string*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 512
+#define NUM_OF_LINES 10000
+#define EXTERNAL_LEN 64
+
+const char *lines[] = {"mov rax, [rsi+0x10]", "add rax, rbx ; comment",
+                       "lea rcx, [rax+8*rdx-0x20]\n", "shl r9, 7",
+                       "vpaddq ymm0, ymm1, [rax]", "ret"};
+const char *joined = "mov rax, [rsi+0x10]\n"
+                     "add rax, rbx ; comment\n"
+                     "lea rcx, [rax+8*rdx-0x20]\n"
+                     "shl r9, 7\n"
+                     "vpaddq ymm0, ymm1, [rax]\n"
+                     "ret\n";
+
+/**
+ * assembles @param lines with chunk size @param chunk_size (with and without
+ * lengths) and checks the machine code is identical to assembling @param joined
+ */
+static int compare(size_t chunk_size) {
+
+  const size_t n = sizeof(lines) / sizeof(lines[0]);
+  size_t lens[sizeof(lines) / sizeof(lines[0])];
+  for (size_t i = 0; i < n; i++)
+    lens[i] = strlen(lines[i]);
+  uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(al, chunk_size);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, joined))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  if (asm_assemble_lines(al, lines, lens, n, NULL) ||
+      asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  asm_set_offset(al, 0);
+  if (asm_assemble_lines(al, lines, NULL, n, NULL) ||
+      asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "assembled lines differ (chunk size %zu)\n", chunk_size);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  int result = EXIT_SUCCESS;
+  size_t chunk_sizes[] = {0, 5, 16};
+  for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++)
+    result |= compare(chunk_sizes[i]);
+
+  // the index of the failing line is reported
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  const char *invalid[] = {"inc rax", "dec rbx", "invalid rax, 1", "ret"};
+  size_t failed_line = 0;
+  if (asm_assemble_lines(al, invalid, NULL, 4, &failed_line) !=
+          EXIT_FAILURE ||
+      failed_line != 2) {
+    fprintf(stderr, "line %zu reported as failed instead of 2\n",
+            failed_line);
+    result = EXIT_FAILURE;
+  }
+  // the internal buffer grows to hold many lines at once
+  const char **many = malloc(NUM_OF_LINES * sizeof(char *));
+  if (many == NULL)
+    return EXIT_FAILURE;
+  for (size_t i = 0; i < NUM_OF_LINES; i++)
+    many[i] = "mov rax, 0x1234567890";
+  asm_set_offset(al, 0);
+  if (asm_assemble_lines(al, many, NULL, NUM_OF_LINES, NULL) ||
+      asm_get_offset(al) != NUM_OF_LINES * 10) {
+    fprintf(stderr, "failed to assemble %d lines\n", NUM_OF_LINES);
+    result = EXIT_FAILURE;
+  }
+  free(many);
+  asm_destroy_instance(al);
+
+  // an external buffer only needs to hold the actual machine code
+  uint8_t buffer[EXTERNAL_LEN];
+  al = asm_create_instance(buffer, EXTERNAL_LEN);
+  const char *nops[] = {"nop", "nop", "nop", "nop", "nop", "nop", "ret"};
+  if (asm_assemble_lines(al, nops, NULL, 7, NULL) || asm_get_offset(al) != 7) {
+    fprintf(stderr, "failed to assemble into an external buffer\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
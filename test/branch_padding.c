@@ -0,0 +1,182 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles jumps near a 32 byte boundary with branch padding and compares
+ * them against the same code with explicit nops*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 512
+#define MAX_PROG_LEN 1024
+#define BOUNDARY 32
+#define LOOP_RESULT (5 * 0x1234)
+
+struct test_struct {
+  // number of bytes of nops in front of prog and expected
+  int offset;
+  const char *prog;
+  const char *expected;
+};
+
+/**
+ * writes @param n bytes of nops followed by @param code to @param prog
+ */
+static void after_nops(char *prog, int n, const char *code) {
+  prog[0] = '\0';
+  for (int i = 0; i < n; i++)
+    strcat(prog, "nop\n");
+  strcat(prog, code);
+}
+
+/**
+ * assembles @param t with branch padding and its expected code without and
+ * checks both produce the same machine code
+ */
+static int compare(const struct test_struct *t) {
+
+  char prog[MAX_PROG_LEN];
+  uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  after_nops(prog, t->offset, t->expected);
+  if (asm_assemble_str(al, prog))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  asm_set_branch_padding(al, true);
+  after_nops(prog, t->offset, t->prog);
+  if (asm_assemble_str(al, prog) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' at offset %d does not assemble like '%s'\n",
+            t->prog, t->offset, t->expected);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * runs a loop over a branch to a label starting @param offset bytes into a
+ * 32 byte block
+ */
+static int run_loop(int offset) {
+
+  char prog[MAX_PROG_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_branch_padding(al, true);
+  after_nops(prog, offset,
+             "mov ecx, 5\nxor eax, eax\ntop:\nadd eax, 0x1234\n"
+             "dec ecx\njne top\nret\n");
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, prog) == EXIT_SUCCESS) {
+    long (*func)() = asm_get_code(al);
+    result = func() == LOOP_RESULT ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (result)
+    fprintf(stderr, "padded loop fails at offset %d\n", offset);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // jumps that would cross or end on the boundary start at it
+      {30, "jmp short 0x10", "nop2\njmp short 0x10"},
+      {31, "jmp short 0x10", "nop\njmp short 0x10"},
+      {28, "je 0x100", "nop4\nje 0x100"},
+      {30, "call rax", "nop2\ncall rax"},
+      {31, "ret", "nop\nret"},
+      // jumps that fit are not padded
+      {29, "jmp short 0x10", "jmp short 0x10"},
+      {25, "je 0x100", "je 0x100"},
+      {30, "ret", "ret"},
+      // other instructions are never padded
+      {30, "add rax, 1\nret", "add rax, 1\nret"},
+      // an instruction that may fuse is padded together with its jump
+      {28, "cmp rax, rbx\njne short 0x10",
+       "nop4\ncmp rax, rbx\njne short 0x10"},
+      {26, "test rax, rax\njne 0x100", "nop6\ntest rax, rax\njne 0x100"},
+      {24, "dec rcx\njne 0x100", "nop8\ndec rcx\njne 0x100"},
+      // but neither with an unconditional jump nor when it cannot fuse
+      {28, "cmp rax, rbx\njmp short 0x10",
+       "cmp rax, rbx\nnop\njmp short 0x10"},
+      {27, "cmp qword [rax], 1\njne short 0x10",
+       "cmp qword [rax], 1\nnop\njne short 0x10"},
+      {28, "mov rax, rbx\njne short 0x10",
+       "mov rax, rbx\nnop\njne short 0x10"},
+      // padding longer than the longest nop
+      {19, "cmp [rax+rcx*8+0x10000000], rbx\njne 0x100",
+       "nop11\nnop2\ncmp [rax+rcx*8+0x10000000], rbx\njne 0x100"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+  for (int offset = 0; offset < BOUNDARY; offset++)
+    result |= run_loop(offset);
+
+  uint8_t code[MAX_CODE_LEN];
+  char prog[MAX_PROG_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_branch_padding(al, true);
+  // a pair split over two calls is padded like a single call
+  after_nops(prog, 28, "cmp rax, rbx\njne short 0x10");
+  int failed = asm_assemble_str(al, prog);
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  after_nops(prog, 28, "cmp rax, rbx");
+  failed |= asm_assemble_str(al, prog);
+  failed |= asm_assemble_str(al, "jne short 0x10");
+  if (failed || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len)) {
+    fprintf(stderr, "pair split over two calls is not padded together\n");
+    result = EXIT_FAILURE;
+  }
+  // placeholders of the instruction fused with a jump move along with it
+  after_nops(prog, 26, "cmp rax, {v}\njne 0x100");
+  asm_set_offset(al, 0);
+  asm_template_t tmpl = asm_create_template(al, prog);
+  const uint64_t values[] = {0x12345678};
+  failed = tmpl == NULL || asm_assemble_template(al, tmpl, values);
+  code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  after_nops(prog, 26, "cmp rax, 0x12345678\njne 0x100");
+  failed |= asm_assemble_str(al, prog);
+  if (failed || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len)) {
+    fprintf(stderr, "padded template does not match\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_template(tmpl);
+  // setting a chunk size replaces branch padding
+  asm_set_chunk_size(al, 4);
+  asm_set_offset(al, 0);
+  after_nops(prog, 30, "jmp short 0x10");
+  if (asm_assemble_str(al, prog) || asm_get_offset(al) != 32) {
+    fprintf(stderr, "chunk size does not replace branch padding\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assemblyline.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOV_ASM "./test/mov.asm"
+#define MAPS_LINE_LEN 512
+
+/**
+ * checks the mapping containing @param addr has the permissions @param perms
+ * (ex: "r-x") in /proc/self/maps
+ */
+static bool mapped_as(const void *addr, const char *perms) {
+
+  FILE *maps = fopen("/proc/self/maps", "r");
+  if (maps == NULL)
+    return false;
+  char line[MAPS_LINE_LEN];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), maps) != NULL) {
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    char mode[5] = {0};
+    if (sscanf(line, "%lx-%lx %4s", &start, &end, mode) == 3 &&
+        (uintptr_t)addr >= start && (uintptr_t)addr < end)
+      found = !strncmp(mode, perms, strlen(perms));
+  }
+  fclose(maps);
+  return found;
+}
+
+/**
+ * returns the view of the buffer of @param al that machine code is written to
+ */
+static void *write_view(assemblyline_t al) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+  return asm_get_buffer(al);
+#pragma GCC diagnostic pop
+}
+
+/**
+ * assembles a long file with instance @param al and checks that the code it
+ * grows to is written to a writable view and runs from a distinct executable
+ * view of the same memory, which is not writable
+ */
+static int check_views(assemblyline_t al) {
+
+  const char *ret_42 = "mov rax, 42\nret\n";
+  asm_set_offset(al, 0);
+  if (asm_assemble_str(al, ret_42))
+    return EXIT_FAILURE;
+  for (int i = 0; i <= 1; i++)
+    if (asm_assemble_file(al, MOV_ASM))
+      return EXIT_FAILURE;
+  void *code = asm_get_code(al);
+  void *written = write_view(al);
+  if (code == written || !mapped_as(code, "r-x") ||
+      !mapped_as(written, "rw-") ||
+      memcmp(code, written, asm_get_offset(al)) != 0 ||
+      ((int (*)(void))code)() != 42) {
+    fprintf(stderr, "dual mapped views are not writable xor executable\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * test mapping internal buffers twice, writable and executable, from a memory
+ * file that grows (in place within a reserved range)
+ */
+int main() {
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  if (asm_set_dual_mapping(al, true) == EXIT_FAILURE || check_views(al)) {
+    fprintf(stderr, "failed to map buffer twice\n");
+    return EXIT_FAILURE;
+  }
+  // the executable view of a reserved range never moves
+  if (asm_set_reserve(al, 1 << 24) == EXIT_FAILURE) {
+    fprintf(stderr, "failed to reserve address space for a dual mapping\n");
+    return EXIT_FAILURE;
+  }
+  void *code = asm_get_code(al);
+  if (check_views(al) || asm_get_code(al) != code) {
+    fprintf(stderr, "reserved dual mapped buffer moved\n");
+    return EXIT_FAILURE;
+  }
+  // and back to a single mapping, which is written where it runs
+  if (asm_set_dual_mapping(al, false) == EXIT_FAILURE ||
+      asm_assemble_str(al, "ret") || asm_get_code(al) != write_view(al)) {
+    fprintf(stderr, "failed to map buffer once\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+
+  // external buffers cannot be mapped
+  uint8_t buffer[64];
+  al = asm_create_instance(buffer, sizeof(buffer));
+  if (asm_set_dual_mapping(al, true) == EXIT_SUCCESS) {
+    fprintf(stderr, "mapped an external buffer twice\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles instructions built with the typed asm_emit() interface and
+ * compares them against assembling their string representation*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 512
+
+const char *prog = "add rax, [rdi+8*rcx+0x10]\n"
+                   "mov rcx, [rsi-0x20]\n"
+                   "mov dword [rsp+4], 0x7fffffff\n"
+                   "lea rax, [4*rdx+0x100]\n"
+                   "mov rbx, [0x1000]\n"
+                   "mov byte [r13], 0xff\n"
+                   "sub word [rbp+r12], ax\n"
+                   "mov rax, 0x123456789\n"
+                   "mov r9d, -1\n"
+                   "imul r10, r11, 100\n"
+                   "shl rdx, 1\n"
+                   "movzx eax, ah\n"
+                   "vpaddq ymm0, ymm1, [rax]\n"
+                   "pxor xmm8, xmm15\n"
+                   "movntq [rdx], mm2\n"
+                   "rorx r10, r11, 13\n"
+                   "push 0x1234\n"
+                   "jmp 0x10\n"
+                   "ret\n";
+
+/**
+ * emits the instructions of @param prog with @param al
+ */
+static int emit_prog(assemblyline_t al) {
+
+  int result = EXIT_SUCCESS;
+  result |= asm_emit(al, AL_ADD, AL_REG(AL_RAX),
+                     AL_MEM(AL_RDI, AL_RCX, 8, 0x10));
+  result |= asm_emit(al, AL_MOV, AL_REG(AL_RCX),
+                     AL_MEM(AL_RSI, AL_NOREG, 1, -0x20));
+  result |= asm_emit(al, AL_MOV, AL_MEM32(AL_RSP, AL_NOREG, 0, 4),
+                     AL_IMM(0x7fffffff));
+  result |= asm_emit(al, AL_LEA, AL_REG(AL_RAX),
+                     AL_MEM(AL_NOREG, AL_RDX, 4, 0x100));
+  // a memory reference without registers is an absolute address
+  result |= asm_emit(al, AL_MOV, AL_REG(AL_RBX),
+                     AL_MEM(AL_NOREG, AL_NOREG, 0, 0x1000));
+  result |= asm_emit(al, AL_MOV, AL_MEM8(AL_R13, AL_NOREG, 0, 0), AL_IMM(0xff));
+  result |= asm_emit(al, AL_SUB, AL_MEM16(AL_RBP, AL_R12, 1, 0), AL_REG(AL_AX));
+  result |= asm_emit(al, AL_MOV, AL_REG(AL_RAX), AL_IMM(0x123456789));
+  result |= asm_emit(al, AL_MOV, AL_REG(AL_R9D), AL_IMM(-1));
+  result |= asm_emit(al, AL_IMUL, AL_REG(AL_R10), AL_REG(AL_R11), AL_IMM(100));
+  result |= asm_emit(al, AL_SHL, AL_REG(AL_RDX), AL_IMM(1));
+  result |= asm_emit(al, AL_MOVZX, AL_REG(AL_EAX), AL_REG(AL_AH));
+  result |= asm_emit(al, AL_VPADDQ, AL_REG(AL_YMM0), AL_REG(AL_YMM1),
+                     AL_MEM(AL_RAX, AL_NOREG, 0, 0));
+  result |= asm_emit(al, AL_PXOR, AL_REG(AL_XMM8), AL_REG(AL_XMM15));
+  result |= asm_emit(al, AL_MOVNTQ, AL_MEM(AL_RDX, AL_NOREG, 0, 0),
+                     AL_REG(AL_MM2));
+  result |= asm_emit(al, AL_RORX, AL_REG(AL_R10), AL_REG(AL_R11), AL_IMM(13));
+  result |= asm_emit(al, AL_PUSH, AL_IMM(0x1234));
+  result |= asm_emit(al, AL_JMP, AL_IMM(0x10));
+  result |= asm_emit(al, AL_RET);
+  return result;
+}
+
+/**
+ * emits @param prog with option @param option and chunk size
+ * @param chunk_size and checks the machine code is identical to assembling its
+ * string representation
+ */
+static int compare(enum asm_opt option, size_t chunk_size) {
+
+  uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_all(al, option);
+  asm_set_chunk_size(al, chunk_size);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, prog))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  if (emit_prog(al) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "emitted code differs (option %d, chunk size %zu)\n",
+            option, chunk_size);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  int result = EXIT_SUCCESS;
+  enum asm_opt options[] = {STRICT, NASM, SMART};
+  size_t chunk_sizes[] = {0, 5, 16};
+  for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++)
+    for (size_t j = 0; j < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); j++)
+      result |= compare(options[i], chunk_sizes[j]);
+
+  // operands that do not form a valid instruction are rejected
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  struct {
+    enum asm_mnemonic mnemonic;
+    struct asm_operand opds[4];
+  } invalid[] = {
+      {AL_ADD, {AL_REG(AL_RAX), AL_REG(AL_RBX), AL_REG(AL_RCX)}},
+      {AL_ADD, {AL_IMM(1), AL_REG(AL_RAX)}},
+      {AL_MOV, {AL_REG(AL_RAX), AL_MEM(AL_RDI, AL_RCX, 3, 0)}},
+      {AL_MOV, {AL_REG(AL_RAX), AL_MEM(AL_RDI, AL_NOREG, 2, 0)}},
+      {AL_MOV, {AL_REG(AL_RAX), AL_MEM(AL_RDI, AL_NOREG, 0, 0x100000000)}},
+      {AL_MOV, {AL_REG(AL_RAX), AL_REG(0x50)}},
+      {AL_MOVQ, {AL_REG(AL_RAX), AL_REG(0x68)}},
+  };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    asm_set_offset(al, 0);
+    if (asm_emit_operands(al, invalid[i].mnemonic, invalid[i].opds) !=
+        EXIT_FAILURE) {
+      fprintf(stderr, "invalid instruction %zu should have been rejected\n",
+              i);
+      result = EXIT_FAILURE;
+    }
+  }
+  asm_destroy_instance(al);
+  return result;
+}
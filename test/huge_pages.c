@@ -0,0 +1,100 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MOV_ASM "./test/mov.asm"
+#define HUGE_PAGE_SIZE 0x200000
+
+/**
+ * assembles a long file with instance @param al and checks it grows to the
+ * same code as an instance in pages of the system page size, which runs
+ */
+static int compare(assemblyline_t al) {
+
+  assemblyline_t small = asm_create_instance(NULL, 0);
+  const char *ret_42 = "mov rax, 42\nret\n";
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, ret_42) || asm_assemble_str(small, ret_42))
+    goto done;
+  for (int i = 0; i <= 1; i++)
+    if (asm_assemble_file(al, MOV_ASM) || asm_assemble_file(small, MOV_ASM))
+      goto done;
+  int len = asm_get_offset(al);
+  if (len != asm_get_offset(small) ||
+      memcmp(asm_get_code(al), asm_get_code(small), len) != 0 ||
+      ((int (*)(void))asm_get_code(al))() != 42)
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "code in huge pages differs\n");
+  asm_destroy_instance(small);
+  return result;
+}
+
+/**
+ * test backing internal buffers with huge pages, which falls back to the system
+ * page size if there are none
+ */
+int main() {
+
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  if (asm_get_page_size(al) != page_size ||
+      asm_set_huge_pages(al, true) == EXIT_FAILURE ||
+      (asm_get_page_size(al) != HUGE_PAGE_SIZE &&
+       asm_get_page_size(al) != page_size) ||
+      compare(al)) {
+    fprintf(stderr, "failed to map buffer in huge pages\n");
+    return EXIT_FAILURE;
+  }
+  // a range reserved for the buffer is advised huge pages and never moves
+  asm_set_offset(al, 0);
+  if (asm_set_reserve(al, 1 << 26) == EXIT_FAILURE) {
+    fprintf(stderr, "failed to reserve address space in huge pages\n");
+    return EXIT_FAILURE;
+  }
+  void *code = asm_get_code(al);
+  if (compare(al) || asm_get_code(al) != code) {
+    fprintf(stderr, "reserved buffer in huge pages moved\n");
+    return EXIT_FAILURE;
+  }
+  // and back to the system page size
+  asm_set_offset(al, 0);
+  if (asm_set_huge_pages(al, false) == EXIT_FAILURE ||
+      asm_get_page_size(al) != page_size || compare(al)) {
+    fprintf(stderr, "failed to map buffer in small pages\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+
+  // external buffers cannot be mapped
+  uint8_t buffer[64];
+  al = asm_create_instance(buffer, sizeof(buffer));
+  if (asm_get_page_size(al) != 0 ||
+      asm_set_huge_pages(al, true) == EXIT_SUCCESS) {
+    fprintf(stderr, "mapped an external buffer in huge pages\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return EXIT_SUCCESS;
+}
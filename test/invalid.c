@@ -33,7 +33,12 @@ const char *const testStrings[] = {
     "lea rax, [rsp+rsp] ; invalid memory syntax",
     "lea rax, [esp+esp] ; invalid memory syntax",
     "lea rax, [rbp+4*rsp] ; invalid memory syntax",
-    "lea rax, [r12+2*rsp] ; invalid memory syntax"};
+    "lea rax, [r12+2*rsp] ; invalid memory syntax",
+    "lea rax, [rax+rbx+rcx] ; invalid memory syntax",
+    "lea rax, [rax-2*rbx] ; invalid memory syntax",
+    "mov rax, 10h ; invalid immediate",
+    "mov rax, rbx, ; missing operand",
+    "mov rax, [fs:rax] ; segment overrides are unsupported"};
 
 // test invalid instructions with option
 int test_invalid(assemblyline_t al, enum asm_opt option) {
@@ -0,0 +1,254 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles branches to labels and compares them against the same branches
+ * with numeric displacements*/
+#include <assemblyline.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 512
+#define MAX_PROG_LEN 2048
+#define CHUNK_SIZE 16
+#define LOOP_RESULT (5 * 0x1234)
+#define NUM_OF_LINES 20000
+// longer than the trailing statements copied on the stack
+#define LONG_LABEL_LEN 200
+
+struct test_struct {
+  const char *prog;
+  const char *expected;
+};
+
+/**
+ * appends @param n nops to @param prog
+ */
+static void nops(char *prog, int n) {
+  for (int i = 0; i < n; i++)
+    strcat(prog, "nop\n");
+}
+
+/**
+ * assembles @param prog and @param expected and checks both produce the same
+ * machine code and chunk breaks (with nop padding the displacements of
+ * @param expected would no longer match, see run_loop())
+ */
+static int compare(const char *prog, const char *expected) {
+
+  uint8_t code[MAX_CODE_LEN];
+  int brks[2] = {-1, -1};
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, expected))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  if (asm_assemble_str(al, prog) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  asm_set_offset(al, 0);
+  if (asm_assemble_string_counting_chunks(al, (char *)prog, CHUNK_SIZE,
+                                          &brks[0]))
+    goto done;
+  asm_set_offset(al, 0);
+  if (asm_assemble_string_counting_chunks(al, (char *)expected, CHUNK_SIZE,
+                                          &brks[1]) ||
+      brks[0] != brks[1])
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%.40s...' does not assemble like '%.40s...'\n", prog,
+            expected);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * runs a loop over a branch to a label with chunk size @param chunk_size
+ */
+static int run_loop(size_t chunk_size) {
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(al, chunk_size);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, "mov ecx, 5\n"
+                           "xor eax, eax\n"
+                           "top:\n"
+                           "add eax, 0x1234\n"
+                           "dec ecx\n"
+                           "jne top\n"
+                           "ret\n") == EXIT_SUCCESS) {
+    long (*func)() = asm_get_code(al);
+    result = func() == LOOP_RESULT ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (result)
+    fprintf(stderr, "loop over a label fails (chunk size %zu)\n", chunk_size);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * assembles a large program ending with a branch to its first line with a
+ * single and with several threads and checks both produce the same code
+ */
+static int compare_parallel(void) {
+
+  char *prog = malloc(NUM_OF_LINES * sizeof("add rax, 1\n") + MAX_CODE_LEN);
+  if (prog == NULL)
+    return EXIT_FAILURE;
+  char *end = stpcpy(prog, "start:\n");
+  for (int i = 0; i < NUM_OF_LINES; i++)
+    end = stpcpy(end, "add rax, 1\n");
+  strcpy(end, "jne start\nret\n");
+  assemblyline_t serial = asm_create_instance(NULL, 0);
+  assemblyline_t parallel = asm_create_instance(NULL, 0);
+  asm_set_threads(parallel, 4);
+  int result = EXIT_FAILURE;
+  if (!asm_assemble_str(serial, prog) && !asm_assemble_str(parallel, prog) &&
+      asm_get_offset(serial) == asm_get_offset(parallel) &&
+      !memcmp(asm_get_code(serial), asm_get_code(parallel),
+              asm_get_offset(serial)))
+    result = EXIT_SUCCESS;
+  else
+    fprintf(stderr, "branches to labels differ with several threads\n");
+  asm_destroy_instance(serial);
+  asm_destroy_instance(parallel);
+  free(prog);
+  return result;
+}
+
+/**
+ * checks that @param al fails to assemble @param prog from the start of its
+ * buffer
+ */
+static bool rejects(assemblyline_t al, const char *prog) {
+  asm_set_offset(al, 0);
+  return asm_assemble_str(al, prog) == EXIT_FAILURE;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // forward and backward branches start short
+      {"jmp end\nnop\nnop\nend:\nret", "jmp short 0x2\nnop\nnop\nret"},
+      {"top:\nadd rax, 1\njne top\nret",
+       "add rax, 1\njne short 0xfffffffa\nret"},
+      {"jmp .L_1\n.L_1:\nret", "jmp short 0x0\nret"},
+      // call only has a rel32 encoding
+      {"call fn\nret\nfn:\nret", "call 0x1\nret\nret"},
+      {"jmp long end\nend:\nret", "jmp long 0x0\nret"},
+      // an instruction may follow a label on the same line
+      {"top: add rax, 1\njmp top", "add rax, 1\njmp short 0xfffffffa"},
+      {"top:add rax, 1 ; comment\nnext: jmp top\n",
+       "add rax, 1\njmp short 0xfffffffa"},
+      {"jmp end\nnop\nend: ret", "jmp short 0x1\nnop\nret"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(tests[i].prog, tests[i].expected);
+
+  // branches are only widened when their displacement does not fit 8 bits
+  char prog[MAX_PROG_LEN] = "jmp end\n";
+  char expected[MAX_PROG_LEN] = "jmp short 0x7f\n";
+  nops(prog, 127);
+  nops(expected, 127);
+  strcat(prog, "end:\nret");
+  result |= compare(prog, strcat(expected, "ret"));
+  strcpy(prog, "jmp end\n");
+  strcpy(expected, "jmp long 0x80\n");
+  nops(prog, 128);
+  nops(expected, 128);
+  strcat(prog, "end:\nret");
+  result |= compare(prog, strcat(expected, "ret"));
+  // widening the forward branch pushes the backward branch out of range
+  strcpy(prog, "top:\n");
+  strcpy(expected, "");
+  nops(prog, 60);
+  nops(expected, 60);
+  strcat(prog, "jmp fwd\n");
+  strcat(expected, "jmp long 0xc6\n");
+  nops(prog, 62);
+  nops(expected, 62);
+  strcat(prog, "jne top\n");
+  strcat(expected, "jne long 0xffffff7b\n");
+  nops(prog, 130);
+  nops(expected, 130);
+  strcat(prog, "fwd:\nret");
+  result |= compare(prog, strcat(expected, "ret"));
+
+  size_t chunk_sizes[] = {0, 5, CHUNK_SIZE};
+  for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++)
+    result |= run_loop(chunk_sizes[i]);
+  result |= compare_parallel();
+
+  // labels may be defined on other lines and programs are position independent
+  const char *lines[] = {"top:", "dec rdi", "jne top", "ret"};
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_program_t program = asm_parse_str(al, "top:\ndec rdi\njne top\nret");
+  uint8_t code[MAX_CODE_LEN];
+  int failed = asm_assemble_lines(al, lines, NULL, 4, NULL);
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 1);
+  failed |= program == NULL || asm_assemble_program(al, program);
+  if (failed || asm_get_offset(al) != code_len + 1 ||
+      memcmp(code, (uint8_t *)asm_get_code(al) + 1, code_len)) {
+    fprintf(stderr, "labels differ between lines and parsed programs\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_program(program);
+  // with explicit lengths no line is terminated
+  const size_t lens[] = {4, 7, 7, 3};
+  asm_set_offset(al, 0);
+  if (asm_assemble_lines(al, lines, lens, 4, NULL) ||
+      asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len)) {
+    fprintf(stderr, "labels differ between lines with and without lengths\n");
+    result = EXIT_FAILURE;
+  }
+  // branches on an unterminated last line (with short and long labels)
+  char label[LONG_LABEL_LEN + 1];
+  memset(label, 'l', LONG_LABEL_LEN);
+  label[LONG_LABEL_LEN] = '\0';
+  sprintf(prog, "%s:\nnop\njmp %s", label, label);
+  if (compare("top:\nnop\njmp top", "nop\njmp short 0xfffffffd") ||
+      compare(prog, "nop\njmp short 0xfffffffd")) {
+    fprintf(stderr, "unterminated branches to labels fail\n");
+    result = EXIT_FAILURE;
+  }
+
+  // invalid uses of labels fail
+  strcpy(prog, "jmp short end\n");
+  nops(prog, 128);
+  strcat(prog, "end:\nret");
+  size_t failed_line = 0;
+  const char *undefined[] = {"jmp nowhere", "ret"};
+  if (!asm_assemble_lines(al, undefined, NULL, 2, &failed_line) ||
+      failed_line != 2 || !rejects(al, "jmp nowhere\nret") ||
+      !rejects(al, "a:\na:\njmp a") ||
+      !rejects(al, "mov rax, data\ndata:") || !rejects(al, prog) ||
+      asm_create_template(al, "top:\njmp top") != NULL) {
+    fprintf(stderr, "invalid labels should have been rejected\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
@@ -0,0 +1,186 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*pads chunks by lengthening instructions and checks the machine code against
+ * its expected encoding and that it runs like the nop padded code*/
+#include <assemblyline.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 128
+#define MAX_CHUNK_SIZE 40
+
+struct test_struct {
+  const char *prog;
+  size_t chunk_size;
+  size_t len;
+  const uint8_t code[MAX_CODE_LEN];
+};
+
+/**
+ * assembles @param t with chunk lengthening and checks its machine code
+ */
+static int check(const struct test_struct *t) {
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(al, t->chunk_size);
+  asm_set_chunk_lengthening(al, true);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, t->prog) == EXIT_SUCCESS &&
+      asm_get_offset(al) == (int)t->len &&
+      !memcmp(asm_get_code(al), t->code, t->len))
+    result = EXIT_SUCCESS;
+  else
+    fprintf(stderr, "'%s' (chunk size %zu) is not lengthened as expected\n",
+            t->prog, t->chunk_size);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * assembles @param prog with a chunk size of @param chunk_size padded with
+ * nops and by lengthening, checks both are equally long and returns the
+ * results of running them in @param nops and @param lengthened
+ */
+static int run(const char *prog, size_t chunk_size, long *nops,
+               long *lengthened) {
+
+  assemblyline_t padded = asm_create_instance(NULL, 0);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(padded, chunk_size);
+  asm_set_chunk_size(al, chunk_size);
+  asm_set_chunk_lengthening(al, true);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(padded, prog) == EXIT_SUCCESS &&
+      asm_assemble_str(al, prog) == EXIT_SUCCESS &&
+      asm_get_offset(padded) == asm_get_offset(al)) {
+    long (*func)() = asm_get_code(padded);
+    *nops = func();
+    func = asm_get_code(al);
+    *lengthened = func();
+    result = EXIT_SUCCESS;
+  }
+  asm_destroy_instance(padded);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * checks that @param prog runs the same with every chunk size whether padded
+ * with nops or by lengthening
+ */
+static int compare_runs(const char *prog) {
+
+  for (size_t chunk_size = 2; chunk_size <= MAX_CHUNK_SIZE; chunk_size++) {
+    long nops = 0;
+    long lengthened = 0;
+    if (run(prog, chunk_size, &nops, &lengthened) || nops != lengthened) {
+      fprintf(stderr, "lengthened code differs (chunk size %zu):\n%s",
+              chunk_size, prog);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // wider displacements and 3 byte VEX before redundant prefixes
+      {"mov rax, [rbx+8]\nadd rcx, 1\nvaddpd ymm0, ymm1, ymm2\n"
+       "mov rdx, 0x123456789",
+       16,
+       26,
+       {0x48, 0x8b, 0x83, 0x08, 0x00, 0x00, 0x00, 0x48, 0x83, 0xc1, 0x01, 0xc4,
+        0xe1, 0x75, 0x58, 0xc2, 0x48, 0xba, 0x89, 0x67, 0x45, 0x23, 0x01, 0x00,
+        0x00, 0x00}},
+      // negative displacements and immediates stay sign extended
+      {"mov rax, [rbp-8]\nsub rcx, -2\nmov rdx, 0x123456789",
+       14,
+       24,
+       {0x48, 0x8b, 0x85, 0xf8, 0xff, 0xff, 0xff, 0x48, 0x81, 0xe9, 0xfe, 0xff,
+        0xff, 0xff, 0x48, 0xba, 0x89, 0x67, 0x45, 0x23, 0x01, 0x00, 0x00,
+        0x00}},
+      // prefixes are spread over the instructions
+      {"inc rax\ninc rbx\nmov edx, 0x12345678", 8, 13,
+       {0x2e, 0x48, 0xff, 0xc0, 0x2e, 0x48, 0xff, 0xc3, 0xba, 0x78, 0x56, 0x34,
+        0x12}},
+      // nothing before a jump or label is lengthened
+      {"inc rax\nret\nmov edx, 0x12345678", 8, 13,
+       {0x48, 0xff, 0xc0, 0xc3, 0x0f, 0x1f, 0x40, 0x00, 0xba, 0x78, 0x56, 0x34,
+        0x12}},
+      {"inc rax\ninc rbx\ntop:\nmov edx, 0x12345678", 8, 13,
+       {0x48, 0xff, 0xc0, 0x48, 0xff, 0xc3, 0x66, 0x90, 0xba, 0x78, 0x56, 0x34,
+        0x12}},
+      // without room for enough prefixes, nops are used
+      {"lea rax, [rcx+rdx]\nmov edx, 0x12345678", 8, 13,
+       {0x48, 0x8d, 0x04, 0x11, 0x0f, 0x1f, 0x40, 0x00, 0xba, 0x78, 0x56, 0x34,
+        0x12}},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= check(&tests[i]);
+
+  result |= compare_runs("mov rax, 0x1234\n"
+                         "mov [rsp-8], rax\n"
+                         "add rax, [rsp-8]\n"
+                         "sub rax, 3\n"
+                         "and rax, -16\n"
+                         "mov rcx, 0x7fff\n"
+                         "add rcx, -2\n"
+                         "xor rax, rcx\n"
+                         "lea rdx, [rax+rcx*2+0x10]\n"
+                         "add rax, rdx\n"
+                         "ret\n");
+  result |= compare_runs("mov ecx, 5\n"
+                         "xor eax, eax\n"
+                         "top:\n"
+                         "add eax, 0x1234\n"
+                         "mov [rsp-16], rax\n"
+                         "add rax, [rsp-16]\n"
+                         "dec ecx\n"
+                         "jne top\n"
+                         "ret\n");
+
+  // lengthening reaches instructions of previous calls, even if the input of
+  // a later call has labels and is assembled from the whole parsed input
+  const char *lines[] = {"mov rax, [rbx+8]\n", "inc rcx\n",
+                         "top:\nmov rdx, 0x123456789\njmp top\n"};
+  char prog[MAX_CODE_LEN] = "";
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(al, 16);
+  asm_set_chunk_lengthening(al, true);
+  bool failed = false;
+  for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+    strcat(prog, lines[i]);
+    failed |= asm_assemble_str(al, lines[i]);
+  }
+  uint8_t code[MAX_CODE_LEN];
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  failed |= asm_assemble_str(al, prog);
+  if (failed || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len)) {
+    fprintf(stderr, "lengthening differs when assembled line by line\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
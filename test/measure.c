@@ -0,0 +1,133 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*measures programs with several options and compares the result against the
+ * machine code assembled with the same options*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTERNAL_LEN 64
+
+struct test_struct {
+  const char *prog;
+  size_t chunk_size;
+  bool branch_padding;
+  bool lengthen;
+  // code assembled before the program
+  const char *prefix;
+  size_t num_instrs;
+};
+
+/**
+ * applies the options of @param t to instance @param al and assembles its
+ * prefix
+ */
+static int setup(assemblyline_t al, const struct test_struct *t) {
+
+  asm_set_chunk_size(al, t->chunk_size);
+  asm_set_branch_padding(al, t->branch_padding);
+  asm_set_chunk_lengthening(al, t->lengthen);
+  return t->prefix != NULL ? asm_assemble_str(al, t->prefix) : EXIT_SUCCESS;
+}
+
+/**
+ * measures the program of @param t and checks it takes as many bytes as its
+ * machine code, that the instance measuring it is left alone and that the
+ * lengths of its instructions add up to no more than that
+ */
+static int compare(const struct test_struct *t) {
+
+  assemblyline_t measured = asm_create_instance(NULL, 0);
+  assemblyline_t assembled = asm_create_instance(NULL, 0);
+  size_t bytes = 0;
+  uint8_t *lens = NULL;
+  size_t num_lens = 0;
+  int result = EXIT_FAILURE;
+  if (setup(measured, t) || setup(assembled, t))
+    goto done;
+  int offset = asm_get_offset(measured);
+  if (asm_measure_str(measured, t->prog, &bytes, &lens, &num_lens) ||
+      asm_get_offset(measured) != offset ||
+      asm_assemble_str(assembled, t->prog) ||
+      bytes != (size_t)(asm_get_offset(assembled) - offset) ||
+      num_lens != t->num_instrs)
+    goto done;
+  size_t sum = 0;
+  for (size_t i = 0; i < num_lens; i++)
+    sum += lens[i];
+  if (sum > bytes)
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' measured %zu bytes in %zu instructions\n", t->prog,
+            bytes, num_lens);
+  free(lens);
+  asm_destroy_instance(assembled);
+  asm_destroy_instance(measured);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      {"mov rax, 1\nadd rax, rbx\nret", 0, false, false, NULL, 3},
+      // padding to fit chunks, either with nops or by lengthening
+      {"mov rax, 0x1234\nadd rax, rbx\nmov rcx, 0x12345678\nret", 8, false,
+       false, "inc rax\ninc rax", 4},
+      {"mov rax, 0x1234\nadd rax, rbx\nmov rcx, 0x12345678\nret", 8, false,
+       true, "inc rax\ninc rax", 4},
+      // branches are relaxed, and jumps padded to branch boundaries
+      {"top:\ndec rcx\nmov rax, [rdi + 8*rcx]\nadd rdx, rax\njne top\nret", 0,
+       true, false,
+       "mov rcx, 0x12345678\nmov rdx, 0x12345678\nmov rsi, 0x12345678\n"
+       "mov rdi, 0x12345678",
+       5},
+      {"top:\ndec rcx\njne done\nmov rax, 1\njmp top\ndone:\nret", 0, false,
+       false, NULL, 5},
+      // alignment depends on the offset measured from
+      {"align 16\nret", 0, false, false, "inc rax", 1},
+      {"inc rax\nalign 32\nmov rcx, 0x12345678\nret", 8, false, true,
+       "inc rax", 3},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+
+  // an external buffer is never written to, however much code is measured
+  uint8_t buffer[EXTERNAL_LEN] = {0};
+  uint8_t zeros[EXTERNAL_LEN] = {0};
+  assemblyline_t al = asm_create_instance(buffer, EXTERNAL_LEN);
+  size_t bytes = 0;
+  if (asm_measure_str(al, "mov rax, 0x1234567890\nret\nmov rax, 0x1234567890\n"
+                          "mov rax, 0x1234567890\nmov rax, 0x1234567890\n"
+                          "mov rax, 0x1234567890\nmov rax, 0x1234567890\n",
+                      &bytes, NULL, NULL) ||
+      bytes != 61 || memcmp(buffer, zeros, EXTERNAL_LEN)) {
+    fprintf(stderr, "measuring wrote to an external buffer\n");
+    result = EXIT_FAILURE;
+  }
+  // invalid input fails
+  if (!asm_measure_str(al, "mov rax, rbx, rcx", &bytes, NULL, NULL)) {
+    fprintf(stderr, "measured invalid input\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles large programs with several threads and compares them against
+ * assembling them with a single thread*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+// large enough to be split into more slices than threads
+#define NUM_OF_LINES 40000
+
+const char *lines[] = {"mov rax, [rsi+0x10]\n",
+                       "add rax, rbx ; comment\n",
+                       "lea rcx, [rax+8*rdx-0x20]\n",
+                       "label:\n",
+                       "shl r9, 7\n",
+                       "\n",
+                       "rorx r10, r11, 13\r\n",
+                       "mov rdx, 0x80000000\n",
+                       "vpaddq ymm0, ymm1, [rax]\n",
+                       "jmp short 0x10\n",
+                       "mov byte [rdi+rcx], 0xff\n",
+                       "ret\n"};
+
+/**
+ * returns a program of @param NUM_OF_LINES lines ending with the unterminated
+ * statement @param last
+ */
+static char *make_prog(const char *last) {
+
+  size_t num_lines = sizeof(lines) / sizeof(lines[0]);
+  char *prog = malloc(NUM_OF_LINES * (strlen(lines[2]) + 1) + strlen(last));
+  if (prog == NULL)
+    return NULL;
+  char *end = prog;
+  for (size_t i = 0; i < NUM_OF_LINES; i++)
+    end = stpcpy(end, lines[(i * i + i / 3) % num_lines]);
+  strcpy(end, last);
+  return prog;
+}
+
+/**
+ * assembles @param len characters of @param prog with a single and with
+ * @param THREADS threads for chunk size @param chunk_size (counting chunk
+ * breaks if @param count is set) and checks both produce the same result
+ */
+static int compare(const char *prog, size_t len, size_t chunk_size,
+                   bool count) {
+
+  uint8_t *code = NULL;
+  int code_len = 0;
+  int chunk_brks[2] = {-1, -1};
+  int result = EXIT_SUCCESS;
+  for (int i = 0; i < 2 && result == EXIT_SUCCESS; i++) {
+    assemblyline_t al = asm_create_instance(NULL, 0);
+    asm_set_threads(al, i ? THREADS : 1);
+    asm_set_chunk_size(al, chunk_size);
+    if (count)
+      result = asm_assemble_buf_counting_chunks(al, prog, len, chunk_size,
+                                                &chunk_brks[i]);
+    else
+      result = asm_assemble_buf(al, prog, len);
+    if (result == EXIT_SUCCESS && i == 0) {
+      code_len = asm_get_offset(al);
+      code = malloc(code_len);
+      if (code != NULL)
+        memcpy(code, asm_get_code(al), code_len);
+    } else if (result == EXIT_SUCCESS &&
+               (code == NULL || asm_get_offset(al) != code_len ||
+                memcmp(code, asm_get_code(al), code_len) ||
+                chunk_brks[0] != chunk_brks[1])) {
+      result = EXIT_FAILURE;
+    }
+    asm_destroy_instance(al);
+  }
+  if (result)
+    fprintf(stderr, "parallel assembly differs (chunk size %zu, count %d)\n",
+            chunk_size, count);
+  free(code);
+  return result;
+}
+
+int main() {
+
+  int result = EXIT_SUCCESS;
+  char *prog = make_prog("xor eax, eax");
+  if (prog == NULL)
+    return EXIT_FAILURE;
+  size_t len = strlen(prog);
+  size_t chunk_sizes[] = {0, 5, 16};
+  for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+    // the null-terminated program and the unterminated last statement
+    result |= compare(prog, len + 1, chunk_sizes[i], false);
+    result |= compare(prog, len, chunk_sizes[i], false);
+  }
+  result |= compare(prog, len + 1, 16, true);
+  // assembly stops at the first null character
+  prog[len / 2] = '\0';
+  result |= compare(prog, len + 1, 0, false);
+  free(prog);
+
+  // an invalid line in any slice fails the whole program
+  prog = make_prog("invalid rax, 1");
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_threads(al, THREADS);
+  if (prog == NULL || asm_assemble_str(al, prog) != EXIT_FAILURE) {
+    fprintf(stderr, "assembling an invalid program should have failed\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  free(prog);
+  return result;
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*assembles a parsed program repeatedly and compares it against assembling
+ * the string representation*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 512
+#define ROUNDS 3
+
+const char *prog = "label:\n"
+                   "mov rax, [rsi+0x10]\n"
+                   "add rax, rbx ; comment\n"
+                   "lea rcx, [rax+8*rdx-0x20]\n"
+                   "shl r9, 7\n"
+                   "rorx r10, r11, 13\n"
+                   "push 0x1234\n"
+                   "mov rdx, 0x80000000\n"
+                   "mov byte [rdi+rcx], 0xff\n"
+                   "vpaddq ymm0, ymm1, [rax]\n"
+                   "jmp short 0x10\n"
+                   "mulx r8, r9, [rsi]\n"
+                   "ret\n";
+
+/**
+ * assembles @param prog with option @param option and chunk size
+ * @param chunk_size once as a string and @param ROUNDS times from its parsed
+ * form at increasing offsets, checking the machine code is identical
+ */
+static int compare(enum asm_opt option, size_t chunk_size) {
+
+  uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_all(al, option);
+  asm_set_chunk_size(al, chunk_size);
+  asm_program_t program = asm_parse_str(al, prog);
+  int result = EXIT_FAILURE;
+  if (program == NULL || asm_assemble_str(al, prog))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  for (int r = 0; r < ROUNDS; r++) {
+    // assembling again from the start must reproduce the same code
+    asm_set_offset(al, 0);
+    if (asm_assemble_program(al, program) || asm_get_offset(al) != code_len ||
+        memcmp(code, asm_get_code(al), code_len))
+      goto done;
+  }
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "parsed program differs (option %d, chunk size %zu)\n",
+            option, chunk_size);
+  asm_destroy_program(program);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  int result = EXIT_SUCCESS;
+  enum asm_opt options[] = {STRICT, NASM, SMART};
+  size_t chunk_sizes[] = {0, 5, 16};
+  for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++)
+    for (size_t j = 0; j < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); j++)
+      result |= compare(options[i], chunk_sizes[j]);
+
+  // a program that does not parse is not returned
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  if (asm_parse_str(al, "mov rax, rbx\ninvalid rax, 1\n") != NULL) {
+    fprintf(stderr, "parsing an invalid program should have failed\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
@@ -0,0 +1,191 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*rewrites programs with the peephole pass and compares the machine code
+ * against the same code rewritten by hand*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 256
+
+struct test_struct {
+  const char *prog;
+  unsigned int rules;
+  const char *expected;
+  size_t count;
+};
+
+/**
+ * assembles @param t with its peephole rules and its expected code without
+ * them and checks both produce the same machine code with the expected count
+ * of rewrites
+ */
+static int compare(const struct test_struct *t) {
+
+  static uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, t->expected))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  asm_set_peephole(al, t->rules);
+  if (asm_assemble_str(al, t->prog) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len) ||
+      asm_get_peephole_count(al) != t->count)
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' is not rewritten like '%s'\n", t->prog,
+            t->expected);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * assembles @param prog with and without every peephole rule, runs both and
+ * checks they return the same and that the rewritten code is shorter
+ */
+static int compare_runs(const char *prog) {
+
+  assemblyline_t naive = asm_create_instance(NULL, 0);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_peephole(al, AL_PEEPHOLE_ALL);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(naive, prog) == EXIT_SUCCESS &&
+      asm_assemble_str(al, prog) == EXIT_SUCCESS &&
+      asm_get_offset(al) < asm_get_offset(naive)) {
+    long (*func)() = asm_get_code(naive);
+    long expected = func();
+    func = asm_get_code(al);
+    result = func() == expected ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (result)
+    fprintf(stderr, "rewritten code differs:\n%s", prog);
+  asm_destroy_instance(naive);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // zero idioms where the flags are dead
+      {"mov rax, 0\nret", AL_PEEPHOLE_ZERO, "xor eax, eax\nret", 1},
+      {"mov r9, 0\nmov ecx, 0\nadd rdx, rcx", AL_PEEPHOLE_ZERO,
+       "xor r9d, r9d\nxor ecx, ecx\nadd rdx, rcx", 2},
+      {"mov ax, 0\nret", AL_PEEPHOLE_ZERO, "mov ax, 0\nret", 0},
+      // nothing that changes the flags is rewritten before they are read, a
+      // jump, a label or the end of the input
+      {"add rax, rbx\nmov rcx, 0\nadcx rdx, rcx\nret", AL_PEEPHOLE_ZERO,
+       "add rax, rbx\nmov rcx, 0\nadcx rdx, rcx\nret", 0},
+      {"mov rcx, 0\nadox rax, rcx\nadd rax, 1\nadc rdx, 0\nret",
+       AL_PEEPHOLE_ALL,
+       "mov ecx, 0\nadox rax, rcx\nadd rax, 1\nadc rdx, 0\nret", 1},
+      {"mov rax, 0\njmp 0x10", AL_PEEPHOLE_ZERO, "mov rax, 0\njmp 0x10", 0},
+      {"mov rax, 0\ntop:\nret", AL_PEEPHOLE_ZERO, "mov rax, 0\ntop:\nret", 0},
+      {"mov rax, 0", AL_PEEPHOLE_ZERO, "mov rax, 0", 0},
+      // compares with 0 set the same flags as tests
+      {"cmp rax, 0\nje 0x10\ncmp bl, 0\ncmp ah, 0\ncmp r10d, 0",
+       AL_PEEPHOLE_ALL,
+       "test rax, rax\nje 0x10\ntest bl, bl\ntest ah, ah\ntest r10d, r10d", 4},
+      {"cmp qword [rax], 0\nret", AL_PEEPHOLE_ALL, "cmp qword [rax], 0\nret",
+       0},
+      // multiplications by powers of 2
+      {"imul rax, rax, 8\nimul r8d, r8d, 2\nret", AL_PEEPHOLE_ALL,
+       "shl rax, 3\nshl r8d, 1\nret", 2},
+      {"imul eax, ebx, 2\nimul rcx, r12, 2\nret", AL_PEEPHOLE_ALL,
+       "lea eax, [rbx+rbx]\nlea rcx, [r12+r12]\nret", 2},
+      {"imul rax, rbx, 4\nimul rax, rsp, 2\nimul rax, rbp, 2\n"
+       "imul rax, r13, 2\nimul rax, rbx, 3\nret",
+       AL_PEEPHOLE_ALL,
+       "imul rax, rbx, 4\nimul rax, rsp, 2\nimul rax, rbp, 2\n"
+       "imul rax, r13, 2\nimul rax, rbx, 3\nret",
+       0},
+      // moves back of 64-bit registers
+      {"mov rax, rbx\nmov rbx, rax\nmov rbx, rax\nret", AL_PEEPHOLE_ALL,
+       "mov rax, rbx\nret", 2},
+      {"mov eax, ebx\nmov ebx, eax\nret", AL_PEEPHOLE_ALL,
+       "mov eax, ebx\nmov ebx, eax\nret", 0},
+      {"mov rax, rbx\ntop:\nmov rbx, rax\njmp top", AL_PEEPHOLE_ALL,
+       "mov rax, rbx\ntop:\nmov rbx, rax\njmp top", 0},
+      // increments and decrements
+      {"add rax, 1\nsub ebx, 1\nxor ecx, ecx", AL_PEEPHOLE_ALL,
+       "inc rax\ndec ebx\nxor ecx, ecx", 2},
+      {"add rax, 1\nadc rdx, 0\nret", AL_PEEPHOLE_ALL,
+       "add rax, 1\nadc rdx, 0\nret", 0},
+      // constants set by the shortest instruction
+      {"mov rax, 0\nmov cx, 0\nmov rdx, -1\nmov r8d, -1\nmov qword [rdi], 0\n"
+       "mov dword [rsi+r9*4-8], -1\nmov word [rsp], 0\nret",
+       AL_PEEPHOLE_CONST,
+       "xor eax, eax\nxor cx, cx\nor rdx, -1\nor r8d, -1\n"
+       "mov qword [rdi], 0\nmov dword [rsi+r9*4-8], -1\nmov word [rsp], 0\nret",
+       4},
+      {"mov rax, 0\nmov rdx, -1\nmov qword [rdi], 0\nmov r8d, -1\n"
+       "mov r9, 4294967295\nmov r10, 2147483647\nadc rax, rdx",
+       AL_PEEPHOLE_CONST,
+       "mov eax, 0\nmov rdx, -1\nmov qword [rdi], 0\nmov r8d, 0xffffffff\n"
+       "mov r9d, 0xffffffff\nmov r10d, 0x7fffffff\nadc rax, rdx",
+       3},
+      {"mov rax, 0x123456789\nmov byte [rdi], 0\nmov al, -1\n"
+       "mov qword [0x1000], 0\nmov rcx, -5\nret",
+       AL_PEEPHOLE_CONST,
+       "mov rax, 0x123456789\nmov byte [rdi], 0\nmov al, -1\n"
+       "mov qword [0x1000], 0\nmov rcx, -5\nret",
+       0},
+      // only the rules enabled are applied
+      {"mov rax, 0\ncmp rbx, 0\nadd rcx, 1\nret", AL_PEEPHOLE_TEST,
+       "mov rax, 0\ntest rbx, rbx\nadd rcx, 1\nret", 1},
+      {"mov rax, 0\ncmp rbx, 0\nadd rcx, 1\nret",
+       AL_PEEPHOLE_ZERO | AL_PEEPHOLE_INC,
+       "xor eax, eax\ncmp rbx, 0\ninc rcx\nret", 2},
+      {"mov rax, 0\ncmp rbx, 0\nadd rcx, 1\nret", 0,
+       "mov rax, 0\ncmp rbx, 0\nadd rcx, 1\nret", 0},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+
+  result |= compare_runs("mov rax, 0\n"
+                         "mov rcx, 5\n"
+                         "top:\n"
+                         "imul rdx, rcx, 2\n"
+                         "add rax, rdx\n"
+                         "mov rsi, rax\n"
+                         "mov rax, rsi\n"
+                         "imul rsi, rsi, 4\n"
+                         "add rax, rsi\n"
+                         "sub rcx, 1\n"
+                         "cmp rcx, 0\n"
+                         "jne top\n"
+                         "mov rdx, 0\n"
+                         "add rax, 1\n"
+                         "ret\n");
+  result |= compare_runs("mov rax, -1\n"
+                         "mov rdx, 0\n"
+                         "add rax, 1\n"
+                         "adc rdx, 0\n"
+                         "mov rcx, 0\n"
+                         "imul rdx, rdx, 8\n"
+                         "add rax, rdx\n"
+                         "ret\n");
+  return result;
+}
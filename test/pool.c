@@ -0,0 +1,160 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*acquires and releases instances from a pool and checks that reused
+ * instances behave like new ones*/
+#include <assemblyline.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 64
+#define MAX_RETAINED 2
+#define THREADS 4
+#define ROUNDS 1000
+
+const char *prog = "mov rax, 0x7fffffff\n"
+                   "lea r15, [rax+rsp]\n"
+                   "add rax, [rsi+0x10]\n"
+                   "ret\n";
+
+/**
+ * assembles @param prog with @param al and checks the machine code matches
+ * that of a new instance
+ */
+static int check_like_new(assemblyline_t al) {
+
+  uint8_t code[MAX_CODE_LEN];
+  assemblyline_t fresh = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (fresh == NULL || al == NULL || asm_assemble_str(fresh, prog))
+    goto done;
+  int code_len = asm_get_offset(fresh);
+  memcpy(code, asm_get_code(fresh), code_len);
+  if (asm_get_offset(al) != 0 || asm_assemble_str(al, prog) ||
+      asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "pooled instance does not behave like a new one\n");
+  if (fresh != NULL)
+    asm_destroy_instance(fresh);
+  return result;
+}
+
+/**
+ * acquires, uses and releases instances of the pool @param arg
+ */
+static void *acquire_release(void *arg) {
+
+  asm_pool_t pool = arg;
+  for (int i = 0; i < ROUNDS; i++) {
+    assemblyline_t al = asm_pool_acquire(pool);
+    if (al == NULL || asm_assemble_str(al, prog) ||
+        asm_pool_release(pool, al))
+      return arg;
+  }
+  return NULL;
+}
+
+/**
+ * checks the statistics of @param pool against the expected @param hits,
+ * @param misses and @param retained instances
+ */
+static int check_stats(asm_pool_t pool, size_t hits, size_t misses,
+                       size_t retained) {
+
+  struct asm_pool_stats stats = asm_pool_get_stats(pool);
+  if (stats.hits == hits && stats.misses == misses &&
+      stats.retained == retained &&
+      (stats.bytes_retained > 0) == (retained > 0))
+    return EXIT_SUCCESS;
+  fprintf(stderr,
+          "pool has %zu hits, %zu misses and %zu retained instances instead "
+          "of %zu, %zu and %zu\n",
+          stats.hits, stats.misses, stats.retained, hits, misses, retained);
+  return EXIT_FAILURE;
+}
+
+int main() {
+
+  int result = EXIT_SUCCESS;
+  asm_pool_t pool = asm_create_pool(MAX_RETAINED);
+  if (pool == NULL)
+    return EXIT_FAILURE;
+  assemblyline_t al = asm_pool_acquire(pool);
+  result |= check_stats(pool, 0, 1, 0);
+  // change every setting before releasing the instance
+  asm_set_all(al, STRICT);
+  asm_set_chunk_size(al, 5);
+  asm_assemble_str(al, prog);
+  asm_pool_release(pool, al);
+  result |= check_stats(pool, 0, 1, 1);
+  assemblyline_t reused = asm_pool_acquire(pool);
+  if (reused != al) {
+    fprintf(stderr, "released instance was not reused\n");
+    result = EXIT_FAILURE;
+  }
+  result |= check_stats(pool, 1, 1, 0);
+  result |= check_like_new(reused);
+
+  // the pool retains at most MAX_RETAINED instances
+  assemblyline_t instances[MAX_RETAINED + 1] = {reused};
+  for (int i = 1; i <= MAX_RETAINED; i++)
+    instances[i] = asm_pool_acquire(pool);
+  for (int i = 0; i <= MAX_RETAINED; i++)
+    asm_pool_release(pool, instances[i]);
+  result |= check_stats(pool, 1, MAX_RETAINED + 1, MAX_RETAINED);
+  // instances with external buffers are not retained
+  uint8_t buf[MAX_CODE_LEN];
+  asm_destroy_pool(pool);
+  pool = asm_create_pool(MAX_RETAINED);
+  if (pool == NULL)
+    return EXIT_FAILURE;
+  asm_pool_release(pool, asm_create_instance(buf, MAX_CODE_LEN));
+  result |= check_stats(pool, 0, 0, 0);
+  asm_destroy_pool(pool);
+
+  // concurrent use only ever creates as many instances as there are threads,
+  // as long as the pool retains one per thread
+  pool = asm_create_pool(THREADS);
+  if (pool == NULL)
+    return EXIT_FAILURE;
+  pthread_t threads[THREADS];
+  for (int i = 0; i < THREADS; i++)
+    if (pthread_create(&threads[i], NULL, acquire_release, pool))
+      return EXIT_FAILURE;
+  for (int i = 0; i < THREADS; i++) {
+    void *failed = NULL;
+    pthread_join(threads[i], &failed);
+    if (failed != NULL) {
+      fprintf(stderr, "concurrent use of the pool failed\n");
+      result = EXIT_FAILURE;
+    }
+  }
+  struct asm_pool_stats stats = asm_pool_get_stats(pool);
+  if (stats.hits + stats.misses != THREADS * ROUNDS ||
+      stats.misses > THREADS || stats.retained > THREADS) {
+    fprintf(stderr, "inconsistent statistics after concurrent use\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_pool(pool);
+  return result;
+}
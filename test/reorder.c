@@ -0,0 +1,230 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*fills chunk gaps by reordering instructions and compares the machine code
+ * against the same code reordered and padded by hand*/
+#include <assemblyline.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 8192
+#define MAX_CHUNK_SIZE 40
+#define NUM_OF_REPEATS 100
+
+struct test_struct {
+  const char *prog;
+  size_t chunk_size;
+  const char *expected;
+};
+
+/**
+ * assembles @param t with reordering and its expected code without chunk size
+ * and checks both produce the same machine code
+ */
+static int compare(const struct test_struct *t) {
+
+  static uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, t->expected))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  asm_set_chunk_size(al, t->chunk_size);
+  asm_set_chunk_reordering(al, true);
+  if (asm_assemble_str(al, t->prog) || asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' (chunk size %zu) is not reordered like '%s'\n",
+            t->prog, t->chunk_size, t->expected);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * assembles @param prog with a chunk size of @param chunk_size with and
+ * without reordering (and lengthening if @param lengthen is set), runs both
+ * and checks they return the same
+ */
+static int run(const char *prog, size_t chunk_size, bool lengthen) {
+
+  assemblyline_t padded = asm_create_instance(NULL, 0);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(padded, chunk_size);
+  asm_set_chunk_size(al, chunk_size);
+  asm_set_chunk_reordering(al, true);
+  asm_set_chunk_lengthening(al, lengthen);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(padded, prog) == EXIT_SUCCESS &&
+      asm_assemble_str(al, prog) == EXIT_SUCCESS) {
+    long (*func)() = asm_get_code(padded);
+    long expected = func();
+    func = asm_get_code(al);
+    result = func() == expected ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (result)
+    fprintf(stderr, "reordered code differs (chunk size %zu):\n%s", chunk_size,
+            prog);
+  asm_destroy_instance(padded);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * checks that @param prog runs the same with every chunk size with and without
+ * reordering
+ */
+static int compare_runs(const char *prog) {
+
+  int result = EXIT_SUCCESS;
+  for (size_t chunk_size = 2; chunk_size <= MAX_CHUNK_SIZE; chunk_size++)
+    result |= run(prog, chunk_size, false) | run(prog, chunk_size, true);
+  return result;
+}
+
+/**
+ * checks that reordering a program of @param line repeated many times fills
+ * chunk gaps with a chunk size of @param chunk_size
+ */
+static int saves_padding(const char *line, size_t chunk_size) {
+
+  char *prog = malloc(NUM_OF_REPEATS * strlen(line) + 1);
+  if (prog == NULL)
+    return EXIT_FAILURE;
+  char *end = prog;
+  for (int i = 0; i < NUM_OF_REPEATS; i++)
+    end = stpcpy(end, line);
+  assemblyline_t padded = asm_create_instance(NULL, 0);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_chunk_size(padded, chunk_size);
+  asm_set_chunk_size(al, chunk_size);
+  asm_set_chunk_reordering(al, true);
+  int result = EXIT_FAILURE;
+  if (!asm_assemble_str(padded, prog) && !asm_assemble_str(al, prog) &&
+      asm_get_offset(al) < asm_get_offset(padded))
+    result = EXIT_SUCCESS;
+  else
+    fprintf(stderr, "reordering does not save padding (chunk size %zu)\n",
+            chunk_size);
+  asm_destroy_instance(padded);
+  asm_destroy_instance(al);
+  free(prog);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // independent instructions fill the gaps
+      {"mov rax, [rdi]\nadd rax, 0x12345\nmov rdx, 0x123456789\n"
+       "lea rcx, [rsi+8]\ninc r8\nmov r9, 0x1234567890\nxor r10, r10\nret",
+       16,
+       "mov rax, [rdi]\nadd rax, 0x12345\nlea rcx, [rsi+8]\ninc r8\n"
+       "mov rdx, 0x123456789\nxor r10, r10\nnop3\nmov r9, 0x1234567890\n"
+       "ret"},
+      {"mov rcx, 0x123456789\nmov rdx, 0x123456789\nlea rax, [rsi+8]", 16,
+       "mov rcx, 0x123456789\nlea rax, [rsi+8]\nnop2\nmov rdx, 0x123456789"},
+      // registers (including their high bytes) that are written or read
+      {"mov rcx, 0x123456789\nmov rdx, 0x123456789\nlea rax, [rdx+8]", 16,
+       "mov rcx, 0x123456789\nnop6\nmov rdx, 0x123456789\nlea rax, [rdx+8]"},
+      {"mov rcx, 0x123456789\nmov rdx, 0x123456789\nmov dh, 1", 16,
+       "mov rcx, 0x123456789\nnop6\nmov rdx, 0x123456789\nmov dh, 1"},
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\nmul rsi", 8,
+       "mov ecx, 1\nnop3\nmov rdx, [rdi+0x100]\nnop\nmul rsi"},
+      // flags that are written or read
+      {"mov rcx, 0x123456789\nadd rdx, 0x12345678\nsetz al", 16,
+       "mov rcx, 0x123456789\nnop6\nadd rdx, 0x12345678\nsetz al"},
+      {"mov rcx, 0x123456789\nadd rdx, 0x12345678\ninc rax", 16,
+       "mov rcx, 0x123456789\nnop6\nadd rdx, 0x12345678\ninc rax"},
+      // loads pass loads, but nothing passes a store
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\nmov rax, [rsi]", 8,
+       "mov ecx, 1\nmov rax, [rsi]\nmov rdx, [rdi+0x100]"},
+      {"mov ecx, 1\nmov [rdi+0x100], rdx\nmov rax, [rsi]", 8,
+       "mov ecx, 1\nnop3\nmov [rdi+0x100], rdx\nnop\nmov rax, [rsi]"},
+      {"mov ecx, 1\nmov [rdi+0x100], rdx\nlea rax, [rsi]", 8,
+       "mov ecx, 1\nlea rax, [rsi]\nmov [rdi+0x100], rdx"},
+      // nothing is moved past a label, jump, timer or nop
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\ntop:\nmov rax, [rsi]", 8,
+       "mov ecx, 1\nnop3\nmov rdx, [rdi+0x100]\nnop\nmov rax, [rsi]"},
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\njmp 0x10\nmov rax, [rsi]", 8,
+       "mov ecx, 1\nnop3\nmov rdx, [rdi+0x100]\nnop\njmp 0x10\n"
+       "mov rax, [rsi]"},
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\nrdtsc\nmov rax, [rsi]", 8,
+       "mov ecx, 1\nnop3\nmov rdx, [rdi+0x100]\nnop\nrdtsc\nmov rax, [rsi]"},
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\nnop2\nmov rax, [rsi]", 8,
+       "mov ecx, 1\nnop3\nmov rdx, [rdi+0x100]\nnop\nnop2\nmov rax, [rsi]"},
+      // instructions are not reordered without a chunk size
+      {"mov ecx, 1\nmov rdx, [rdi+0x100]\nmov rax, [rsi]", 0,
+       "mov ecx, 1\nmov rdx, [rdi+0x100]\nmov rax, [rsi]"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+
+  result |= compare_runs("mov rax, 0x1234\n"
+                         "mov [rsp-8], rax\n"
+                         "mov rdx, 0x123456789\n"
+                         "add rax, [rsp-8]\n"
+                         "lea rcx, [rax+rdx*2+0x10]\n"
+                         "sub rax, 3\n"
+                         "mov [rsp-16], rcx\n"
+                         "mov r8, 0x7fffffffffff\n"
+                         "cmp rax, rcx\n"
+                         "setb dl\n"
+                         "xor rax, [rsp-16]\n"
+                         "imul rax, rdx, 7\n"
+                         "mov r9, 0x1234567890\n"
+                         "add rax, r8\n"
+                         "sub rax, r9\n"
+                         "ret\n");
+  result |= compare_runs("mov ecx, 5\n"
+                         "xor eax, eax\n"
+                         "top:\n"
+                         "add eax, 0x1234\n"
+                         "mov rdx, 0x123456789\n"
+                         "mov [rsp-16], rax\n"
+                         "add rax, [rsp-16]\n"
+                         "lea rsi, [rdx+rax]\n"
+                         "dec ecx\n"
+                         "jne top\n"
+                         "add rax, rsi\n"
+                         "ret\n");
+  // one-operand imul multiplies rax into rdx:rax
+  result |= compare_runs("mov rcx, 5\n"
+                         "add r9, r9\n"
+                         "add r9, r9\n"
+                         "mov rax, 3\n"
+                         "imul rcx\n"
+                         "ret\n");
+  size_t chunk_sizes[] = {8, 16, 32, 64};
+  for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++)
+    result |= saves_padding("mov rax, [rdi]\n"
+                            "add rax, 0x12345\n"
+                            "mov rdx, 0x123456789\n"
+                            "lea rcx, [rsi+8]\n"
+                            "inc r8\n"
+                            "mov r9, 0x1234567890\n"
+                            "xor r10, r10\n",
+                            chunk_sizes[i]);
+  return result;
+}
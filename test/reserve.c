@@ -0,0 +1,89 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOV_ASM "./test/mov.asm"
+
+/**
+ * test growing the internal buffer in place within a reserved range of address
+ * space: the code never moves, matches the code of a buffer that is remapped,
+ * and assembling past the end of the range fails.
+ */
+int main() {
+
+  assemblyline_t remapped = asm_create_instance(NULL, 0);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  if (asm_set_reserve(al, 1 << 24) == EXIT_FAILURE) {
+    fprintf(stderr, "failed to reserve address space\n");
+    return EXIT_FAILURE;
+  }
+  // code assembled before growing is kept
+  const char *ret_42 = "mov rax, 42\nret\n";
+  asm_assemble_str(al, ret_42);
+  asm_assemble_str(remapped, ret_42);
+  void *code = asm_get_code(al);
+  for (int i = 0; i <= 1; i++) {
+    if (asm_assemble_file(al, MOV_ASM) == EXIT_FAILURE ||
+        asm_assemble_file(remapped, MOV_ASM) == EXIT_FAILURE) {
+      fprintf(stderr, "failed to assemble %s\n", MOV_ASM);
+      return EXIT_FAILURE;
+    }
+  }
+  if (asm_get_code(al) != code) {
+    fprintf(stderr, "reserved buffer moved while growing\n");
+    return EXIT_FAILURE;
+  }
+  int len = asm_get_offset(al);
+  if (len != asm_get_offset(remapped) ||
+      memcmp(code, asm_get_code(remapped), len) != 0) {
+    fprintf(stderr, "reserved buffer differs from remapped buffer\n");
+    return EXIT_FAILURE;
+  }
+  if (((int (*)(void))code)() != 42) {
+    fprintf(stderr, "failed to run code of reserved buffer\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(remapped);
+  asm_destroy_instance(al);
+
+  // the buffer must fit into the range and cannot grow past it
+  al = asm_create_instance(NULL, 0);
+  if (asm_set_reserve(al, 1) == EXIT_SUCCESS ||
+      asm_set_reserve(al, 1 << 13) == EXIT_FAILURE) {
+    fprintf(stderr, "unexpected result of reserving a small range\n");
+    return EXIT_FAILURE;
+  }
+  if (asm_assemble_file(al, MOV_ASM) == EXIT_SUCCESS) {
+    fprintf(stderr, "assembled past the end of the reserved range\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+
+  // external buffers cannot be reserved
+  uint8_t buffer[64];
+  al = asm_create_instance(buffer, sizeof(buffer));
+  if (asm_set_reserve(al, 1 << 16) == EXIT_SUCCESS) {
+    fprintf(stderr, "reserved address space for an external buffer\n");
+    return EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return EXIT_SUCCESS;
+}
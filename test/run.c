@@ -420,6 +420,25 @@ int main() {
     return 1;
   }
   asm_set_offset(al, 0);
+  asm_set_chunk_size(al, 0);
+
+  const enum asm_uarch uarchs[] = {AL_UARCH_SKYLAKE, AL_UARCH_ZEN3};
+  for (size_t i = 0; i < sizeof(uarchs) / sizeof(uarchs[0]); i++) {
+    asm_set_scheduling(al, uarchs[i]);
+    if (asm_assemble_str(al, cur_B) == EXIT_FAILURE)
+      return EXIT_FAILURE;
+
+    void (*curB_scheduled)(uint64_t * out, uint64_t * in0, ...) =
+        asm_get_code(al);
+
+    if (execute_test(curB_scheduled)) {
+      fprintf(stderr,
+              "cur_B.asm scheduled did not produce expected results\n");
+      return 1;
+    }
+    asm_set_offset(al, 0);
+  }
+  asm_set_scheduling(al, AL_UARCH_NONE);
 
   const int bufsize = 6000;
   uint8_t *buffer =
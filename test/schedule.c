@@ -0,0 +1,137 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*schedules programs for a micro-architecture and compares the machine code
+ * against the same code scheduled by hand*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 256
+
+struct test_struct {
+  const char *prog;
+  enum asm_uarch uarch;
+  const char *expected;
+};
+
+/**
+ * assembles @param t scheduled for its micro-architecture and its expected
+ * code without scheduling and checks both produce the same machine code, every
+ * time it is scheduled
+ */
+static int compare(const struct test_struct *t) {
+
+  static uint8_t code[MAX_CODE_LEN];
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(al, t->expected))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_scheduling(al, t->uarch);
+  for (int i = 0; i < 2; i++) {
+    asm_set_offset(al, 0);
+    if (asm_assemble_str(al, t->prog) || asm_get_offset(al) != code_len ||
+        memcmp(code, asm_get_code(al), code_len))
+      goto done;
+  }
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "'%s' is not scheduled like '%s'\n", t->prog,
+            t->expected);
+  asm_destroy_instance(al);
+  return result;
+}
+
+/**
+ * assembles @param prog with and without scheduling for @param uarch, runs
+ * both and checks they return the same
+ */
+static int run(const char *prog, enum asm_uarch uarch) {
+
+  assemblyline_t in_order = asm_create_instance(NULL, 0);
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_set_scheduling(al, uarch);
+  int result = EXIT_FAILURE;
+  if (asm_assemble_str(in_order, prog) == EXIT_SUCCESS &&
+      asm_assemble_str(al, prog) == EXIT_SUCCESS) {
+    long (*func)() = asm_get_code(in_order);
+    long expected = func();
+    func = asm_get_code(al);
+    result = func() == expected ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (result)
+    fprintf(stderr, "scheduled code differs:\n%s", prog);
+  asm_destroy_instance(in_order);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      // independent multiplications overlap, as their flags are dead
+      {"imul rax, rbx, 3\nadd rax, 1\nimul rcx, rdx, 5\nadd rcx, 1\nret",
+       AL_UARCH_SKYLAKE,
+       "imul rax, rbx, 3\nimul rcx, rdx, 5\nadd rax, 1\nadd rcx, 1\nret"},
+      {"imul rax, rbx, 3\nadd rax, 1\nimul rcx, rdx, 5\nadd rcx, 1\nret",
+       AL_UARCH_ZEN3,
+       "imul rax, rbx, 3\nimul rcx, rdx, 5\nadd rax, 1\nadd rcx, 1\nret"},
+      {"imul rax, rbx, 3\nadd rax, 1\nimul rcx, rdx, 5\nadd rcx, 1\nret",
+       AL_UARCH_NONE,
+       "imul rax, rbx, 3\nadd rax, 1\nimul rcx, rdx, 5\nadd rcx, 1\nret"},
+      // loads are issued early
+      {"mov rax, [rdi]\nimul rax, rax, 3\nmov rcx, [rsi]\nimul rcx, rcx, 5\n"
+       "add rax, rcx\nret",
+       AL_UARCH_SKYLAKE,
+       "mov rax, [rdi]\nmov rcx, [rsi]\nimul rax, rax, 3\nimul rcx, rcx, 5\n"
+       "add rax, rcx\nret"},
+      // nothing moves past a label, a flag write that is read or a store
+      {"imul rax, rbx, 3\nadd rax, 1\ntop:\nimul rcx, rdx, 5\nadd rcx, 1\nret",
+       AL_UARCH_SKYLAKE,
+       "imul rax, rbx, 3\nadd rax, 1\ntop:\nimul rcx, rdx, 5\nadd rcx, 1\nret"},
+      {"add rax, rbx\nadc rdx, 0\nimul rcx, rsi, 3\nadd rcx, 1\nret",
+       AL_UARCH_SKYLAKE,
+       "add rax, rbx\nadc rdx, 0\nimul rcx, rsi, 3\nadd rcx, 1\nret"},
+      {"imul rax, rbx, 3\nadd rax, 1\nmov [rdi], rax\nmov rcx, [rsi]\n"
+       "imul rcx, rcx, 5\nret",
+       AL_UARCH_SKYLAKE,
+       "imul rax, rbx, 3\nadd rax, 1\nmov [rdi], rax\nmov rcx, [rsi]\n"
+       "imul rcx, rcx, 5\nret"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= compare(&tests[i]);
+
+  // implicit operands: one-operand multiplies read rax and write rdx:rax (the
+  // flag-free chains make issuing the multiply early look profitable)
+  const char *implicit[] = {
+      "lea r9, [r9+r9]\nlea r10, [r10+r10]\nlea r11, [r11+r11]\n"
+      "lea r9, [r9+r9]\nlea r10, [r10+r10]\nlea r11, [r11+r11]\n"
+      "mov rcx, 5\nmov rax, 3\nimul rcx\nret\n",
+      "lea r9, [r9+r9]\nlea r10, [r10+r10]\nlea r11, [r11+r11]\n"
+      "lea r9, [r9+r9]\nlea r10, [r10+r10]\nlea r11, [r11+r11]\n"
+      "mov rcx, 7\nmov rax, 3\nmul rcx\nlea rax, [rax+rdx]\nret\n"};
+  enum asm_uarch uarchs[] = {AL_UARCH_SKYLAKE, AL_UARCH_ZEN3};
+  for (size_t i = 0; i < sizeof(implicit) / sizeof(implicit[0]); i++)
+    for (size_t j = 0; j < sizeof(uarchs) / sizeof(uarchs[0]); j++)
+      result |= run(implicit[i], uarchs[j]);
+  return result;
+}
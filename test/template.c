@@ -0,0 +1,155 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*instantiates code templates and compares them against assembling the
+ * string with the values filled in*/
+#include <assemblyline.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE_LEN 128
+#define MAX_VALUES 2
+
+struct test_struct {
+  const char *tmpl;
+  uint64_t values[MAX_VALUES];
+  // the same code with values that already select the widest encoding
+  const char *expected;
+};
+
+/**
+ * instantiates @param t and checks it against its expected string and that
+ * instantiating it with zeros does not change its length
+ */
+static int check(const struct test_struct *t) {
+
+  uint8_t code[MAX_CODE_LEN];
+  const uint64_t zeros[MAX_VALUES] = {0};
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  asm_template_t tmpl = asm_create_template(al, t->tmpl);
+  int result = EXIT_FAILURE;
+  if (tmpl == NULL || asm_assemble_str(al, t->expected))
+    goto done;
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  if (asm_assemble_template(al, tmpl, t->values) ||
+      asm_get_offset(al) != code_len ||
+      memcmp(code, asm_get_code(al), code_len))
+    goto done;
+  asm_set_offset(al, 0);
+  if (asm_assemble_template(al, tmpl, zeros) || asm_get_offset(al) != code_len)
+    goto done;
+  result = EXIT_SUCCESS;
+done:
+  if (result)
+    fprintf(stderr, "template '%s' does not match '%s'\n", t->tmpl,
+            t->expected);
+  asm_destroy_template(tmpl);
+  asm_destroy_instance(al);
+  return result;
+}
+
+int main() {
+
+  struct test_struct tests[] = {
+      {"mov rax, {ptr}\ncall rax",
+       {0x7ff012345678},
+       "mov rax, 0x00007ff012345678\ncall rax"},
+      {"mov rcx, [rdi+{off}]\nadd rcx, {n}\nmov [rdi+{off}], rcx",
+       {0x1000, 0x20000000},
+       "mov rcx, [rdi+0x1000]\nadd rcx, 0x20000000\nmov [rdi+0x1000], rcx"},
+      {"lea rax, [rbp+8*rcx+{off}]\nimul rax, rax, {k}",
+       {0x12345, 0x100000},
+       "lea rax, [rbp+8*rcx+0x12345]\nimul rax, rax, 0x100000"},
+      {"shl rdx, {s}\nmov eax, {v}",
+       {13, 0xdeadbeef},
+       "shl rdx, 13\nmov eax, 0xdeadbeef"},
+      {"cmp qword [rsi+{off}], {v}",
+       {0x400, 0x7fffffff},
+       "cmp qword [rsi+0x400], 0x7fffffff"},
+      {"mov rax, [rsp+{off}]\nmov r9w, {v}",
+       {0x200, 0x1234},
+       "mov rax, [rsp+0x200]\nmov r9w, 0x1234"},
+      {"push {v}\npop rax", {0x12345678}, "push 0x12345678\npop rax"},
+  };
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    result |= check(&tests[i]);
+
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  // placeholders are indexed in order of first appearance
+  asm_template_t tmpl = asm_create_template(al, "add rax, [rdi+{b}]\n"
+                                                "add rax, {a}\n"
+                                                "add rax, [rsi+{b}]\n");
+  if (tmpl == NULL || asm_template_placeholder(tmpl, "b") != 0 ||
+      asm_template_placeholder(tmpl, "a") != 1 ||
+      asm_template_placeholder(tmpl, "c") != -1) {
+    fprintf(stderr, "placeholders are not indexed in order\n");
+    result = EXIT_FAILURE;
+  }
+  // a value must fit the width of its field
+  const uint64_t too_wide[] = {0, 0x100000000};
+  const uint64_t negative[] = {0, -1};
+  int failed = tmpl == NULL || !asm_assemble_template(al, tmpl, too_wide);
+  asm_set_offset(al, 0);
+  if (failed || asm_assemble_template(al, tmpl, negative)) {
+    fprintf(stderr, "placeholder values are not range checked\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_template(tmpl);
+
+  // chunk padding is laid out for the offset the template is created at
+  asm_set_chunk_size(al, 16);
+  asm_set_offset(al, 0);
+  const char *nops = "nop\nnop\nnop";
+  const uint64_t x[] = {0x7ff012345678};
+  uint8_t code[MAX_CODE_LEN];
+  failed = asm_assemble_str(al, nops);
+  tmpl = asm_create_template(al, "mov rax, {x}\nmov rbx, {x}\nadd rax, rbx");
+  failed |= asm_assemble_str(al, "mov rax, 0x00007ff012345678\n"
+                                 "mov rbx, 0x00007ff012345678\nadd rax, rbx");
+  int code_len = asm_get_offset(al);
+  memcpy(code, asm_get_code(al), code_len);
+  asm_set_offset(al, 0);
+  failed |= tmpl == NULL || asm_assemble_str(al, nops) ||
+            asm_assemble_template(al, tmpl, x) ||
+            asm_get_offset(al) != code_len ||
+            memcmp(code, asm_get_code(al), code_len);
+  // and cannot be instantiated where it would cross a boundary
+  asm_set_offset(al, 0);
+  failed |= tmpl == NULL || !asm_assemble_template(al, tmpl, x);
+  asm_set_offset(al, 16 + 3);
+  failed |= tmpl == NULL || asm_assemble_template(al, tmpl, x);
+  if (failed) {
+    fprintf(stderr, "template padding does not line up with its offset\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_template(tmpl);
+  asm_set_chunk_size(al, 0);
+  asm_set_offset(al, 0);
+  // placeholders are only allowed in templates and not in branches
+  if (asm_assemble_str(al, "mov rax, {ptr}") != EXIT_FAILURE ||
+      asm_create_template(al, "jmp {target}") != NULL ||
+      asm_create_template(al, "mov rax, [rdi-{off}]") != NULL) {
+    fprintf(stderr, "invalid placeholders should have been rejected\n");
+    result = EXIT_FAILURE;
+  }
+  asm_destroy_instance(al);
+  return result;
+}
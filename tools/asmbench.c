@@ -0,0 +1,178 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*measures assembly throughput (lines/sec) over a corpus of x64 asm files*/
+#include <assemblyline.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ROUNDS 20
+#define NSEC_PER_SEC 1000000000.0
+
+struct source {
+  char *str;
+  size_t lines;
+};
+
+/**
+ * reads @param path into a null-terminated heap string stored in @param src
+ * and counts its lines. Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int read_source(const char *path, struct source *src) {
+
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return EXIT_FAILURE;
+  fseek(fp, 0, SEEK_END);
+  long len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  src->str = malloc(len + 1);
+  size_t read_len = fread(src->str, 1, len, fp);
+  fclose(fp);
+  src->str[read_len] = '\0';
+  src->lines = 0;
+  for (size_t i = 0; i < read_len; i++)
+    if (src->str[i] == '\n')
+      src->lines++;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * joins the @param num_srcs sources @param srcs into a null-terminated heap
+ * string and stores its number of lines in @param lines
+ */
+static char *join_sources(const struct source *srcs, size_t num_srcs,
+                          size_t *lines) {
+
+  size_t len = 0;
+  for (size_t i = 0; i < num_srcs; i++)
+    len += strlen(srcs[i].str) + 1;
+  char *joined = malloc(len + 1);
+  if (joined == NULL)
+    return NULL;
+  char *end = joined;
+  *end = '\0';
+  *lines = 0;
+  for (size_t i = 0; i < num_srcs; i++) {
+    end = stpcpy(stpcpy(end, srcs[i].str), "\n");
+    *lines += srcs[i].lines + 1;
+  }
+  return joined;
+}
+
+static double now_sec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / NSEC_PER_SEC;
+}
+
+int main(int argc, char *argv[]) {
+
+  int rounds = DEFAULT_ROUNDS;
+  unsigned int max_threads = 1;
+  int first = 1;
+  for (; first + 2 < argc && argv[first][0] == '-'; first += 2) {
+    if (strcmp(argv[first], "-n") == 0)
+      rounds = atoi(argv[first + 1]);
+    else if (strcmp(argv[first], "-j") == 0)
+      max_threads = (unsigned int)atoi(argv[first + 1]);
+    else
+      break;
+  }
+  if (first >= argc || argv[first][0] == '-' || rounds < 1 ||
+      max_threads < 1) {
+    fprintf(stderr, "Usage: %s [-n ROUNDS] [-j MAX_THREADS] FILE.asm...\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  assemblyline_t al = asm_create_instance(NULL, 0);
+  struct source *srcs = calloc(argc, sizeof(struct source));
+  size_t num_srcs = 0;
+  size_t lines = 0;
+  // keep only the files assemblyline can assemble
+  for (int i = first; i < argc; i++) {
+    if (read_source(argv[i], &srcs[num_srcs]))
+      continue;
+    asm_set_offset(al, 0);
+    if (asm_assemble_str(al, srcs[num_srcs].str) == EXIT_FAILURE) {
+      free(srcs[num_srcs].str);
+      continue;
+    }
+    lines += srcs[num_srcs++].lines;
+  }
+  double start = now_sec();
+  for (int r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < num_srcs; i++) {
+      asm_set_offset(al, 0);
+      asm_assemble_str(al, srcs[i].str);
+    }
+  }
+  double elapsed = now_sec() - start;
+  double total = (double)lines * rounds;
+  printf("%zu files, %zu lines, %d rounds: %.3f s, %.0f lines/sec\n",
+         num_srcs, lines, rounds, elapsed, total / elapsed);
+  // parse once and only measure assembling the parsed programs
+  asm_program_t *programs = calloc(num_srcs, sizeof(asm_program_t));
+  for (size_t i = 0; i < num_srcs; i++)
+    programs[i] = asm_parse_str(al, srcs[i].str);
+  start = now_sec();
+  for (int r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < num_srcs; i++) {
+      asm_set_offset(al, 0);
+      asm_assemble_program(al, programs[i]);
+    }
+  }
+  elapsed = now_sec() - start;
+  printf("parsed programs: %.3f s, %.0f lines/sec\n", elapsed,
+         total / elapsed);
+  for (size_t i = 0; i < num_srcs; i++)
+    asm_destroy_program(programs[i]);
+  free(programs);
+  // the sources are joined into one input (skipped if several of them define
+  // a label that is branched to) and assembled with a doubling number of
+  // threads up to max_threads
+  size_t joined_lines = 0;
+  char *joined =
+      max_threads > 1 ? join_sources(srcs, num_srcs, &joined_lines) : NULL;
+  asm_set_offset(al, 0);
+  if (joined != NULL && asm_assemble_str(al, joined) == EXIT_FAILURE) {
+    free(joined);
+    joined = NULL;
+  }
+  for (unsigned int threads = 1; joined != NULL; threads *= 2) {
+    if (threads > max_threads)
+      threads = max_threads;
+    asm_set_threads(al, threads);
+    start = now_sec();
+    for (int r = 0; r < rounds; r++) {
+      asm_set_offset(al, 0);
+      asm_assemble_str(al, joined);
+    }
+    elapsed = now_sec() - start;
+    printf("%u threads (%zu lines joined): %.3f s, %.0f lines/sec\n", threads,
+           joined_lines, elapsed, (double)joined_lines * rounds / elapsed);
+    if (threads == max_threads)
+      break;
+  }
+  free(joined);
+  for (size_t i = 0; i < num_srcs; i++)
+    free(srcs[i].str);
+  free(srcs);
+  asm_destroy_instance(al);
+  return EXIT_SUCCESS;
+}
@@ -30,7 +30,6 @@
 #include <unistd.h>
 
 #define DEFAULT_ARG_LEN 10
-#define BUFFER_SIZE 100
 
 // max number of arguments the assembled function will be called with
 #define MAX_ARGUMENTS 6
@@ -62,6 +61,8 @@ struct parsed_ops {
   enum OUTPUT create_bin;
   char *param_file;
   int chunk_boundary;
+  // micro-architecture to estimate the cost of FILE on, or AL_UARCH_NONE
+  enum asm_uarch analyze;
 };
 
 static void parse_opt(assemblyline_t al, int argc, char **argv,
@@ -97,9 +98,34 @@ Assembles FILE into memory.\n\
                                  padding will be used to ensure no instruction \n\
                                  opcode will cross the specified CHUNK_SIZE \n\
                                  boundary.\n\
+  -l, --lengthen               With -c, chunks are padded by lengthening the \n\
+                                 instructions before the boundary (longer \n\
+                                 encodings and redundant prefixes) instead of\n\
+                                 with nops where possible.\n\
+  -R, --reorder                With -c, a later independent instruction that \n\
+                                 fits the gap before a chunk boundary is moved\n\
+                                 into it instead of padding where possible.\n\
+  -O, --peephole               Rewrites naive idioms into shorter or cheaper \n\
+                                 instructions that do the same before they are\n\
+                                 assembled, ex: \"mov rax, 0\" as \"xor eax, \n\
+                                 eax\" where the flags are not read afterwards.\n\
+  -S, --schedule UARCH         Reorders the instructions of each straight-line\n\
+                                 block to shorten its critical path by the \n\
+                                 latencies of UARCH (skylake or zen3).\n\
+  -A, --analyze UARCH          Estimates the cost of FILE on UARCH (skylake or\n\
+                                 zen3) without running it: its micro-ops, \n\
+                                 reciprocal throughput, critical path latency\n\
+                                 and port pressure are printed to stdout.\n\
+  -a, --align-branches         Nop padding will be used to ensure no jump, call\n\
+                                 or return (together with an instruction that \n\
+                                 may macro-fuse with it) crosses or ends on a \n\
+                                 32 byte boundary. Replaces -c.\n\
   -b, --breaks CHUNK_BOUNDARY  Given a CHUNK_BOUNDARY>1, counts the number of \n\
                                  instructions where their opcode crosses the  \n\
                                  specified CHUNK_BOUNDARY size in bytes.\n\
+  -j, --threads THREADS        Assembles files larger than 128 KiB with \n\
+                                 THREADS>0 threads. The machine code is the \n\
+                                 same as with a single thread.\n\
   --nasm-mov-imm               Enables nasm-style mov-immediate register-size\n\
                                  handling. ex: if immediate size for mov is les\n\
                                  than or equal to max signed 32 bit assemblyline\n\
@@ -173,6 +199,62 @@ static void print_version() {
   exit(EXIT_SUCCESS);
 }
 
+/**
+ * returns the micro-architecture named @param name, or exits with
+ * @param error_msg
+ */
+static enum asm_uarch parse_uarch(const char *name, char *error_msg) {
+  if (name != NULL && !strcmp(name, "skylake"))
+    return AL_UARCH_SKYLAKE;
+  if (name != NULL && !strcmp(name, "zen3"))
+    return AL_UARCH_ZEN3;
+  err_print_usage(error_msg);
+  return AL_UARCH_NONE;
+}
+
+/**
+ * appends the @param len characters of @param str to the @param input of
+ * @param input_len characters read so far, or exits if out of memory
+ */
+static void append_input(char **input, size_t *input_len, const char *str,
+                         size_t len) {
+  char *grown = realloc(*input, *input_len + len + 1);
+  if (grown == NULL) {
+    perror("Error: ");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(grown + *input_len, str, len);
+  *input_len += len;
+  grown[*input_len] = '\0';
+  *input = grown;
+}
+
+/**
+ * parses the @param len characters of @param input with instance @param al and
+ * prints the estimated cost of the program on @param uarch
+ */
+static int print_analysis(assemblyline_t al, const char *input, size_t len,
+                          enum asm_uarch uarch) {
+
+  const char *const port_names[AL_NUM_PORTS] = {
+      "alu", "mul", "vec", "fma", "div", "load", "store"};
+  struct asm_analysis analysis;
+  asm_program_t program = asm_parse_buf(al, input, len);
+  if (program == NULL || asm_analyze_program(program, uarch, &analysis)) {
+    asm_destroy_program(program);
+    return EXIT_FAILURE;
+  }
+  asm_destroy_program(program);
+  printf("Instructions:          %zu\n", analysis.instrs);
+  printf("Micro-ops:             %zu\n", analysis.uops);
+  printf("Reciprocal throughput: %.2f\n", analysis.rthroughput);
+  printf("Critical path latency: %u\n", analysis.latency);
+  printf("Port pressure (cycles per iteration):\n");
+  for (int port = 0; port < AL_NUM_PORTS; port++)
+    printf("  %-6s %.2f\n", port_names[port], analysis.pressure[port]);
+  return EXIT_SUCCESS;
+}
+
 static void print_chunk_brks(int total_chunk_brks, bool debug,
                              int chunk_boundary) {
 
@@ -357,7 +439,8 @@ int main(int argc, char *argv[]) {
                            .debug = false,
                            .create_bin = NONE,
                            .param_file = NULL,
-                           .chunk_boundary = 0};
+                           .chunk_boundary = 0,
+                           .analyze = AL_UARCH_NONE};
 
   parse_opt(al, argc, argv, &ops);
   set_mov_imm(al, ops.mov_imm);
@@ -368,6 +451,10 @@ int main(int argc, char *argv[]) {
 
   struct mode m = findMode(&ops, argc);
 
+  // the input is kept to be analyzed as a whole
+  char *input = NULL;
+  size_t input_len = 0;
+
   if (m.src == FLE) {
     int ret = m.count ? asm_assemble_file_counting_chunks(al, argv[optind],
                                                           ops.chunk_boundary,
@@ -377,32 +464,44 @@ int main(int argc, char *argv[]) {
       fprintf(stderr, "failed to assemble file: %s\n", argv[optind]);
       exit(EXIT_FAILURE);
     }
+    FILE *file = ops.analyze ? fopen(argv[optind], "r") : NULL;
+    char buf[BUFSIZ];
+    size_t len = 0;
+    while (file != NULL && (len = fread(buf, 1, sizeof(buf), file)) > 0)
+      append_input(&input, &input_len, buf, len);
+    if (file != NULL)
+      fclose(file);
   }
 
   // else
   if (m.src == STD) {
 
-    char *line = NULL;
-    int chunk_brks = 0;
-    size_t size = BUFFER_SIZE;
-    // init total count
-    if (m.count)
-      total_chunk_brks = 0;
-
-    while (getline(&line, &size, stdin) != -1) {
-
-      int ret = m.count ? asm_assemble_string_counting_chunks(
-                              al, line, ops.chunk_boundary, &chunk_brks)
-                        : asm_assemble_str(al, line);
-      if (ret) {
-        fprintf(stderr, "failed to assemble instruction: %s\n", line);
-        exit(EXIT_FAILURE);
-      }
-      total_chunk_brks += chunk_brks;
+    // stdin is assembled as a whole like a file, so labels may be used before
+    // they are defined
+    char buf[BUFSIZ];
+    size_t len = 0;
+    while ((len = fread(buf, 1, sizeof(buf), stdin)) > 0)
+      append_input(&input, &input_len, buf, len);
+    int ret = m.count ? asm_assemble_buf_counting_chunks(
+                            al, input == NULL ? "" : input, input_len,
+                            ops.chunk_boundary, &total_chunk_brks)
+                      : asm_assemble_buf(al, input == NULL ? "" : input,
+                                         input_len);
+    if (ret) {
+      fprintf(stderr, "failed to assemble stdin\n");
+      exit(EXIT_FAILURE);
     }
+  }
 
-    free(line);
+  if (ops.analyze) {
+    int ret = print_analysis(al, input == NULL ? "" : input, input_len,
+                             ops.analyze);
+    if (ret) {
+      fprintf(stderr, "failed to analyze the input\n");
+      exit(EXIT_FAILURE);
+    }
   }
+  free(input);
 
   if (total_chunk_brks != -1)
     print_chunk_brks(total_chunk_brks, ops.debug, ops.chunk_boundary);
@@ -448,8 +547,15 @@ static void parse_opt(assemblyline_t al, int argc, char **argv,
       {"strict",                      no_argument,       0,              't'},
       {"smart",                       no_argument,       0,              's'},
       {"chunk",                       required_argument, 0,              'c'},
+      {"lengthen",                    no_argument,       0,              'l'},
+      {"reorder",                     no_argument,       0,              'R'},
+      {"peephole",                    no_argument,       0,              'O'},
+      {"schedule",                    required_argument, 0,              'S'},
+      {"analyze",                     required_argument, 0,              'A'},
+      {"align-branches",              no_argument,       0,              'a'},
       {"breaks",                      required_argument, 0,              'b'},
       {"object",                      required_argument, 0,              'o'},
+      {"threads",                     required_argument, 0,              'j'},
       {0,                             0,                 0,               0 }
   };
   // clang-format on
@@ -458,7 +564,7 @@ static void parse_opt(assemblyline_t al, int argc, char **argv,
   int option_index = 0;
   int opt = -1;
   while (1) {
-    opt = getopt_long(argc, argv, "hvr::ntspP:c:b:o:", long_options,
+    opt = getopt_long(argc, argv, "hvr::ntspP:c:lROS:A:ab:o:j:", long_options,
                       &option_index);
     if (opt == -1) {
       break; // all options parsed.
@@ -502,12 +608,44 @@ static void parse_opt(assemblyline_t al, int argc, char **argv,
       asm_set_chunk_size(al, temp);
       break;
 
+    case 'l':
+      asm_set_chunk_lengthening(al, true);
+      break;
+
+    case 'R':
+      asm_set_chunk_reordering(al, true);
+      break;
+
+    case 'O':
+      asm_set_peephole(al, AL_PEEPHOLE_ALL);
+      break;
+
+    case 'S':
+      asm_set_scheduling(al, parse_uarch(optarg, "Error: [-S UARCH] expects "
+                                                 "skylake or zen3\n"));
+      break;
+
+    case 'A':
+      r->analyze = parse_uarch(optarg, "Error: [-A UARCH] expects skylake or "
+                                       "zen3\n");
+      break;
+
+    case 'a':
+      asm_set_branch_padding(al, true);
+      break;
+
     case 'b':
       if (optarg == NULL || (temp = atoi(optarg)) <= 1)
         err_print_usage("Error: [-b CHUNK_BOUNDARY>1] expects an integer\n");
       r->chunk_boundary = temp;
       break;
 
+    case 'j':
+      if (optarg == NULL || (temp = atoi(optarg)) <= 0)
+        err_print_usage("Error: [-j THREADS>0] expects an integer\n");
+      asm_set_threads(al, temp);
+      break;
+
     case 'P':
       r->create_bin = GENERIC_FILE;
       r->param_file = optarg;
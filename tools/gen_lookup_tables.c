@@ -0,0 +1,390 @@
+/**
+ * Copyright 2022 University of Adelaide
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*build-time generator: emits lookup_tables.h, holding a perfect hash of every
+ (instruction name, operand format) pair in INSTR_TABLE[] to its key and of
+ every register name in REG_TABLE[] to its asm_reg, the first key of every
+ asm_instr and the first OPD_FORMAT_TABLE[] entry of every leading letter,
+ along with static assertions that enum asm_mnemonic lists every asm_instr in
+ order.
+ Buckets are placed largest first by searching a displacement that maps every
+ key of the bucket into a free slot (hash and displace)*/
+#include "common.h"
+#include "instructions.h"
+#include "lookup_hash.h"
+#include "registers.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// average number of keys per bucket
+#define KEYS_PER_BUCKET 4
+#define MAX_BUCKET_SIZE (KEYS_PER_BUCKET * 4)
+#define MAX_DISPLACEMENT 0xffff
+// REG_TABLE[] columns (see registers.c)
+#define REG_8BIT_COL 0
+#define REG_NOEXT_8BIT_COL 1
+#define REG_16BIT_COL 2
+#define REG_32BIT_COL 3
+#define REG_64BIT_COL 4
+#define REG_EXT_ROW 8
+#define REG_VECTOR_ROW 16
+
+struct hash_key {
+  uint64_t lo;
+  uint64_t hi;
+  int opd_format;
+  // INSTR_TABLE[] key or asm_reg value
+  int value;
+  uint64_t hash;
+  unsigned int bucket;
+};
+
+// a built hash: displacement per bucket and key index (or NA) per slot
+struct hash_layout {
+  unsigned int num_buckets;
+  unsigned int num_slots;
+  unsigned int *disp;
+  int *slots;
+};
+
+static unsigned int next_pow2(unsigned int n) {
+  unsigned int p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+/**
+ * adds the pair (@param name, @param opd_format) for INSTR_TABLE[] index
+ * @param key to @param keys unless the pair has been seen already, since the
+ * parser always resolves to the first matching entry
+ */
+static void add_instr_key(struct hash_key *keys, unsigned int *num_keys,
+                          const char *name, int opd_format, int key) {
+
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+  lookup_hash_pack(name, &lo, &hi);
+  for (unsigned int i = 0; i < *num_keys; i++)
+    if (keys[i].lo == lo && keys[i].hi == hi &&
+        keys[i].opd_format == opd_format)
+      return;
+  struct hash_key *k = &keys[(*num_keys)++];
+  k->lo = lo;
+  k->hi = hi;
+  k->opd_format = opd_format;
+  k->value = key;
+  k->hash = lookup_hash_combine(lo, hi, opd_format);
+}
+
+/**
+ * collects all (name, operand format) pairs the way the parser resolves them:
+ * a named entry and all following entries of the same asm_instr
+ */
+static unsigned int collect_instr_keys(struct hash_key *keys) {
+
+  unsigned int num_keys = 0;
+  // INSTR_TABLE index starts after the SKIP entry
+  for (int i = SKIP + 1; INSTR_TABLE[i].name != NA; i++) {
+    if (INSTR_TABLE[i].instr_name[0] == '\0')
+      continue;
+    for (int j = i; INSTR_TABLE[j].name == INSTR_TABLE[i].name; j++)
+      for (int f = 0; f < VALID_OPERAND_FORMATS; f++)
+        if (INSTR_TABLE[j].opd_format[f] != NA)
+          add_instr_key(keys, &num_keys, INSTR_TABLE[i].instr_name,
+                        INSTR_TABLE[j].opd_format[f], j);
+  }
+  return num_keys;
+}
+
+/**
+ * returns the register mode of column @param col in REG_TABLE[] row
+ * @param row: the legacy registers come first, then r8-r15, then the vectors
+ */
+static bit_mode reg_mode(int row, int col) {
+
+  bool ext = row >= REG_EXT_ROW;
+  switch (col) {
+  case REG_8BIT_COL:
+    return ext ? ext8 : reg8;
+  case REG_NOEXT_8BIT_COL:
+    return noext8;
+  case REG_16BIT_COL:
+    return ext ? ext16 : reg16;
+  case REG_32BIT_COL:
+    return ext ? ext32 : reg32;
+  case REG_64BIT_COL:
+    if (row >= REG_VECTOR_ROW)
+      return mmx64;
+    return ext ? ext64 : reg64;
+  default:
+    return mmx64;
+  }
+}
+
+/**
+ * collects every register name in REG_TABLE[] along with its mode and
+ * generic register
+ */
+static unsigned int collect_reg_keys(struct hash_key *keys) {
+
+  unsigned int num_keys = 0;
+  for (int row = 0; REG_TABLE[row].gen_reg != reg_error; row++) {
+    for (int col = 0; col < NUM_OF_REGISTERS; col++) {
+      const char *name = REG_TABLE[row].reg_conversion[col];
+      if (name[0] == '\0')
+        continue;
+      struct hash_key *k = &keys[num_keys++];
+      lookup_hash_pack(name, &k->lo, &k->hi);
+      k->value = reg_mode(row, col) | REG_TABLE[row].gen_reg;
+      k->hash = k->lo;
+    }
+  }
+  return num_keys;
+}
+
+/**
+ * tries to place all keys of @param bucket with displacement @param disp into
+ * @param slots. Returns true on success.
+ */
+static bool place_bucket(struct hash_key *keys, unsigned int num_keys,
+                         unsigned int bucket, unsigned int disp, int *slots,
+                         unsigned int num_slots) {
+
+  unsigned int placed[MAX_BUCKET_SIZE];
+  unsigned int num_placed = 0;
+  for (unsigned int i = 0; i < num_keys; i++) {
+    if (keys[i].bucket != bucket)
+      continue;
+    unsigned int slot = lookup_hash_mix(keys[i].hash, disp) & (num_slots - 1);
+    bool taken = slots[slot] != NA;
+    for (unsigned int p = 0; p < num_placed && !taken; p++)
+      taken = placed[p] == slot;
+    if (taken || num_placed == MAX_BUCKET_SIZE) {
+      for (unsigned int p = 0; p < num_placed; p++)
+        slots[placed[p]] = NA;
+      return false;
+    }
+    slots[slot] = (int)i;
+    placed[num_placed++] = slot;
+  }
+  return true;
+}
+
+/**
+ * builds a hash and displace layout of @param keys into @param layout.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE if no layout was found.
+ */
+static int build_layout(struct hash_key *keys, unsigned int num_keys,
+                        struct hash_layout *layout) {
+
+  layout->num_slots = next_pow2(num_keys);
+  layout->num_buckets = layout->num_slots / KEYS_PER_BUCKET;
+  layout->disp = calloc(layout->num_buckets, sizeof(unsigned int));
+  layout->slots = malloc(layout->num_slots * sizeof(int));
+  unsigned int *bucket_size = calloc(layout->num_buckets, sizeof(unsigned int));
+  for (unsigned int s = 0; s < layout->num_slots; s++)
+    layout->slots[s] = NA;
+  for (unsigned int i = 0; i < num_keys; i++) {
+    keys[i].bucket =
+        lookup_hash_mix(keys[i].hash, 0) & (layout->num_buckets - 1);
+    bucket_size[keys[i].bucket]++;
+  }
+  int status = EXIT_SUCCESS;
+  for (unsigned int b = 0; b < layout->num_buckets; b++)
+    if (bucket_size[b] > MAX_BUCKET_SIZE) {
+      fprintf(stderr, "gen_lookup_tables: bucket %u too large\n", b);
+      status = EXIT_FAILURE;
+    }
+  // place the largest buckets first while the table is still sparse
+  for (unsigned int size = MAX_BUCKET_SIZE; size > 0 && !status; size--) {
+    for (unsigned int b = 0; b < layout->num_buckets && !status; b++) {
+      if (bucket_size[b] != size)
+        continue;
+      unsigned int d = 1;
+      while (!place_bucket(keys, num_keys, b, d, layout->slots,
+                           layout->num_slots))
+        if (++d > MAX_DISPLACEMENT) {
+          fprintf(stderr, "gen_lookup_tables: failed to place bucket %u\n", b);
+          status = EXIT_FAILURE;
+          break;
+        }
+      layout->disp[b] = d;
+    }
+  }
+  free(bucket_size);
+  return status;
+}
+
+static void print_disp(const char *prefix, const struct hash_layout *layout) {
+
+  printf("#define %s_BUCKETS %u\n", prefix, layout->num_buckets);
+  printf("#define %s_SLOTS %u\n\n", prefix, layout->num_slots);
+  printf("static const uint16_t %s_DISP[%s_BUCKETS] = {", prefix, prefix);
+  for (unsigned int b = 0; b < layout->num_buckets; b++)
+    printf("%s%u", b % 16 ? ", " : (b ? ",\n    " : "\n    "),
+           layout->disp[b]);
+  printf("};\n\n");
+}
+
+static void print_instr_table(const struct hash_key *keys,
+                              const struct hash_layout *layout) {
+
+  print_disp("INSTR_HASH", layout);
+  printf("static const struct instr_hash_entry "
+         "INSTR_HASH_TABLE[INSTR_HASH_SLOTS] = {\n");
+  for (unsigned int s = 0; s < layout->num_slots; s++) {
+    if (layout->slots[s] == NA) {
+      printf("    {0x0, 0x0, %d, %d},\n", opd_error, INSTR_ERROR);
+      continue;
+    }
+    const struct hash_key *k = &keys[layout->slots[s]];
+    printf("    {0x%llx, 0x%llx, %d, %d},\n", (unsigned long long)k->lo,
+           (unsigned long long)k->hi, k->opd_format, k->value);
+  }
+  printf("};\n\n");
+}
+
+static void print_reg_table(const struct hash_key *keys,
+                            const struct hash_layout *layout) {
+
+  print_disp("REG_HASH", layout);
+  printf("static const struct reg_hash_entry "
+         "REG_HASH_TABLE[REG_HASH_SLOTS] = {\n");
+  for (unsigned int s = 0; s < layout->num_slots; s++) {
+    if (layout->slots[s] == NA) {
+      printf("    {0x0, %d},\n", reg_error);
+      continue;
+    }
+    const struct hash_key *k = &keys[layout->slots[s]];
+    printf("    {0x%llx, %d},\n", (unsigned long long)k->lo, k->value);
+  }
+  printf("};\n\n");
+}
+
+/**
+ * prints the first INSTR_TABLE[] key of every asm_instr (its other operand
+ * formats follow contiguously) or INSTR_ERROR if it has none
+ */
+static void print_name_table() {
+
+  int num_names = 0;
+  for (int i = 0; INSTR_TABLE[i].name != NA; i++)
+    if (INSTR_TABLE[i].name >= num_names)
+      num_names = INSTR_TABLE[i].name + 1;
+  printf("#define INSTR_NAMES %d\n\n", num_names);
+  printf("static const int16_t INSTR_NAME_KEY[INSTR_NAMES] = {");
+  for (int name = 0; name < num_names; name++) {
+    int key = 0;
+    while (INSTR_TABLE[key].name != NA && INSTR_TABLE[key].name != name)
+      key++;
+    printf("%s%d", name % 16 ? ", " : (name ? ",\n    " : "\n    "),
+           INSTR_TABLE[key].name == NA ? INSTR_ERROR : key);
+  }
+  printf("};\n\n");
+}
+
+/**
+ * prints a static assertion per asm_instr with an INSTR_TABLE[] entry that the
+ * asm_mnemonic of the same name in upper case with the AL_ prefix is at the
+ * same offset from adc (see builder.c)
+ */
+static void print_mnemonic_checks() {
+
+  for (int name = adc; name < NUM_OF_INSTR_NAMES; name++) {
+    // the first entry of a name is named like its asm_instr, unless it is
+    // only reached otherwise (jbe), which is then pinned by its neighbours
+    int key = 0;
+    while (INSTR_TABLE[key].name != NA && INSTR_TABLE[key].name != name)
+      key++;
+    if (INSTR_TABLE[key].name == NA || INSTR_TABLE[key].instr_name[0] == '\0')
+      continue;
+    char upper[MAX_INSTR_LEN] = {0};
+    for (int i = 0; INSTR_TABLE[key].instr_name[i] != '\0'; i++)
+      upper[i] = (char)toupper(INSTR_TABLE[key].instr_name[i]);
+    printf("_Static_assert(AL_%s == %d, \"enum asm_mnemonic does not match "
+           "asm_instr at %s\");\n",
+           upper, INSTR_TABLE[key].name - adc, INSTR_TABLE[key].instr_name);
+  }
+  printf("\n");
+}
+
+/**
+ * prints the index of the first OPD_FORMAT_TABLE[] entry starting with each
+ * letter of the alphabet (or 0 if there is none)
+ */
+static void print_opd_format_index() {
+
+  int index[LETTERS_IN_ALPHABET] = {0};
+  for (int i = 1; OPD_FORMAT_TABLE[i].val != opd_error; i++) {
+    int letter = OPD_FORMAT_TABLE[i].str[0] - 'a';
+    if (index[letter] == 0)
+      index[letter] = i;
+  }
+  printf("static const uint8_t OPD_FORMAT_INDEX[%d] = {", LETTERS_IN_ALPHABET);
+  for (int letter = 0; letter < LETTERS_IN_ALPHABET; letter++)
+    printf("%s%d", letter % 16 ? ", " : (letter ? ",\n    " : "\n    "),
+           index[letter]);
+  printf("};\n\n");
+}
+
+static void free_layout(struct hash_layout *layout) {
+  free(layout->disp);
+  free(layout->slots);
+}
+
+int main() {
+
+  unsigned int max_keys = 0;
+  while (INSTR_TABLE[max_keys].name != NA)
+    max_keys++;
+  max_keys *= VALID_OPERAND_FORMATS;
+  struct hash_key *instr_keys = calloc(max_keys, sizeof(struct hash_key));
+  unsigned int num_instr_keys = collect_instr_keys(instr_keys);
+
+  max_keys = 0;
+  while (REG_TABLE[max_keys].gen_reg != reg_error)
+    max_keys++;
+  max_keys *= NUM_OF_REGISTERS;
+  struct hash_key *reg_keys = calloc(max_keys, sizeof(struct hash_key));
+  unsigned int num_reg_keys = collect_reg_keys(reg_keys);
+
+  struct hash_layout instr_layout = {0};
+  struct hash_layout reg_layout = {0};
+  int status = build_layout(instr_keys, num_instr_keys, &instr_layout);
+  if (!status)
+    status = build_layout(reg_keys, num_reg_keys, &reg_layout);
+  if (!status) {
+    printf("/* generated by tools/gen_lookup_tables from INSTR_TABLE[] and "
+           "REG_TABLE[] -- do not edit */\n");
+    printf("#ifndef LOOKUP_TABLES_H\n#define LOOKUP_TABLES_H\n\n");
+    printf("#include \"assemblyline.h\"\n#include \"lookup_hash.h\"\n\n");
+    print_instr_table(instr_keys, &instr_layout);
+    print_reg_table(reg_keys, &reg_layout);
+    print_name_table();
+    print_opd_format_index();
+    print_mnemonic_checks();
+    printf("#endif\n");
+  }
+  free_layout(&instr_layout);
+  free_layout(&reg_layout);
+  free(instr_keys);
+  free(reg_keys);
+  return status;
+}